@@ -0,0 +1,91 @@
+//! clang++ -std=c++14 -O3 -Wall -Wextra -pthread convert_links.cc
+//
+// Converts links.txt to the binary format of LoadBinaryLinks() in
+// common/csr_graph.h. Written next to the text file as links.txt.svb, it is
+// picked up by every program that loads links.txt. The copy is read back
+// and compared with the text file, and both load times are printed.
+//
+// Usage: ./a.out [--input=links.txt] [--output=<input>.svb] [--no-verify]
+//   Build with make SIMD=1 (or SIMD=native) to decode with pshufb.
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include <sys/stat.h>
+
+#include "../common/csr_graph.h"
+#include "../common/instrumentation.h"
+
+int64_t FileSize(const std::string& path) {
+  struct stat st;
+  return stat(path.c_str(), &st) == 0 ? st.st_size : 0;
+}
+
+int main(int argc, char** argv) {
+  std::string input = "links.txt";
+  std::string output;
+  bool verify = true;
+  for (int i = 1; i < argc; i++) {
+    if (std::strncmp(argv[i], "--input=", 8) == 0) {
+      input = argv[i] + 8;
+    } else if (std::strncmp(argv[i], "--output=", 9) == 0) {
+      output = argv[i] + 9;
+    } else if (std::strcmp(argv[i], "--no-verify") == 0) {
+      verify = false;
+    } else {
+      std::cerr << "unknown option: " << argv[i] << std::endl;
+      return -1;
+    }
+  }
+  if (output.empty())
+    output = input + kBinaryLinksSuffix;
+
+  // Taken first, so that the copy looks stale if the input changes now.
+  FileStamp source = StampOf(input.c_str());
+  std::unique_ptr<CsrGraph> graph;
+  double text_sec = 0;
+  {
+    ScopedTimer t("Read " + input);
+    graph = LoadTextLinks(input.c_str());
+    if (!graph)
+      return -1;
+    text_sec = t.elapsed();
+    std::cout << "num vertexes: " << graph->num_vertexes() << " "
+              << "num edges: " << graph->num_edges() << std::endl;
+  }
+  {
+    ScopedTimer t("Write " + output);
+    if (!WriteBinaryLinks(*graph, output.c_str(), source))
+      return -1;
+  }
+
+  int64_t text_bytes = FileSize(input);
+  int64_t binary_bytes = FileSize(output);
+  int64_t m = std::max<int64_t>(1, graph->num_edges());
+  std::cout << "text: " << text_bytes << " bytes, binary: " << binary_bytes
+            << " bytes (" << static_cast<double>(binary_bytes) / m
+            << " bytes/link, "
+            << static_cast<double>(text_bytes) / std::max<int64_t>(
+                                                     1, binary_bytes)
+            << "x smaller)" << std::endl;
+  if (!verify)
+    return 0;
+
+  std::unique_ptr<CsrGraph> copy;
+  double binary_sec = 0;
+  {
+    ScopedTimer t("Read " + output);
+    copy = LoadBinaryLinks(output.c_str());
+    if (!copy)
+      return -1;
+    binary_sec = t.elapsed();
+  }
+  bool same = copy->offsets() == graph->offsets() &&
+              copy->targets() == graph->targets();
+  std::cout << "binary load: " << binary_bytes / 1E6 / binary_sec
+            << " MB/s, " << m / 1E6 / binary_sec << " M links/s, "
+            << text_sec / binary_sec << "x faster than text" << std::endl;
+  std::cout << "verified: " << (same ? "yes" : "NO") << std::endl;
+  return same ? 0 : 1;
+}
@@ -0,0 +1,194 @@
+//! clang++ -std=c++14 -O3 -Wall -Wextra gen_graph.cc
+//
+// Writes a synthetic links.txt / pages.txt pair so that the graph programs
+// can be benchmarked without the Wikipedia dump.
+//
+//   rmat: R-MAT / Kronecker graph with the Graph500 parameters
+//         (a, b, c) = (0.57, 0.19, 0.19), 2^scale vertexes and
+//         edge_factor * 2^scale edges, vertex ids randomly permuted.
+//   ba:   Barabasi-Albert preferential attachment. Every new vertex links to
+//         edge_factor existing ones; each link is reciprocated with
+//         probability --reciprocal so that the graph is not a DAG.
+//
+// Self loops and duplicate links are dropped. links.txt is sorted by source.
+// By default a vertex without out-going links gets one random link, because
+// the loaders in homework2_cpp expect every source id to appear.
+//
+// Usage: ./a.out [--model=rmat|ba] [--scale=16] [--edge-factor=16]
+//                [--reciprocal=0.3] [--seed=1] [--out-dir=.]
+//                [--names-file=pages.txt] [--allow-sinks]
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+std::vector<std::pair<int, int>> GenerateRmat(int scale, int edge_factor,
+                                              std::mt19937_64* rng) {
+  const double kA = 0.57, kB = 0.19, kC = 0.19;
+  int n = 1 << scale;
+  int64_t m = static_cast<int64_t>(edge_factor) * n;
+  std::uniform_real_distribution<double> uniform(0, 1);
+  std::vector<std::pair<int, int>> edges;
+  edges.reserve(m);
+  for (int64_t i = 0; i < m; i++) {
+    int src = 0, dst = 0;
+    for (int bit = 0; bit < scale; bit++) {
+      double r = uniform(*rng);
+      if (r < kA) {
+        // top-left quadrant
+      } else if (r < kA + kB) {
+        dst |= 1 << bit;
+      } else if (r < kA + kB + kC) {
+        src |= 1 << bit;
+      } else {
+        src |= 1 << bit;
+        dst |= 1 << bit;
+      }
+    }
+    edges.emplace_back(src, dst);
+  }
+  // Scatter the hubs, which R-MAT puts at small ids.
+  std::vector<int> permutation(n);
+  for (int v = 0; v < n; v++)
+    permutation[v] = v;
+  std::shuffle(permutation.begin(), permutation.end(), *rng);
+  for (auto& e : edges)
+    e = {permutation[e.first], permutation[e.second]};
+  return edges;
+}
+
+std::vector<std::pair<int, int>> GenerateBarabasiAlbert(int n, int edge_factor,
+                                                        double reciprocal,
+                                                        std::mt19937_64* rng) {
+  std::vector<std::pair<int, int>> edges;
+  // Every endpoint appears once per incident edge, so sampling from it is
+  // sampling proportionally to degree.
+  std::vector<int> endpoints;
+  std::uniform_real_distribution<double> uniform(0, 1);
+  int seed_size = std::max(2, edge_factor);
+  for (int v = 0; v < seed_size && v < n; v++) {
+    for (int u = 0; u < v; u++) {
+      edges.emplace_back(v, u);
+      edges.emplace_back(u, v);
+      endpoints.push_back(u);
+      endpoints.push_back(v);
+    }
+  }
+  for (int v = seed_size; v < n; v++) {
+    std::uniform_int_distribution<size_t> pick(0, endpoints.size() - 1);
+    for (int i = 0; i < edge_factor; i++) {
+      int u = endpoints[pick(*rng)];
+      edges.emplace_back(v, u);
+      if (uniform(*rng) < reciprocal)
+        edges.emplace_back(u, v);
+      endpoints.push_back(u);
+      endpoints.push_back(v);
+    }
+  }
+  return edges;
+}
+
+// Pronounceable unique names so that substring search has realistic hits.
+std::string MakeName(int id, std::mt19937_64* rng) {
+  static const char* kSyllables[] = {"ka", "ki", "ku", "ke", "ko", "sa", "shi",
+                                     "su", "ta", "to", "na", "ni", "ma", "mi",
+                                     "ra", "ri", "ya", "yo", "wa", "n"};
+  std::uniform_int_distribution<int> syllable(0, 19);
+  std::uniform_int_distribution<int> length(2, 4);
+  std::string name;
+  for (int i = length(*rng); i > 0; i--)
+    name += kSyllables[syllable(*rng)];
+  name[0] = name[0] - 'a' + 'A';
+  return name + "_" + std::to_string(id);
+}
+
+int main(int argc, char** argv) {
+  std::string model = "rmat";
+  int scale = 16;
+  int edge_factor = 16;
+  double reciprocal = 0.3;
+  uint64_t seed = 1;
+  std::string out_dir = ".";
+  std::string names_file = "pages.txt";
+  bool allow_sinks = false;
+  for (int i = 1; i < argc; i++) {
+    if (std::strncmp(argv[i], "--model=", 8) == 0) {
+      model = argv[i] + 8;
+    } else if (std::strncmp(argv[i], "--scale=", 8) == 0) {
+      scale = std::atoi(argv[i] + 8);
+    } else if (std::strncmp(argv[i], "--edge-factor=", 14) == 0) {
+      edge_factor = std::atoi(argv[i] + 14);
+    } else if (std::strncmp(argv[i], "--reciprocal=", 13) == 0) {
+      reciprocal = std::atof(argv[i] + 13);
+    } else if (std::strncmp(argv[i], "--seed=", 7) == 0) {
+      seed = std::strtoull(argv[i] + 7, nullptr, 10);
+    } else if (std::strncmp(argv[i], "--out-dir=", 10) == 0) {
+      out_dir = argv[i] + 10;
+    } else if (std::strncmp(argv[i], "--names-file=", 13) == 0) {
+      names_file = argv[i] + 13;
+    } else if (std::strcmp(argv[i], "--allow-sinks") == 0) {
+      allow_sinks = true;
+    } else {
+      std::cerr << "unknown option: " << argv[i] << std::endl;
+      return -1;
+    }
+  }
+  if (scale < 1 || scale > 30 || edge_factor < 1) {
+    std::cerr << "invalid --scale or --edge-factor" << std::endl;
+    return -1;
+  }
+
+  std::mt19937_64 rng(seed);
+  int n = 1 << scale;
+  std::vector<std::pair<int, int>> edges;
+  if (model == "rmat") {
+    edges = GenerateRmat(scale, edge_factor, &rng);
+  } else if (model == "ba") {
+    edges = GenerateBarabasiAlbert(n, edge_factor, reciprocal, &rng);
+  } else {
+    std::cerr << "unknown model: " << model << std::endl;
+    return -1;
+  }
+
+  edges.erase(std::remove_if(edges.begin(), edges.end(),
+                             [](const std::pair<int, int>& e) {
+                               return e.first == e.second;
+                             }),
+              edges.end());
+  if (!allow_sinks) {
+    std::vector<bool> has_out(n, false);
+    for (const auto& e : edges)
+      has_out[e.first] = true;
+    std::uniform_int_distribution<int> pick(0, n - 2);
+    for (int v = 0; v < n; v++) {
+      if (!has_out[v]) {
+        int u = pick(rng);
+        edges.emplace_back(v, u >= v ? u + 1 : u);
+      }
+    }
+  }
+  std::sort(edges.begin(), edges.end());
+  edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+  std::string links_path = out_dir + "/links.txt";
+  std::string pages_path = out_dir + "/" + names_file;
+  std::ofstream links(links_path);
+  std::ofstream pages(pages_path);
+  if (links.fail() || pages.fail()) {
+    std::cerr << "cannot write to " << out_dir << std::endl;
+    return -1;
+  }
+  for (const auto& e : edges)
+    links << e.first << "\t" << e.second << "\n";
+  for (int v = 0; v < n; v++)
+    pages << v << "\t" << MakeName(v, &rng) << "\n";
+  std::cout << model << ": " << n << " vertexes, " << edges.size()
+            << " links -> " << links_path << ", " << pages_path << std::endl;
+  return 0;
+}
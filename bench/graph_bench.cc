@@ -0,0 +1,250 @@
+//! clang++ -std=c++14 -O3 -Wall -Wextra -pthread graph_bench.cc
+//
+// Regression benchmark of the graph kernels of common/graph_kernels.h on a
+// links.txt / pages.txt pair, typically written by gen_graph. Every kernel
+// is run through the harness (warmup, repetitions, median / p99) and
+// reported as text, CSV or JSON:
+//
+//   load      parse links.txt and pages.txt         items: links
+//   bfs       top-down BFS from fixed sources       items: traversed links
+//   pagerank  pull-style PageRank iterations        items: links * iterations
+//   search    substring search over page names      items: names scanned
+//   wcc       weakly connected components (union-find)  items: links
+//   clique    greedy clique around sampled pages    items: adjacency probes
+//
+// Usage: ./a.out [--data-dir=.] [--kernels=load,bfs,...] [--warmup=1]
+//                [--reps=5] [--format=text|csv|json] [--output=path]
+//                [--sources=8] [--iterations=10] [--clique-samples=1000]
+//                [--memory=thp,explicit+interleave,...]
+//
+// --memory reruns bfs and pagerank on copies of the graph (and fresh rank
+// and distance arrays) allocated with each huge page / NUMA configuration
+// of graph_memory.h, reported as e.g. "bfs@thp+partition". The variants run
+// the parallel kernels on NUM_THREADS threads, so that placement and
+// pinning show up; "+pin" pins the threads, which "partition" implies so
+// that every thread runs on the node holding its slice of the arrays.
+// Copies are written by the main thread, so under first-touch everything
+// sits on its node. Run with GRAPH_PERF=1 to see the dTLB and LLC misses
+// per edge of every variant.
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../common/csr_graph.h"
+#include "../common/graph_kernels.h"
+#include "../common/graph_memory.h"
+#include "../common/perf_counters.h"
+#include "harness.h"
+
+// BFS from every source in turn. Returns the number of traversed links.
+int64_t MultiSourceBfs(const CsrGraph& graph, const std::vector<int>& sources,
+                       GraphVector<int>* dist) {
+  std::vector<int> queue;
+  int64_t edges = 0;
+  for (int source : sources)
+    edges += Bfs(graph, source, dist, &queue);
+  return edges;
+}
+
+int64_t ParallelMultiSourceBfs(const CsrGraph& graph,
+                               const std::vector<int>& sources,
+                               GraphVector<int>* dist) {
+  int64_t edges = 0;
+  for (int source : sources)
+    edges += ParallelBfs(graph, source, dist);
+  return edges;
+}
+
+// Parses "thp", "off+interleave", "explicit+partition", ... Partitioned
+// arrays are only local to pinned threads, so "partition" implies "pin".
+bool ParseMemoryConfig(const std::string& config,
+                       GraphMemory::Options* options) {
+  std::stringstream parts(config);
+  std::string part;
+  while (std::getline(parts, part, '+')) {
+    if (part == "pin")
+      options->pin_threads = true;
+    else if (!GraphMemory::ParseHugePages(part, &options->huge_pages) &&
+             !GraphMemory::ParsePlacement(part, &options->placement))
+      return false;
+  }
+  if (options->placement == GraphMemory::Placement::kPartition)
+    options->pin_threads = true;
+  return true;
+}
+
+// Runs |fn| through the suite inside a PerfScope of the same name.
+void RunWithPerf(BenchmarkSuite* suite, const std::string& name,
+                 const std::function<int64_t()>& fn) {
+  suite->Run(name, [&] {
+    PerfScope perf(name.c_str());
+    int64_t items = fn();
+    perf.AddItems(items);
+    return items;
+  });
+}
+
+int main(int argc, char** argv) {
+  std::string data_dir = ".";
+  std::string kernels = "load,bfs,pagerank,search,wcc,clique";
+  std::string output;
+  std::vector<std::string> memory_configs;
+  BenchmarkOptions options;
+  ReportFormat format = ReportFormat::kText;
+  int num_sources = 8;
+  int iterations = 10;
+  int clique_samples = 1000;
+  for (int i = 1; i < argc; i++) {
+    if (std::strncmp(argv[i], "--data-dir=", 11) == 0) {
+      data_dir = argv[i] + 11;
+    } else if (std::strncmp(argv[i], "--kernels=", 10) == 0) {
+      kernels = argv[i] + 10;
+    } else if (std::strncmp(argv[i], "--warmup=", 9) == 0) {
+      options.warmup = std::max(0, std::atoi(argv[i] + 9));
+    } else if (std::strncmp(argv[i], "--reps=", 7) == 0) {
+      options.repetitions = std::max(1, std::atoi(argv[i] + 7));
+    } else if (std::strncmp(argv[i], "--format=", 9) == 0 &&
+               ParseReportFormat(argv[i] + 9, &format)) {
+      continue;
+    } else if (std::strncmp(argv[i], "--output=", 9) == 0) {
+      output = argv[i] + 9;
+    } else if (std::strncmp(argv[i], "--sources=", 10) == 0) {
+      num_sources = std::max(1, std::atoi(argv[i] + 10));
+    } else if (std::strncmp(argv[i], "--iterations=", 13) == 0) {
+      iterations = std::max(1, std::atoi(argv[i] + 13));
+    } else if (std::strncmp(argv[i], "--memory=", 9) == 0) {
+      std::stringstream list(argv[i] + 9);
+      std::string config;
+      while (std::getline(list, config, ','))
+        memory_configs.push_back(config);
+    } else if (std::strncmp(argv[i], "--clique-samples=", 17) == 0) {
+      clique_samples = std::max(1, std::atoi(argv[i] + 17));
+    } else {
+      std::cerr << "unknown option: " << argv[i] << std::endl;
+      return -1;
+    }
+  }
+  auto enabled = [&](const std::string& kernel) {
+    std::stringstream list(kernels);
+    std::string name;
+    while (std::getline(list, name, ','))
+      if (name == kernel)
+        return true;
+    return false;
+  };
+
+  const std::string links_path = data_dir + "/links.txt";
+  const std::string pages_path = data_dir + "/pages.txt";
+  std::unique_ptr<CsrGraph> graph = LoadLinks(links_path.c_str());
+  std::vector<std::string> names;
+  if (!graph || graph->num_vertexes() == 0 ||
+      !LoadNames(pages_path.c_str(), &names))
+    return -1;
+  graph->EnsureVertexes(names.size());
+  graph->SortNeighbors();
+  CsrGraph reversed = graph->Reversed();
+  std::cerr << "num vertexes: " << graph->num_vertexes() << " "
+            << "num edges: " << graph->num_edges() << std::endl;
+  std::cerr << GraphMemory::Get().Describe() << std::endl;
+
+  std::mt19937 rng(12345);
+  std::uniform_int_distribution<int> pick(0, graph->num_vertexes() - 1);
+  std::vector<int> sources, samples;
+  for (int i = 0; i < num_sources; i++)
+    sources.push_back(pick(rng));
+  for (int i = 0; i < clique_samples; i++)
+    samples.push_back(pick(rng));
+
+  BenchmarkSuite suite(options);
+  if (enabled("load")) {
+    suite.Run("load", [&] {
+      std::unique_ptr<CsrGraph> g = LoadLinks(links_path.c_str());
+      std::vector<std::string> n;
+      LoadNames(pages_path.c_str(), &n);
+      return g ? g->num_edges() : 0;
+    });
+  }
+  if (enabled("bfs")) {
+    GraphVector<int> dist(graph->num_vertexes());
+    RunWithPerf(&suite, "bfs",
+                [&] { return MultiSourceBfs(*graph, sources, &dist); });
+  }
+  if (enabled("pagerank")) {
+    GraphVector<double> rank;
+    RunWithPerf(&suite, "pagerank", [&] {
+      return PullPageRank(*graph, reversed, iterations, &rank);
+    });
+  }
+  if (enabled("search")) {
+    // A frequent syllable, so that collecting the hits does real work too.
+    std::vector<int> hits;
+    suite.Run("search", [&] {
+      hits.clear();
+      for (size_t i = 0; i < names.size(); i++)
+        if (names[i].find("ka") != std::string::npos)
+          hits.push_back(i);
+      return static_cast<int64_t>(names.size());
+    });
+    std::cerr << "search hits: " << hits.size() << std::endl;
+  }
+  if (enabled("wcc")) {
+    int components = 0;
+    suite.Run("wcc",
+              [&] { return WeaklyConnectedComponents(*graph, &components); });
+    std::cerr << "components: " << components << std::endl;
+  }
+  if (enabled("clique")) {
+    int largest = 0;
+    suite.Run("clique",
+              [&] { return GreedyCliques(*graph, samples, &largest); });
+    std::cerr << "largest clique: " << largest << std::endl;
+  }
+
+  const GraphMemory::Options default_memory = GraphMemory::Get().options();
+  for (const std::string& config : memory_configs) {
+    GraphMemory::Options memory = default_memory;
+    if (!ParseMemoryConfig(config, &memory)) {
+      std::cerr << "unknown memory config: " << config << std::endl;
+      return -1;
+    }
+    GraphMemory::Get().set_options(memory);
+    std::cerr << config << ": " << GraphMemory::Get().Describe() << std::endl;
+    // Copies allocate (and first touch) under the new options.
+    CsrGraph placed = *graph;
+    CsrGraph placed_reversed = reversed;
+    GraphVector<int> dist(placed.num_vertexes());
+    GraphVector<double> rank(placed.num_vertexes());
+    if (enabled("bfs")) {
+      RunWithPerf(&suite, "bfs@" + config, [&] {
+        return ParallelMultiSourceBfs(placed, sources, &dist);
+      });
+    }
+    if (enabled("pagerank")) {
+      RunWithPerf(&suite, "pagerank@" + config, [&] {
+        return ParallelPullPageRank(placed, placed_reversed, iterations,
+                                    &rank);
+      });
+    }
+  }
+  GraphMemory::Get().set_options(default_memory);
+
+  if (output.empty()) {
+    suite.Report(std::cout, format);
+  } else {
+    std::ofstream out(output);
+    if (out.fail()) {
+      std::cerr << "cannot write: " << output << std::endl;
+      return -1;
+    }
+    suite.Report(out, format);
+  }
+  return 0;
+}
@@ -0,0 +1,175 @@
+// Minimal benchmark harness: warmup, repetitions, order statistics, and
+// text / CSV / JSON reports.
+//
+//   BenchmarkSuite suite(options);
+//   suite.Run("bfs", [&] { return Bfs(...); });  // returns items processed
+//   suite.Report(std::cout, ReportFormat::kCsv);
+#ifndef BENCH_HARNESS_H_
+#define BENCH_HARNESS_H_
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+enum class ReportFormat { kText, kCsv, kJson };
+
+inline bool ParseReportFormat(const std::string& name, ReportFormat* format) {
+  if (name == "text")
+    *format = ReportFormat::kText;
+  else if (name == "csv")
+    *format = ReportFormat::kCsv;
+  else if (name == "json")
+    *format = ReportFormat::kJson;
+  else
+    return false;
+  return true;
+}
+
+struct BenchmarkOptions {
+  int warmup = 1;
+  int repetitions = 5;
+};
+
+struct BenchmarkResult {
+  std::string name;
+  int repetitions;
+  int64_t items;  // per repetition, e.g. traversed edges
+  double min_sec;
+  double median_sec;
+  double p99_sec;
+  double mean_sec;
+  double stddev_sec;
+
+  double items_per_sec() const {
+    return median_sec > 0 ? items / median_sec : 0;
+  }
+};
+
+class BenchmarkSuite {
+ public:
+  explicit BenchmarkSuite(BenchmarkOptions options) : options_(options) {}
+
+  // Runs |fn| options.warmup times untimed, then options.repetitions times
+  // timed. |fn| returns the number of items it processed.
+  const BenchmarkResult& Run(const std::string& name,
+                             const std::function<int64_t()>& fn) {
+    for (int i = 0; i < options_.warmup; i++)
+      fn();
+    std::vector<double> samples;
+    int64_t items = 0;
+    for (int i = 0; i < std::max(1, options_.repetitions); i++) {
+      auto begin = std::chrono::steady_clock::now();
+      items = fn();
+      auto end = std::chrono::steady_clock::now();
+      samples.push_back(std::chrono::duration<double>(end - begin).count());
+    }
+    results_.push_back(Summarize(name, items, samples));
+    std::cerr << "bench " << name << ": median " << std::setprecision(4)
+              << results_.back().median_sec << " sec" << std::endl;
+    return results_.back();
+  }
+
+  const std::vector<BenchmarkResult>& results() const { return results_; }
+
+  void Report(std::ostream& out, ReportFormat format) const {
+    switch (format) {
+      case ReportFormat::kText:
+        ReportText(out);
+        break;
+      case ReportFormat::kCsv:
+        ReportCsv(out);
+        break;
+      case ReportFormat::kJson:
+        ReportJson(out);
+        break;
+    }
+  }
+
+ private:
+  // Nearest-rank percentile of sorted |samples|.
+  static double Percentile(const std::vector<double>& samples, double p) {
+    size_t rank = static_cast<size_t>(std::ceil(p / 100.0 * samples.size()));
+    return samples[std::min(samples.size(), std::max<size_t>(rank, 1)) - 1];
+  }
+
+  static BenchmarkResult Summarize(const std::string& name, int64_t items,
+                                   std::vector<double> samples) {
+    std::sort(samples.begin(), samples.end());
+    BenchmarkResult r;
+    r.name = name;
+    r.repetitions = samples.size();
+    r.items = items;
+    r.min_sec = samples.front();
+    size_t mid = samples.size() / 2;
+    r.median_sec = samples.size() % 2
+                       ? samples[mid]
+                       : (samples[mid - 1] + samples[mid]) / 2;
+    r.p99_sec = Percentile(samples, 99);
+    double sum = 0;
+    for (double s : samples)
+      sum += s;
+    r.mean_sec = sum / samples.size();
+    double var = 0;
+    for (double s : samples)
+      var += (s - r.mean_sec) * (s - r.mean_sec);
+    r.stddev_sec = std::sqrt(var / samples.size());
+    return r;
+  }
+
+  void ReportText(std::ostream& out) const {
+    size_t width = 20;
+    for (const auto& r : results_)
+      width = std::max(width, r.name.size() + 2);
+    out << std::left << std::setw(width) << "name" << std::right << std::setw(6)
+        << "reps" << std::setw(12) << "median(s)" << std::setw(12) << "p99(s)"
+        << std::setw(12) << "min(s)" << std::setw(12) << "stddev(s)"
+        << std::setw(14) << "items/s" << std::endl;
+    for (const auto& r : results_) {
+      out << std::left << std::setw(width) << r.name << std::right
+          << std::setw(6) << r.repetitions << std::setprecision(4)
+          << std::setw(12) << r.median_sec << std::setw(12) << r.p99_sec
+          << std::setw(12) << r.min_sec << std::setw(12) << r.stddev_sec
+          << std::setw(14) << r.items_per_sec() << std::endl;
+    }
+  }
+
+  void ReportCsv(std::ostream& out) const {
+    out << "name,repetitions,items,median_sec,p99_sec,min_sec,mean_sec,"
+           "stddev_sec,items_per_sec"
+        << std::endl;
+    out << std::setprecision(9);
+    for (const auto& r : results_) {
+      out << r.name << "," << r.repetitions << "," << r.items << ","
+          << r.median_sec << "," << r.p99_sec << "," << r.min_sec << ","
+          << r.mean_sec << "," << r.stddev_sec << "," << r.items_per_sec()
+          << std::endl;
+    }
+  }
+
+  void ReportJson(std::ostream& out) const {
+    out << std::setprecision(9) << "[" << std::endl;
+    for (size_t i = 0; i < results_.size(); i++) {
+      const auto& r = results_[i];
+      out << "  {\"name\": \"" << r.name << "\", \"repetitions\": "
+          << r.repetitions << ", \"items\": " << r.items
+          << ", \"median_sec\": " << r.median_sec
+          << ", \"p99_sec\": " << r.p99_sec << ", \"min_sec\": " << r.min_sec
+          << ", \"mean_sec\": " << r.mean_sec
+          << ", \"stddev_sec\": " << r.stddev_sec
+          << ", \"items_per_sec\": " << r.items_per_sec() << "}"
+          << (i + 1 < results_.size() ? "," : "") << std::endl;
+    }
+    out << "]" << std::endl;
+  }
+
+  BenchmarkOptions options_;
+  std::vector<BenchmarkResult> results_;
+};
+
+#endif  // BENCH_HARNESS_H_
@@ -0,0 +1,212 @@
+// Compressed adjacency lists.
+//
+// Every neighbour list is sorted and stored as gaps: the first neighbour
+// relative to the vertex itself (zigzag encoded, so it may be smaller), the
+// rest relative to the previous neighbour. Gaps are written either as
+//
+//   kVarint:      LEB128, 7 bits per byte.
+//   kGroupVarint: groups of 4 gaps behind one tag byte holding their byte
+//                 lengths (1-4 each). This is the layout SIMD decoders use;
+//                 a group is decoded by StreamVByte::DecodeGroup(), with a
+//                 single pshufb when built with make SIMD=1.
+//
+// Each list starts with its degree as a LEB128 varint, so besides the
+// stream only a byte offset per vertex is kept. Neighbours are read through
+// ForEachNeighbor() or a NeighborCursor, decoding on the fly.
+#ifndef COMMON_COMPRESSED_GRAPH_H_
+#define COMMON_COMPRESSED_GRAPH_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "csr_graph.h"
+#include "stream_vbyte.h"
+
+class CompressedGraph {
+ public:
+  enum class Encoding { kVarint, kGroupVarint };
+
+  CompressedGraph(const CsrGraph& graph, Encoding encoding)
+      : encoding_(encoding), num_edges_(graph.num_edges()) {
+    int n = graph.num_vertexes();
+    offsets_.reserve(n + 1);
+    std::vector<int> neighbours;
+    std::vector<uint32_t> gaps;
+    for (int v = 0; v < n; v++) {
+      offsets_.push_back(bytes_.size());
+      neighbours.assign(graph.begin(v), graph.end(v));
+      std::sort(neighbours.begin(), neighbours.end());
+      gaps.clear();
+      int previous = v;
+      for (size_t i = 0; i < neighbours.size(); i++) {
+        gaps.push_back(i == 0 ? ZigZag(neighbours[0] - v)
+                              : neighbours[i] - previous);
+        previous = neighbours[i];
+      }
+      PutVarint(neighbours.size());
+      if (encoding_ == Encoding::kVarint) {
+        for (uint32_t gap : gaps)
+          PutVarint(gap);
+      } else {
+        for (size_t i = 0; i < gaps.size(); i += 4)
+          PutGroup(&gaps[i], std::min<size_t>(4, gaps.size() - i));
+      }
+    }
+    offsets_.push_back(bytes_.size());
+    // Decoders may load 16 bytes past the last group.
+    bytes_.resize(bytes_.size() + kPadding, 0);
+    bytes_.shrink_to_fit();
+  }
+
+  int num_vertexes() const { return static_cast<int>(offsets_.size()) - 1; }
+  int64_t num_edges() const { return num_edges_; }
+  Encoding encoding() const { return encoding_; }
+
+  int degree(int v) const {
+    const uint8_t* p = &bytes_[offsets_[v]];
+    return static_cast<int>(GetVarint(&p));
+  }
+
+  // Bytes used by the gap stream, and by the stream plus the offsets.
+  size_t stream_bytes() const { return bytes_.size() - kPadding; }
+  size_t memory_bytes() const {
+    return bytes_.size() + offsets_.size() * sizeof(offsets_[0]);
+  }
+
+  // Calls |fn(neighbour)| for every neighbour of |v| in increasing order.
+  template <typename Fn>
+  void ForEachNeighbor(int v, Fn fn) const {
+    const uint8_t* p = &bytes_[offsets_[v]];
+    uint32_t count = GetVarint(&p);
+    if (count == 0)
+      return;
+    int current = v;
+    if (encoding_ == Encoding::kVarint) {
+      current += UnZigZag(GetVarint(&p));
+      fn(current);
+      for (uint32_t i = 1; i < count; i++) {
+        current += GetVarint(&p);
+        fn(current);
+      }
+      return;
+    }
+    uint32_t gaps[4];
+    for (uint32_t i = 0; i < count; i += 4) {
+      DecodeGroup(&p, gaps);
+      uint32_t group = std::min<uint32_t>(4, count - i);
+      for (uint32_t j = 0; j < group; j++) {
+        current +=
+            (i + j == 0) ? UnZigZag(gaps[0]) : static_cast<int>(gaps[j]);
+        fn(current);
+      }
+    }
+  }
+
+  // Pull-style iterator over the neighbours of one vertex:
+  //   for (NeighborCursor c(graph, v); !c.done(); c.Next()) use(c.value());
+  class NeighborCursor {
+   public:
+    NeighborCursor(const CompressedGraph& graph, int v)
+        : graph_(graph), p_(&graph.bytes_[graph.offsets_[v]]),
+          remaining_(GetVarint(&p_)), value_(v), first_(true), buffered_(0),
+          next_(0) {
+      Next();
+    }
+
+    bool done() const { return done_; }
+    int value() const { return value_; }
+
+    void Next() {
+      if (remaining_ == 0) {
+        done_ = true;
+        return;
+      }
+      remaining_--;
+      uint32_t gap;
+      if (graph_.encoding_ == Encoding::kVarint) {
+        gap = GetVarint(&p_);
+      } else {
+        if (next_ == buffered_) {
+          DecodeGroup(&p_, buffer_);
+          buffered_ = 4;
+          next_ = 0;
+        }
+        gap = buffer_[next_++];
+      }
+      value_ += first_ ? UnZigZag(gap) : static_cast<int>(gap);
+      first_ = false;
+    }
+
+   private:
+    const CompressedGraph& graph_;
+    const uint8_t* p_;
+    uint32_t remaining_;
+    int value_;
+    bool first_;
+    bool done_ = false;
+    uint32_t buffer_[4];
+    int buffered_;
+    int next_;
+  };
+
+ private:
+  static constexpr size_t kPadding = 16;
+
+  static uint32_t ZigZag(int x) {
+    return (static_cast<uint32_t>(x) << 1) ^ static_cast<uint32_t>(x >> 31);
+  }
+  static int UnZigZag(uint32_t x) {
+    return static_cast<int>(x >> 1) ^ -static_cast<int>(x & 1);
+  }
+
+  void PutVarint(uint32_t x) {
+    while (x >= 0x80) {
+      bytes_.push_back(static_cast<uint8_t>(x | 0x80));
+      x >>= 7;
+    }
+    bytes_.push_back(static_cast<uint8_t>(x));
+  }
+
+  static uint32_t GetVarint(const uint8_t** p) {
+    uint32_t x = 0;
+    for (int shift = 0;; shift += 7) {
+      uint8_t b = *(*p)++;
+      x |= static_cast<uint32_t>(b & 0x7f) << shift;
+      if (b < 0x80)
+        return x;
+    }
+  }
+
+  static int ByteLength(uint32_t x) {
+    return x < (1u << 8) ? 1 : x < (1u << 16) ? 2 : x < (1u << 24) ? 3 : 4;
+  }
+
+  // Writes up to 4 gaps; missing ones are written as 1-byte zeros.
+  void PutGroup(const uint32_t* gaps, size_t count) {
+    size_t tag_pos = bytes_.size();
+    bytes_.push_back(0);
+    uint8_t tag = 0;
+    for (size_t i = 0; i < 4; i++) {
+      uint32_t x = i < count ? gaps[i] : 0;
+      int length = ByteLength(x);
+      tag |= (length - 1) << (2 * i);
+      for (int b = 0; b < length; b++)
+        bytes_.push_back(static_cast<uint8_t>(x >> (8 * b)));
+    }
+    bytes_[tag_pos] = tag;
+  }
+
+  static void DecodeGroup(const uint8_t** p, uint32_t* out) {
+    uint8_t tag = *(*p)++;
+    *p += StreamVByte::DecodeGroup(tag, *p, out);
+  }
+
+  Encoding encoding_;
+  int64_t num_edges_;
+  std::vector<uint64_t> offsets_;
+  std::vector<uint8_t> bytes_;
+};
+
+#endif  // COMMON_COMPRESSED_GRAPH_H_
@@ -0,0 +1,717 @@
+// Compressed sparse row (CSR) graph and loaders for the links.txt /
+// pages.txt (or nicknames.txt) format used by the homework programs.
+//
+//   links.txt: "<src>\t<dst>" or "<src>\t<dst>\t<weight>" per line, in any
+//              order, or the binary format of LoadBinaryLinks()
+//   pages.txt: "<id>\t<name>" per line, ids are 0, 1, 2, ...
+#ifndef COMMON_CSR_GRAPH_H_
+#define COMMON_CSR_GRAPH_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "graph_memory.h"
+#include "instrumentation.h"
+#include "parallel.h"
+#include "perf_counters.h"
+#include "stream_vbyte.h"
+
+class CsrGraph {
+ public:
+  CsrGraph() : offsets_(1, 0) {}
+
+  // Builds a graph with |num_vertexes| vertexes from an edge list. Edges do
+  // not need to be sorted. Neighbours of each vertex keep the input order.
+  static CsrGraph FromEdges(int num_vertexes,
+                            const std::vector<std::pair<int, int>>& edges) {
+    CsrGraph graph;
+    graph.offsets_.assign(num_vertexes + 1, 0);
+    for (const auto& e : edges)
+      graph.offsets_[e.first + 1]++;
+    for (int v = 0; v < num_vertexes; v++)
+      graph.offsets_[v + 1] += graph.offsets_[v];
+    graph.targets_.resize(edges.size());
+    std::vector<int64_t> pos(graph.offsets_.begin(), graph.offsets_.end() - 1);
+    for (const auto& e : edges)
+      graph.targets_[pos[e.first]++] = e.second;
+    return graph;
+  }
+
+  // Builds a graph with |num_vertexes| vertexes from another adjacency
+  // structure: |degree(v)| is the length of the list of v and
+  // |for_each(v, fn)| calls fn(w) for each of its entries, in order. The
+  // offsets are a prefix sum of the degrees and the lists are copied in
+  // parallel, with no edge list in between.
+  template <typename DegreeFn, typename ForEachFn>
+  static CsrGraph FromAdjacency(int num_vertexes, DegreeFn degree,
+                                ForEachFn for_each) {
+    const int64_t kGrain = 4096;
+    CsrGraph graph;
+    graph.offsets_.assign(num_vertexes + 1, 0);
+    for (int v = 0; v < num_vertexes; v++)
+      graph.offsets_[v + 1] = graph.offsets_[v] + degree(v);
+    graph.targets_.resize(graph.offsets_[num_vertexes]);
+    ParallelFor(0, num_vertexes, kGrain, [&](int64_t v) {
+      int* out = graph.targets_.data() + graph.offsets_[v];
+      for_each(static_cast<int>(v), [&out](int w) { *out++ = w; });
+    });
+    return graph;
+  }
+
+  // Builds a graph with |num_vertexes| vertexes from edge lists in any
+  // order, in parallel and in linear time apart from sorting each neighbour
+  // list: the edges are bucketed by source with a counting sort (atomic
+  // counters, so no per-thread histograms of |num_vertexes| entries), then
+  // every list is sorted and duplicate edges are dropped.
+  static CsrGraph FromUnsortedEdges(
+      int num_vertexes,
+      const std::vector<std::vector<std::pair<int, int>>>& parts) {
+    INSTRUMENT_SCOPE("CsrGraph::FromUnsortedEdges");
+    const int64_t kGrain = 4096;
+    int n = num_vertexes;
+    std::unique_ptr<std::atomic<int64_t>[]> cursor(
+        new std::atomic<int64_t>[n + 1]);
+    ParallelFor(0, n + 1, kGrain, [&](int64_t v) {
+      cursor[v].store(0, std::memory_order_relaxed);
+    });
+    ParallelFor(0, parts.size(), 1, [&](int64_t p) {
+      for (const auto& e : parts[p])
+        cursor[e.first + 1].fetch_add(1, std::memory_order_relaxed);
+    });
+    GraphVector<int64_t> bucket(n + 1, 0);
+    for (int v = 0; v < n; v++) {
+      bucket[v + 1] = bucket[v] + cursor[v + 1].load(std::memory_order_relaxed);
+      cursor[v].store(bucket[v], std::memory_order_relaxed);
+    }
+    GraphVector<int> unsorted(bucket[n]);
+    ParallelFor(0, parts.size(), 1, [&](int64_t p) {
+      for (const auto& e : parts[p]) {
+        unsorted[cursor[e.first].fetch_add(1, std::memory_order_relaxed)] =
+            e.second;
+      }
+    });
+    cursor.reset();
+
+    CsrGraph graph;
+    graph.offsets_.assign(n + 1, 0);
+    ParallelFor(0, n, kGrain, [&](int64_t v) {
+      auto first = unsorted.begin() + bucket[v];
+      auto last = unsorted.begin() + bucket[v + 1];
+      std::sort(first, last);
+      graph.offsets_[v + 1] = std::unique(first, last) - first;
+    });
+    for (int v = 0; v < n; v++)
+      graph.offsets_[v + 1] += graph.offsets_[v];
+    graph.targets_.resize(graph.offsets_[n]);
+    ParallelFor(0, n, kGrain, [&](int64_t v) {
+      std::copy(unsorted.begin() + bucket[v],
+                unsorted.begin() + bucket[v] + graph.degree(v),
+                graph.targets_.begin() + graph.offsets_[v]);
+    });
+    return graph;
+  }
+
+  int num_vertexes() const { return static_cast<int>(offsets_.size()) - 1; }
+  int64_t num_edges() const { return static_cast<int64_t>(targets_.size()); }
+
+  int degree(int v) const {
+    return static_cast<int>(offsets_[v + 1] - offsets_[v]);
+  }
+  const int* begin(int v) const { return targets_.data() + offsets_[v]; }
+  const int* end(int v) const { return targets_.data() + offsets_[v + 1]; }
+
+  // Same interface as CompressedGraph and DynamicGraph::Snapshot, for the
+  // kernels of graph_kernels.h.
+  template <typename Fn>
+  void ForEachNeighbor(int v, Fn fn) const {
+    for (const int* it = begin(v); it != end(v); ++it)
+      fn(*it);
+  }
+
+  const GraphVector<int64_t>& offsets() const { return offsets_; }
+  const GraphVector<int>& targets() const { return targets_; }
+
+  // Returns the graph with every edge flipped.
+  CsrGraph Reversed() const {
+    CsrGraph reversed;
+    int n = num_vertexes();
+    reversed.offsets_.assign(n + 1, 0);
+    for (int dst : targets_)
+      reversed.offsets_[dst + 1]++;
+    for (int v = 0; v < n; v++)
+      reversed.offsets_[v + 1] += reversed.offsets_[v];
+    reversed.targets_.resize(targets_.size());
+    std::vector<int64_t> pos(reversed.offsets_.begin(),
+                             reversed.offsets_.end() - 1);
+    for (int src = 0; src < n; src++) {
+      for (const int* it = begin(src); it != end(src); ++it)
+        reversed.targets_[pos[*it]++] = src;
+    }
+    return reversed;
+  }
+
+  // Returns the undirected version of the graph: every link in both
+  // directions, neighbour lists sorted, without duplicates or self loops.
+  // The out-lists are copied in parallel and the in-lists appended in one
+  // pass, so at most 2 * num_edges() ids are held besides the result.
+  CsrGraph Symmetrized() const {
+    INSTRUMENT_SCOPE("CsrGraph::Symmetrized");
+    const int64_t kGrain = 4096;
+    int n = num_vertexes();
+    GraphVector<int64_t> bucket(n + 1, 0);
+    for (int dst : targets_)
+      bucket[dst + 1]++;
+    for (int v = 0; v < n; v++)
+      bucket[v + 1] += bucket[v] + degree(v);
+    GraphVector<int> unsorted(bucket[n]);
+    ParallelFor(0, n, kGrain, [&](int64_t v) {
+      std::copy(begin(v), end(v), unsorted.begin() + bucket[v]);
+    });
+    std::vector<int64_t> pos(n);
+    for (int v = 0; v < n; v++)
+      pos[v] = bucket[v] + degree(v);
+    for (int src = 0; src < n; src++) {
+      for (const int* it = begin(src); it != end(src); ++it)
+        unsorted[pos[*it]++] = src;
+    }
+
+    CsrGraph graph;
+    graph.offsets_.assign(n + 1, 0);
+    ParallelFor(0, n, kGrain, [&](int64_t v) {
+      auto first = unsorted.begin() + bucket[v];
+      auto last = unsorted.begin() + bucket[v + 1];
+      std::sort(first, last);
+      last = std::unique(first, last);
+      last = std::remove(first, last, static_cast<int>(v));
+      graph.offsets_[v + 1] = last - first;
+    });
+    for (int v = 0; v < n; v++)
+      graph.offsets_[v + 1] += graph.offsets_[v];
+    graph.targets_.resize(graph.offsets_[n]);
+    ParallelFor(0, n, kGrain, [&](int64_t v) {
+      std::copy(unsorted.begin() + bucket[v],
+                unsorted.begin() + bucket[v] + graph.degree(v),
+                graph.targets_.begin() + graph.offsets_[v]);
+    });
+    return graph;
+  }
+
+  // Vertexes [begin, end) with their links as a graph of end - begin
+  // vertexes; link targets keep their ids in this graph.
+  CsrGraph Slice(int begin, int end) const {
+    CsrGraph slice;
+    slice.offsets_.resize(end - begin + 1);
+    for (int v = begin; v <= end; v++)
+      slice.offsets_[v - begin] = offsets_[v] - offsets_[begin];
+    slice.targets_.assign(targets_.begin() + offsets_[begin],
+                          targets_.begin() + offsets_[end]);
+    return slice;
+  }
+
+  // Sorts every neighbour list by id so that it can be binary searched or
+  // merged.
+  void SortNeighbors() {
+    for (int v = 0; v < num_vertexes(); v++)
+      std::sort(targets_.begin() + offsets_[v],
+                targets_.begin() + offsets_[v + 1]);
+  }
+
+  // Appends isolated vertexes so that the graph has at least |n| vertexes.
+  void EnsureVertexes(int n) {
+    while (num_vertexes() < n)
+      offsets_.push_back(offsets_.back());
+  }
+
+ private:
+  friend std::unique_ptr<CsrGraph> LoadBinaryLinks(const char* path);
+
+  GraphVector<int64_t> offsets_;
+  GraphVector<int> targets_;
+};
+
+// Parses the links of [begin, end), which must start at a line and end
+// after a newline or at the end of the file, into |edges|. Lines are
+// "<src> <dst>" separated by spaces or tabs; blank lines and lines starting
+// with '#' are skipped. An optional third column holds a non-negative
+// integer weight, appended to |weights| if given (1 when missing) and
+// ignored otherwise. Returns the first malformed character, or nullptr.
+inline const char* ParseLinks(const char* begin, const char* end,
+                              std::vector<std::pair<int, int>>* edges,
+                              int* max_id,
+                              std::vector<uint32_t>* weights = nullptr) {
+  const char* p = begin;
+  auto skip_blanks = [&] {
+    while (p != end && (*p == ' ' || *p == '\t' || *p == '\r'))
+      ++p;
+  };
+  auto parse_id = [&](int* id) {
+    if (p == end || *p < '0' || *p > '9')
+      return false;
+    int64_t value = 0;
+    while (p != end && *p >= '0' && *p <= '9') {
+      value = value * 10 + (*p++ - '0');
+      if (value > INT32_MAX - 1)
+        return false;
+    }
+    *id = static_cast<int>(value);
+    return true;
+  };
+  while (p != end) {
+    skip_blanks();
+    if (p != end && *p == '#') {
+      while (p != end && *p != '\n')
+        ++p;
+    }
+    if (p == end)
+      break;
+    if (*p == '\n') {
+      ++p;
+      continue;
+    }
+    int src, dst;
+    if (!parse_id(&src))
+      return p;
+    skip_blanks();
+    if (!parse_id(&dst))
+      return p;
+    skip_blanks();
+    int weight = 1;
+    if (p != end && *p != '\n') {
+      if (!parse_id(&weight))
+        return p;
+      skip_blanks();
+      if (p != end && *p != '\n')
+        return p;
+    }
+    if (weights)
+      weights->push_back(weight);
+    edges->emplace_back(src, dst);
+    *max_id = std::max(*max_id, std::max(src, dst));
+  }
+  return nullptr;
+}
+
+// Reads links.txt as text. The links may come in any order and repeat;
+// the file is parsed in parallel chunks and CsrGraph::FromUnsortedEdges()
+// builds the graph. Ids missing from the file, including those past the
+// last source, become isolated vertexes up to the largest id. Returns
+// nullptr on error.
+inline std::unique_ptr<CsrGraph> LoadTextLinks(const char* links_path) {
+  INSTRUMENT_SCOPE("LoadTextLinks");
+  PerfScope perf("LoadTextLinks");
+  std::ifstream links_stream(links_path, std::ios::binary);
+  if (links_stream.fail()) {
+    std::cerr << "file not found: " << links_path << std::endl;
+    return nullptr;
+  }
+  std::vector<char> data;
+  {
+    INSTRUMENT_SCOPE("LoadTextLinks::Read");
+    links_stream.seekg(0, std::ios::end);
+    data.resize(static_cast<size_t>(links_stream.tellg()));
+    links_stream.seekg(0, std::ios::beg);
+    if (!links_stream.read(data.data(), data.size())) {
+      std::cerr << "failed to read " << links_path << std::endl;
+      return nullptr;
+    }
+  }
+
+  // Chunks start after a newline so that no line is split.
+  const char* begin = data.data();
+  const char* end = begin + data.size();
+  int num_chunks = std::max<int64_t>(
+      1, std::min<int64_t>(4 * NumThreads(), data.size() >> 16));
+  std::vector<const char*> bounds(num_chunks + 1, end);
+  bounds[0] = begin;
+  for (int c = 1; c < num_chunks; c++) {
+    const char* p = std::max(bounds[c - 1], begin + data.size() * c /
+                                                        num_chunks);
+    while (p != end && p[-1] != '\n')
+      ++p;
+    bounds[c] = p;
+  }
+  std::vector<std::vector<std::pair<int, int>>> parts(num_chunks);
+  std::vector<int> max_ids(num_chunks, -1);
+  std::vector<const char*> errors(num_chunks, nullptr);
+  {
+    INSTRUMENT_SCOPE("LoadTextLinks::Parse");
+    ParallelFor(0, num_chunks, 1, [&](int64_t c) {
+      parts[c].reserve((bounds[c + 1] - bounds[c]) / 8);
+      errors[c] = ParseLinks(bounds[c], bounds[c + 1], &parts[c],
+                             &max_ids[c]);
+    });
+  }
+  int max_id = -1;
+  int64_t num_links = 0;
+  for (int c = 0; c < num_chunks; c++) {
+    if (errors[c]) {
+      std::cerr << "unexpected error: line "
+                << std::count(begin, errors[c], '\n') + 1 << std::endl;
+      return nullptr;
+    }
+    max_id = std::max(max_id, max_ids[c]);
+    num_links += parts[c].size();
+  }
+  INSTRUMENT_COUNT("load.bytes", data.size());
+  INSTRUMENT_COUNT("load.links", num_links);
+  perf.AddItems(num_links);
+  std::vector<char>().swap(data);
+  auto graph = std::make_unique<CsrGraph>(
+      CsrGraph::FromUnsortedEdges(max_id + 1, parts));
+  INSTRUMENT_COUNT("load.duplicates", num_links - graph->num_edges());
+  return graph;
+}
+
+// Size and modification time of a file, kept in the header of every file
+// derived from it (an index, an oracle, ...) so that the derived file is
+// rebuilt once the source changes. size is -1 if the file does not exist.
+struct FileStamp {
+  int64_t size;
+  int64_t mtime_ns;
+};
+
+inline FileStamp StampOf(const char* path) {
+  struct stat st;
+  if (stat(path, &st) != 0)
+    return FileStamp{-1, 0};
+  return FileStamp{st.st_size,
+                   static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 +
+                       st.st_mtim.tv_nsec};
+}
+
+inline bool operator==(const FileStamp& a, const FileStamp& b) {
+  return a.size == b.size && a.mtime_ns == b.mtime_ns;
+}
+
+inline bool operator!=(const FileStamp& a, const FileStamp& b) {
+  return !(a == b);
+}
+
+// Binary links files, written by WriteBinaryLinks() (see
+// bench/convert_links.cc):
+//
+//   BinaryLinksHeader
+//   BinaryLinksBlock index[num_blocks + 1]  (the last one marks the end)
+//   blocks
+//
+// Sources are sorted and cut into blocks of about kBinaryBlockEdges links.
+// A block holds the degrees of its vertexes and then the gaps of their
+// sorted neighbour lists (the first neighbour zigzag encoded relative to
+// the vertex, as in compressed_graph.h), each as one StreamVByte stream.
+// With the index every block is read with one pread and decoded straight
+// into place, all blocks in parallel. Fields are little endian.
+struct BinaryLinksHeader {
+  char magic[4];  // kBinaryLinksMagic
+  uint32_t reserved;
+  int64_t num_vertexes;
+  int64_t num_edges;
+  int64_t num_blocks;
+  FileStamp source;  // of the text file it was converted from, or size -1
+};
+
+struct BinaryLinksBlock {
+  int64_t offset;  // in the file
+  int64_t first_vertex;
+  int64_t first_edge;
+};
+
+const char kBinaryLinksMagic[4] = {'S', 'V', 'B', '2'};
+// LoadLinks("links.txt") reads "links.txt.svb" instead when it was
+// converted from links.txt as it is now.
+const char kBinaryLinksSuffix[] = ".svb";
+const int64_t kBinaryBlockEdges = 1 << 16;
+const int64_t kBinaryBlockVertexes = 1 << 16;
+
+// Writes |graph|, whose neighbour lists must be sorted, to |path|.
+// |source| identifies the text file |graph| was read from, if any. Returns
+// false on error.
+inline bool WriteBinaryLinks(const CsrGraph& graph, const char* path,
+                             const FileStamp& source = FileStamp{-1, 0}) {
+  INSTRUMENT_SCOPE("WriteBinaryLinks");
+  int n = graph.num_vertexes();
+  std::vector<BinaryLinksBlock> index;
+  for (int v = 0; v < n;) {
+    index.push_back(BinaryLinksBlock{0, v, graph.offsets()[v]});
+    int end = v;
+    while (end < n && end - v < kBinaryBlockVertexes &&
+           graph.offsets()[end] - graph.offsets()[v] < kBinaryBlockEdges)
+      end++;
+    v = end;
+  }
+  index.push_back(BinaryLinksBlock{0, n, graph.num_edges()});
+
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  if (out.fail()) {
+    std::cerr << "failed to open " << path << std::endl;
+    return false;
+  }
+  BinaryLinksHeader header;
+  std::memcpy(header.magic, kBinaryLinksMagic, 4);
+  header.reserved = 0;
+  header.num_vertexes = n;
+  header.num_edges = graph.num_edges();
+  header.num_blocks = index.size() - 1;
+  header.source = source;
+  int64_t offset = sizeof(header) + index.size() * sizeof(index[0]);
+  // The index is written again once the block offsets are known.
+  out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  out.write(reinterpret_cast<const char*>(index.data()),
+            index.size() * sizeof(index[0]));
+
+  std::vector<uint32_t> values;
+  std::vector<uint8_t> bytes;
+  for (size_t b = 0; b + 1 < index.size(); b++) {
+    index[b].offset = offset;
+    int first = index[b].first_vertex;
+    int last = index[b + 1].first_vertex;
+    size_t size = 0;
+    values.clear();
+    for (int v = first; v < last; v++)
+      values.push_back(graph.degree(v));
+    bytes.resize(StreamVByte::MaxEncodedBytes(values.size()));
+    size = StreamVByte::Encode(values.data(), values.size(), bytes.data());
+    out.write(reinterpret_cast<const char*>(bytes.data()), size);
+    offset += size;
+
+    values.clear();
+    for (int v = first; v < last; v++) {
+      int previous = v;
+      for (const int* it = graph.begin(v); it != graph.end(v); ++it) {
+        if (it != graph.begin(v) && *it < previous) {
+          std::cerr << "neighbours of " << v << " are not sorted"
+                    << std::endl;
+          return false;
+        }
+        int gap = *it - previous;
+        values.push_back(it == graph.begin(v)
+                             ? (static_cast<uint32_t>(gap) << 1) ^
+                                   static_cast<uint32_t>(gap >> 31)
+                             : static_cast<uint32_t>(gap));
+        previous = *it;
+      }
+    }
+    bytes.resize(StreamVByte::MaxEncodedBytes(values.size()));
+    size = StreamVByte::Encode(values.data(), values.size(), bytes.data());
+    out.write(reinterpret_cast<const char*>(bytes.data()), size);
+    offset += size;
+  }
+  index.back().offset = offset;
+  out.seekp(sizeof(header));
+  out.write(reinterpret_cast<const char*>(index.data()),
+            index.size() * sizeof(index[0]));
+  out.close();
+  if (out.fail()) {
+    std::cerr << "failed to write " << path << std::endl;
+    return false;
+  }
+  return true;
+}
+
+// Reads the header of a binary links file. Returns false if |path| does not
+// start with one.
+inline bool ReadBinaryLinksHeader(const char* path,
+                                  BinaryLinksHeader* header) {
+  std::ifstream in(path, std::ios::binary);
+  return in.read(reinterpret_cast<char*>(header), sizeof(*header)) &&
+         std::memcmp(header->magic, kBinaryLinksMagic, 4) == 0;
+}
+
+inline bool IsBinaryLinks(const char* path) {
+  BinaryLinksHeader header;
+  return ReadBinaryLinksHeader(path, &header);
+}
+
+// Reads a file written by WriteBinaryLinks(). Returns nullptr on error,
+// including any inconsistency in the file.
+inline std::unique_ptr<CsrGraph> LoadBinaryLinks(const char* path) {
+  INSTRUMENT_SCOPE("LoadBinaryLinks");
+  PerfScope perf("LoadBinaryLinks");
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    std::cerr << "file not found: " << path << std::endl;
+    return nullptr;
+  }
+  auto read_at = [fd](void* buffer, size_t bytes, int64_t offset) {
+    char* p = static_cast<char*>(buffer);
+    while (bytes > 0) {
+      ssize_t r = pread(fd, p, bytes, offset);
+      if (r <= 0)
+        return false;
+      p += r;
+      bytes -= r;
+      offset += r;
+    }
+    return true;
+  };
+  auto fail = [&](const char* what) {
+    std::cerr << "broken links file " << path << ": " << what << std::endl;
+    close(fd);
+    return nullptr;
+  };
+
+  struct stat st;
+  BinaryLinksHeader header;
+  if (fstat(fd, &st) != 0 || !read_at(&header, sizeof(header), 0) ||
+      std::memcmp(header.magic, kBinaryLinksMagic, 4) != 0)
+    return fail("bad header");
+  int64_t n = header.num_vertexes;
+  int64_t m = header.num_edges;
+  if (n < 0 || n >= INT32_MAX || m < 0 || header.num_blocks < 0 ||
+      header.num_blocks > n)
+    return fail("bad header");
+  // Every block takes an index entry, and every vertex and link at least a
+  // byte, so the counts are bounded by the file size before anything is
+  // allocated from them.
+  int64_t data_bytes = static_cast<int64_t>(st.st_size) -
+                       static_cast<int64_t>(sizeof(header));
+  if ((header.num_blocks + 1) >
+          data_bytes / static_cast<int64_t>(sizeof(BinaryLinksBlock)) ||
+      n > data_bytes || m > data_bytes - n)
+    return fail("counts exceed the file size");
+  std::vector<BinaryLinksBlock> index(header.num_blocks + 1);
+  if (!read_at(index.data(), index.size() * sizeof(index[0]),
+               sizeof(header)))
+    return fail("truncated index");
+  for (size_t b = 0; b < index.size(); b++) {
+    const BinaryLinksBlock& block = index[b];
+    bool ok = b == 0 ? block.first_vertex == 0 && block.first_edge == 0 &&
+                           block.offset == static_cast<int64_t>(
+                               sizeof(header) + index.size() * sizeof(index[0]))
+                     : block.first_vertex > index[b - 1].first_vertex &&
+                           block.first_edge >= index[b - 1].first_edge &&
+                           block.offset >= index[b - 1].offset;
+    if (!ok)
+      return fail("bad index");
+  }
+  if (index.back().first_vertex != n || index.back().first_edge != m ||
+      index.back().offset > st.st_size)
+    return fail("bad index");
+
+  auto graph = std::make_unique<CsrGraph>();
+  graph->offsets_.resize(n + 1);
+  graph->targets_.resize(m);
+  std::vector<std::vector<uint8_t>> buffers(NumThreads());
+  std::vector<std::vector<uint32_t>> degrees(NumThreads());
+  std::atomic<bool> ok(true);
+  ParallelForWithThreadId(0, header.num_blocks, 1, [&](int tid, int64_t b) {
+    const BinaryLinksBlock& block = index[b];
+    const BinaryLinksBlock& next = index[b + 1];
+    int first = block.first_vertex;
+    int num_vertexes = next.first_vertex - first;
+    int64_t num_edges = next.first_edge - block.first_edge;
+    size_t size = next.offset - block.offset;
+    std::vector<uint8_t>& buffer = buffers[tid];
+    buffer.resize(size + StreamVByte::kPadding);
+    if (!read_at(buffer.data(), size, block.offset)) {
+      ok = false;
+      return;
+    }
+    // Check both streams against the block size before decoding them.
+    const uint8_t* p = buffer.data();
+    if ((num_vertexes + 3) / 4 > static_cast<int64_t>(size)) {
+      ok = false;
+      return;
+    }
+    size_t degree_bytes = StreamVByte::EncodedBytes(p, num_vertexes);
+    if (degree_bytes + (num_edges + 3) / 4 > size ||
+        degree_bytes + StreamVByte::EncodedBytes(p + degree_bytes,
+                                                 num_edges) != size) {
+      ok = false;
+      return;
+    }
+    std::vector<uint32_t>& degree = degrees[tid];
+    degree.resize(num_vertexes);
+    p = StreamVByte::Decode(p, num_vertexes, degree.data());
+    uint32_t* gaps =
+        reinterpret_cast<uint32_t*>(graph->targets_.data() + block.first_edge);
+    StreamVByte::Decode(p, num_edges, gaps);
+
+    int64_t e = block.first_edge;
+    for (int i = 0; i < num_vertexes; i++) {
+      int v = first + i;
+      if (degree[i] > static_cast<uint64_t>(next.first_edge - e)) {
+        ok = false;
+        return;
+      }
+      int64_t end = e + degree[i];
+      int64_t current = v;
+      for (bool first_gap = true; e < end; e++, first_gap = false) {
+        uint32_t gap = static_cast<uint32_t>(graph->targets_[e]);
+        current += first_gap ? static_cast<int>(gap >> 1) ^
+                                   -static_cast<int>(gap & 1)
+                             : static_cast<int64_t>(gap);
+        if (current < 0 || current >= n) {
+          ok = false;
+          return;
+        }
+        graph->targets_[e] = static_cast<int>(current);
+      }
+      graph->offsets_[v + 1] = e;
+    }
+    if (e != next.first_edge)
+      ok = false;
+  });
+  close(fd);
+  if (!ok) {
+    std::cerr << "broken links file " << path << ": bad block" << std::endl;
+    return nullptr;
+  }
+  INSTRUMENT_COUNT("load.bytes", index.back().offset);
+  INSTRUMENT_COUNT("load.links", m);
+  perf.AddItems(m);
+  return graph;
+}
+
+// Reads the links of |links_path| in either format. A binary copy at
+// |links_path| + kBinaryLinksSuffix is read instead when its header records
+// the current size and mtime of the text file (or the text file is gone).
+// Returns nullptr on error.
+inline std::unique_ptr<CsrGraph> LoadLinks(const char* links_path) {
+  INSTRUMENT_SCOPE("LoadLinks");
+  std::string binary_path = std::string(links_path) + kBinaryLinksSuffix;
+  FileStamp text = StampOf(links_path);
+  BinaryLinksHeader binary;
+  if (ReadBinaryLinksHeader(binary_path.c_str(), &binary) &&
+      (text.size < 0 || binary.source == text))
+    return LoadBinaryLinks(binary_path.c_str());
+  if (IsBinaryLinks(links_path))
+    return LoadBinaryLinks(links_path);
+  return LoadTextLinks(links_path);
+}
+
+// Reads pages.txt / nicknames.txt into |names|. Returns false on error.
+inline bool LoadNames(const char* pages_path, std::vector<std::string>* names) {
+  INSTRUMENT_SCOPE("LoadNames");
+  std::fstream pages_stream(pages_path);
+  if (pages_stream.fail()) {
+    std::cerr << "file not found: " << pages_path << std::endl;
+    return false;
+  }
+
+  names->clear();
+  size_t id;
+  std::string name;
+  while (pages_stream >> id >> name) {
+    if (names->size() != id) {
+      std::cerr << "unmatch id" << std::endl;
+      return false;
+    }
+    names->push_back(name);
+  }
+  INSTRUMENT_COUNT("load.names", names->size());
+  return true;
+}
+
+#endif  // COMMON_CSR_GRAPH_H_
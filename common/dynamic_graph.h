@@ -0,0 +1,381 @@
+// Graph that takes edge insertions and deletions while readers traverse it.
+//
+// The adjacency is a CSR base with sorted, duplicate free neighbour lists
+// plus, per vertex, a chain of append-only delta blocks. A delta entry says
+// "insert target" or "delete target" and carries the version of the batch
+// that wrote it and the degree it leaves the vertex with, so degree() does
+// not have to merge the list. A single writer thread calls Apply(), which
+// appends the entries of a batch and then publishes the next version. A
+// Snapshot pins one version and sees exactly the edges of that version,
+// skipping entries appended after it, so a BFS or PageRank on a snapshot
+// is consistent while the writer goes on:
+//
+//   DynamicGraph graph(*LoadLinks("links.txt"));
+//   // writer thread
+//   graph.Apply({{1, 2, true}, {3, 4, false}});
+//   // reader threads
+//   DynamicGraph::Snapshot snapshot = graph.snapshot();
+//   snapshot.ForEachNeighbor(v, [&](int w) { ... });
+//
+// Only effective updates are recorded (inserting an existing edge or
+// deleting a missing one is dropped), so the newest entry for a target
+// decides whether the edge exists. Once the delta holds more entries than
+// Options::compact_ratio per base edge, Apply() folds it into a new CSR
+// base, a new generation. Snapshots keep their generation alive; it is
+// freed with the last snapshot using it.
+#ifndef COMMON_DYNAMIC_GRAPH_H_
+#define COMMON_DYNAMIC_GRAPH_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "csr_graph.h"
+#include "instrumentation.h"
+#include "parallel.h"
+
+class DynamicGraph {
+ private:
+  struct Generation;
+
+ public:
+  struct Update {
+    int src;
+    int dst;
+    bool insert;  // false deletes the edge
+  };
+
+  struct Options {
+    // Compact once the delta holds this many entries per base edge...
+    double compact_ratio = 0.25;
+    // ...and at least this many entries.
+    int64_t min_compact_entries = 1 << 16;
+  };
+
+  // An immutable view of one version. Cheap to copy; safe to use from any
+  // thread while the writer applies later batches.
+  class Snapshot {
+   public:
+    Snapshot() = default;
+
+    uint64_t version() const { return version_; }
+    int num_vertexes() const { return num_vertexes_; }
+    int64_t num_edges() const { return num_edges_; }
+
+    // Calls |fn(w)| for every out-neighbour w of |v| in increasing order.
+    template <typename Fn>
+    void ForEachNeighbor(int v, Fn fn) const {
+      const Generation& g = *generation_;
+      const int* base = nullptr;
+      const int* base_end = nullptr;
+      if (v < g.base.num_vertexes()) {
+        base = g.base.begin(v);
+        base_end = g.base.end(v);
+      }
+      // Reuse the buffer of this thread. It is taken, not borrowed, so that
+      // |fn| may itself walk a list.
+      static thread_local std::vector<std::pair<int, bool>> scratch;
+      std::vector<std::pair<int, bool>> ops;
+      ops.swap(scratch);
+      ops.clear();
+      if (v < g.capacity) {
+        // Newest entries first.
+        for (const Block* b = g.heads[v].load(std::memory_order_acquire); b;
+             b = b->next) {
+          for (int i = b->size.load(std::memory_order_acquire) - 1; i >= 0;
+               i--) {
+            const Entry& e = b->entries[i];
+            if (e.version <= version_)
+              ops.emplace_back(e.target, e.insert);
+          }
+        }
+      }
+      if (ops.empty()) {
+        scratch.swap(ops);
+        for (const int* it = base; it != base_end; ++it)
+          fn(*it);
+        return;
+      }
+      // Keep the newest entry per target and merge it with the base list.
+      std::stable_sort(ops.begin(), ops.end(),
+                       [](const std::pair<int, bool>& a,
+                          const std::pair<int, bool>& b) {
+                         return a.first < b.first;
+                       });
+      ops.erase(std::unique(ops.begin(), ops.end(),
+                            [](const std::pair<int, bool>& a,
+                               const std::pair<int, bool>& b) {
+                              return a.first == b.first;
+                            }),
+                ops.end());
+      size_t j = 0;
+      while (base != base_end || j < ops.size()) {
+        if (j == ops.size() || (base != base_end && *base < ops[j].first)) {
+          fn(*base++);
+        } else {
+          if (ops[j].second)
+            fn(ops[j].first);
+          if (base != base_end && *base == ops[j].first)
+            ++base;
+          j++;
+        }
+      }
+      if (ops.capacity() > scratch.capacity())
+        scratch.swap(ops);
+    }
+
+    // The degree recorded by the newest entry of this version, so only the
+    // entries appended after it are skipped.
+    int degree(int v) const {
+      const Generation& g = *generation_;
+      if (v < g.capacity) {
+        for (const Block* b = g.heads[v].load(std::memory_order_acquire); b;
+             b = b->next) {
+          for (int i = b->size.load(std::memory_order_acquire) - 1; i >= 0;
+               i--) {
+            const Entry& e = b->entries[i];
+            if (e.version <= version_)
+              return e.degree;
+          }
+        }
+      }
+      return v < g.base.num_vertexes() ? g.base.degree(v) : 0;
+    }
+
+    // Materializes this version as a CSR graph with sorted neighbours.
+    CsrGraph ToCsr() const {
+      int n = num_vertexes_;
+      std::vector<int64_t> offsets(n + 1, 0);
+      ParallelFor(0, n, 1024,
+                  [&](int64_t v) { offsets[v + 1] = degree(v); });
+      for (int v = 0; v < n; v++)
+        offsets[v + 1] += offsets[v];
+      std::vector<std::pair<int, int>> edges(offsets[n]);
+      ParallelFor(0, n, 1024, [&](int64_t v) {
+        int64_t pos = offsets[v];
+        ForEachNeighbor(v, [&](int w) {
+          edges[pos++] = std::make_pair(static_cast<int>(v), w);
+        });
+      });
+      return CsrGraph::FromEdges(n, edges);
+    }
+
+   private:
+    friend class DynamicGraph;
+
+    std::shared_ptr<const Generation> generation_;
+    uint64_t version_ = 0;
+    int num_vertexes_ = 0;
+    int64_t num_edges_ = 0;
+  };
+
+  explicit DynamicGraph(const CsrGraph& base)
+      : DynamicGraph(base, Options()) {}
+
+  DynamicGraph(const CsrGraph& base, const Options& options)
+      : options_(options) {
+    std::vector<std::pair<int, int>> edges;
+    edges.reserve(base.num_edges());
+    for (int v = 0; v < base.num_vertexes(); v++) {
+      size_t first = edges.size();
+      for (const int* it = base.begin(v); it != base.end(v); ++it)
+        edges.emplace_back(v, *it);
+      std::sort(edges.begin() + first, edges.end());
+      edges.erase(std::unique(edges.begin() + first, edges.end()),
+                  edges.end());
+    }
+    num_vertexes_ = base.num_vertexes();
+    num_edges_ = edges.size();
+    generation_ = std::make_shared<Generation>(
+        CsrGraph::FromEdges(num_vertexes_, edges), Capacity(num_vertexes_));
+    Publish();
+  }
+
+  // The latest published version. May be called from any thread.
+  Snapshot snapshot() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return current_;
+  }
+
+  // Applies |batch| in order as one new version. Only one thread may call
+  // Apply() at a time. Returns false, changing nothing, if the batch has a
+  // negative vertex id.
+  bool Apply(const std::vector<Update>& batch) {
+    INSTRUMENT_SCOPE("DynamicGraph::Apply");
+    int max_id = -1;
+    for (const Update& u : batch) {
+      if (u.src < 0 || u.dst < 0) {
+        std::cerr << "invalid edge: " << u.src << " " << u.dst << std::endl;
+        return false;
+      }
+      max_id = std::max(max_id, std::max(u.src, u.dst));
+    }
+    // Vertexes beyond the head array of this generation need a new one.
+    if (max_id >= generation_->capacity)
+      Compact(max_id + 1);
+
+    uint64_t version = version_ + 1;
+    Generation& g = *generation_;
+    for (const Update& u : batch) {
+      if (HasEdge(g, u.src, u.dst) == u.insert) {
+        INSTRUMENT_COUNT("dynamic.ignored", 1);
+        continue;
+      }
+      Append(&g, u.src, version, u.dst, u.insert);
+      delta_entries_++;
+      if (u.insert) {
+        num_edges_++;
+        num_vertexes_ = std::max(num_vertexes_, std::max(u.src, u.dst) + 1);
+      } else {
+        num_edges_--;
+      }
+    }
+    INSTRUMENT_COUNT("dynamic.updates", batch.size());
+    version_ = version;
+    Publish();
+
+    if (delta_entries_ >= options_.min_compact_entries &&
+        delta_entries_ > options_.compact_ratio * g.base.num_edges())
+      Compact(num_vertexes_);
+    return true;
+  }
+
+  // Folds the delta into a new CSR base. Called by Apply() as needed; like
+  // Apply(), only from the writer thread.
+  void Compact() { Compact(num_vertexes_); }
+
+  // Writer side statistics.
+  uint64_t version() const { return version_; }
+  int64_t delta_entries() const { return delta_entries_; }
+  int compactions() const { return compactions_; }
+
+ private:
+  struct Entry {
+    uint64_t version;
+    int target;
+    int degree;  // of the source, with this entry applied
+    bool insert;
+  };
+
+  // Delta blocks double in size up to kMaxBlock entries.
+  static constexpr int kMinBlock = 4;
+  static constexpr int kMaxBlock = 256;
+
+  struct Block {
+    Block(int capacity, Block* next)
+        : entries(new Entry[capacity]), capacity(capacity), size(0),
+          next(next) {}
+
+    std::unique_ptr<Entry[]> entries;
+    const int capacity;
+    std::atomic<int> size;
+    Block* const next;  // older entries
+  };
+
+  struct Generation {
+    Generation(CsrGraph base_graph, int capacity)
+        : base(std::move(base_graph)), capacity(capacity),
+          heads(new std::atomic<Block*>[capacity]) {
+      for (int v = 0; v < capacity; v++)
+        heads[v].store(nullptr, std::memory_order_relaxed);
+    }
+
+    ~Generation() {
+      for (int v = 0; v < capacity; v++) {
+        Block* b = heads[v].load(std::memory_order_relaxed);
+        while (b) {
+          Block* next = b->next;
+          delete b;
+          b = next;
+        }
+      }
+    }
+
+    const CsrGraph base;
+    const int capacity;
+    std::unique_ptr<std::atomic<Block*>[]> heads;
+  };
+
+  static int Capacity(int num_vertexes) {
+    return std::max(1024, num_vertexes + num_vertexes / 2);
+  }
+
+  // Whether the edge exists in the newest state, as seen by the writer.
+  static bool HasEdge(const Generation& g, int src, int dst) {
+    if (src < g.capacity) {
+      for (const Block* b = g.heads[src].load(std::memory_order_relaxed); b;
+           b = b->next) {
+        for (int i = b->size.load(std::memory_order_relaxed) - 1; i >= 0;
+             i--) {
+          if (b->entries[i].target == dst)
+            return b->entries[i].insert;
+        }
+      }
+    }
+    return src < g.base.num_vertexes() &&
+           std::binary_search(g.base.begin(src), g.base.end(src), dst);
+  }
+
+  static void Append(Generation* g, int v, uint64_t version, int target,
+                     bool insert) {
+    Block* head = g->heads[v].load(std::memory_order_relaxed);
+    int degree = v < g->base.num_vertexes() ? g->base.degree(v) : 0;
+    if (head) {
+      // Blocks are never left empty, so the head holds the newest degree.
+      int newest = head->size.load(std::memory_order_relaxed) - 1;
+      degree = head->entries[newest].degree;
+    }
+    Entry entry{version, target, degree + (insert ? 1 : -1), insert};
+    if (!head || head->size.load(std::memory_order_relaxed) == head->capacity) {
+      int capacity = !head ? kMinBlock
+                     : head->capacity < kMaxBlock ? 2 * head->capacity
+                                                  : kMaxBlock;
+      head = new Block(capacity, head);
+      g->heads[v].store(head, std::memory_order_release);
+    }
+    int size = head->size.load(std::memory_order_relaxed);
+    head->entries[size] = entry;
+    head->size.store(size + 1, std::memory_order_release);
+  }
+
+  void Compact(int min_vertexes) {
+    INSTRUMENT_SCOPE("DynamicGraph::Compact");
+    CsrGraph base = current_.ToCsr();
+    base.EnsureVertexes(min_vertexes);
+    generation_ = std::make_shared<Generation>(
+        std::move(base), Capacity(std::max(min_vertexes, num_vertexes_)));
+    delta_entries_ = 0;
+    compactions_++;
+    Publish();
+  }
+
+  void Publish() {
+    Snapshot snapshot;
+    snapshot.generation_ = generation_;
+    snapshot.version_ = version_;
+    snapshot.num_vertexes_ = num_vertexes_;
+    snapshot.num_edges_ = num_edges_;
+    std::lock_guard<std::mutex> lock(mutex_);
+    current_ = std::move(snapshot);
+  }
+
+  const Options options_;
+
+  // Writer state.
+  std::shared_ptr<Generation> generation_;
+  uint64_t version_ = 0;
+  int num_vertexes_ = 0;
+  int64_t num_edges_ = 0;
+  int64_t delta_entries_ = 0;
+  int compactions_ = 0;
+
+  mutable std::mutex mutex_;
+  Snapshot current_;  // guarded by mutex_
+};
+
+#endif  // COMMON_DYNAMIC_GRAPH_H_
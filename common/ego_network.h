@@ -0,0 +1,192 @@
+// k-hop neighbourhoods ("ego networks") of a vertex.
+//
+//   EgoNetworkExtractor extractor(graph, graph.Reversed());
+//   EgoNetwork ego = extractor.Extract(x, {2, Direction::kBoth, 1000});
+//   ego.WriteText(names, "out_pages.txt", "out_links.txt");
+//
+// Extract() walks breadth first from the vertex along out-links, in-links
+// or both, up to |hops| hops, and stops as soon as |max_vertexes| vertexes
+// are collected. Visited vertexes are marked in a bitmap of one bit per
+// vertex that belongs to the calling thread and is cleared sparsely after
+// each call, so Extract() is reentrant across threads and costs
+// O(size of the neighbourhood) rather than O(vertexes) per call.
+#ifndef COMMON_EGO_NETWORK_H_
+#define COMMON_EGO_NETWORK_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "csr_graph.h"
+#include "instrumentation.h"
+
+enum class Direction { kOut, kIn, kBoth };
+
+inline bool ParseDirection(const std::string& name, Direction* direction) {
+  if (name == "out")
+    *direction = Direction::kOut;
+  else if (name == "in")
+    *direction = Direction::kIn;
+  else if (name == "both")
+    *direction = Direction::kBoth;
+  else
+    return false;
+  return true;
+}
+
+struct EgoNetworkOptions {
+  int hops;
+  Direction direction;
+  int max_vertexes;  // <= 0: no limit
+};
+
+// The induced subgraph on a neighbourhood. Local vertex i is vertexes[i]
+// of the original graph, found hop[i] hops from the source (local 0).
+struct EgoNetwork {
+  std::vector<int> vertexes;
+  std::vector<int> hop;
+  CsrGraph links;  // out-links between local ids
+  bool truncated = false;  // stopped at max_vertexes
+
+  // Writes the original ids in the out_pages.txt / out_links.txt format
+  // of weak_connected.cc. Returns false on error.
+  bool WriteText(const std::vector<std::string>& names, const char* pages_path,
+                 const char* links_path) const {
+    std::ofstream pages(pages_path);
+    std::ofstream out(links_path);
+    if (pages.fail() || out.fail()) {
+      std::cerr << "failed to open " << pages_path << " or " << links_path
+                << std::endl;
+      return false;
+    }
+    for (size_t i = 0; i < vertexes.size(); i++)
+      pages << vertexes[i] << "\t" << Name(names, i) << "\n";
+    for (int u = 0; u < links.num_vertexes(); u++) {
+      for (const int* it = links.begin(u); it != links.end(u); ++it)
+        out << vertexes[u] << "\t" << vertexes[*it] << "\n";
+    }
+    return !pages.fail() && !out.fail();
+  }
+
+  // Writes the local ids as a pages.txt file and a binary links file (see
+  // LoadBinaryLinks()), a graph the programs can load as it is. Returns
+  // false on error.
+  bool WriteBinary(const std::vector<std::string>& names,
+                   const char* pages_path, const char* links_path) const {
+    std::ofstream pages(pages_path);
+    if (pages.fail()) {
+      std::cerr << "failed to open " << pages_path << std::endl;
+      return false;
+    }
+    for (size_t i = 0; i < vertexes.size(); i++)
+      pages << i << "\t" << Name(names, i) << "\n";
+    return !pages.fail() && WriteBinaryLinks(links, links_path);
+  }
+
+ private:
+  std::string Name(const std::vector<std::string>& names, size_t i) const {
+    return vertexes[i] < static_cast<int>(names.size())
+               ? names[vertexes[i]]
+               : std::to_string(vertexes[i]);
+  }
+};
+
+class EgoNetworkExtractor {
+ public:
+  // |in_links| is |out_links| reversed; it is only read for kIn and kBoth.
+  EgoNetworkExtractor(const CsrGraph& out_links, const CsrGraph& in_links)
+      : out_links_(out_links), in_links_(in_links) {}
+
+  EgoNetwork Extract(int source, const EgoNetworkOptions& options) const {
+    INSTRUMENT_SCOPE("EgoNetwork::Extract");
+    int n = out_links_.num_vertexes();
+    EgoNetwork ego;
+    if (source < 0 || source >= n)
+      return ego;
+    size_t limit = options.max_vertexes > 0
+                       ? static_cast<size_t>(options.max_vertexes)
+                       : static_cast<size_t>(n);
+
+    std::vector<uint64_t>& visited = VisitedBitmap(n);
+    auto visit = [&](int v, int hop) {
+      uint64_t bit = uint64_t(1) << (v & 63);
+      if (visited[v >> 6] & bit)
+        return true;
+      if (ego.vertexes.size() == limit) {
+        ego.truncated = true;
+        return false;
+      }
+      visited[v >> 6] |= bit;
+      ego.vertexes.push_back(v);
+      ego.hop.push_back(hop);
+      return true;
+    };
+    visit(source, 0);
+    // The frontier of hop h is ego.vertexes[begin, end).
+    size_t begin = 0;
+    for (int h = 1; h <= options.hops && !ego.truncated; h++) {
+      size_t end = ego.vertexes.size();
+      for (size_t i = begin; i < end && !ego.truncated; i++) {
+        int u = ego.vertexes[i];
+        if (options.direction != Direction::kIn) {
+          for (const int* it = out_links_.begin(u);
+               it != out_links_.end(u) && visit(*it, h); ++it) {
+          }
+        }
+        if (options.direction != Direction::kOut) {
+          for (const int* it = in_links_.begin(u);
+               it != in_links_.end(u) && visit(*it, h); ++it) {
+          }
+        }
+      }
+      if (end == ego.vertexes.size())
+        break;
+      begin = end;
+    }
+
+    // Out-links inside the neighbourhood, renumbered through a sorted copy
+    // of the ids.
+    std::vector<std::pair<int, int>> ids;
+    ids.reserve(ego.vertexes.size());
+    for (size_t i = 0; i < ego.vertexes.size(); i++)
+      ids.emplace_back(ego.vertexes[i], i);
+    std::sort(ids.begin(), ids.end());
+    std::vector<std::pair<int, int>> edges;
+    for (size_t i = 0; i < ego.vertexes.size(); i++) {
+      int u = ego.vertexes[i];
+      for (const int* it = out_links_.begin(u); it != out_links_.end(u);
+           ++it) {
+        if (!(visited[*it >> 6] & (uint64_t(1) << (*it & 63))))
+          continue;
+        auto local = std::lower_bound(ids.begin(), ids.end(),
+                                      std::make_pair(*it, 0));
+        edges.emplace_back(i, local->second);
+      }
+    }
+    ego.links = CsrGraph::FromEdges(ego.vertexes.size(), edges);
+    ego.links.SortNeighbors();
+    INSTRUMENT_HISTOGRAM("ego.vertexes", ego.vertexes.size());
+
+    for (int v : ego.vertexes)
+      visited[v >> 6] = 0;
+    return ego;
+  }
+
+ private:
+  // All zero between calls.
+  static std::vector<uint64_t>& VisitedBitmap(int n) {
+    thread_local std::vector<uint64_t> visited;
+    if (visited.size() < static_cast<size_t>(n + 63) / 64)
+      visited.resize((n + 63) / 64, 0);
+    return visited;
+  }
+
+  const CsrGraph& out_links_;
+  const CsrGraph& in_links_;
+};
+
+#endif  // COMMON_EGO_NETWORK_H_
@@ -0,0 +1,320 @@
+// Fuzzy lookup of names within a small edit distance.
+//
+//   FuzzyIndex index(names, 2);
+//   for (const FuzzyIndex::Match& m : index.Search("Gogle", 2)) ...
+//
+// Distances count Unicode code points, so a mistyped kana costs 1 like a
+// mistyped ASCII letter. The index is a symmetric deletion dictionary
+// (SymSpell): every name is stored under each string obtained by deleting
+// at most |max_distance| code points from its first |prefix_length| code
+// points. Two strings within distance d share such a deletion with at most
+// d deletions on each side, so a query looks up the deletions of its own
+// prefix and only the names found there are verified, with Myers'
+// bit-parallel edit distance (Hyyro's variant for whole strings).
+//
+// Deletions are stored as 64-bit hashes, split into 2^bucket_bits buckets
+// by their top bits; a bucket is a sorted run of (low 32 bits, name id)
+// pairs. Hash collisions only add candidates, which the verification
+// rejects. Building is parallel and takes a few seconds for millions of
+// names; a query does a few dozen bucket lookups and verifies a few hundred
+// candidates at most.
+#ifndef COMMON_FUZZY_INDEX_H_
+#define COMMON_FUZZY_INDEX_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "hash.h"
+#include "instrumentation.h"
+#include "parallel.h"
+
+class FuzzyIndex {
+ public:
+  struct Match {
+    int id;
+    int distance;
+  };
+
+  // Keeps a reference to |names|, which must outlive the index.
+  FuzzyIndex(const std::vector<std::string>& names, int max_distance,
+             int prefix_length = 7)
+      : names_(names), max_distance_(std::max(0, max_distance)),
+        prefix_length_(std::max(max_distance_ + 1, prefix_length)) {
+    INSTRUMENT_SCOPE("FuzzyIndex::Build");
+    int n = names.size();
+    // Deletions per name, counted first so that they can be written in
+    // parallel at fixed offsets.
+    std::vector<int64_t> offsets(n + 1, 0);
+    ParallelFor(0, n, 1024, [&](int64_t i) {
+      offsets[i + 1] = Deletions(Prefix(names[i])).size();
+    });
+    for (int i = 0; i < n; i++)
+      offsets[i + 1] += offsets[i];
+    int64_t num_entries = offsets[n];
+    std::vector<uint64_t> hashes(num_entries);
+    std::vector<int> owners(num_entries);
+    ParallelFor(0, n, 1024, [&](int64_t i) {
+      std::vector<uint64_t> deletions = Deletions(Prefix(names[i]));
+      std::copy(deletions.begin(), deletions.end(), &hashes[offsets[i]]);
+      std::fill(&owners[offsets[i]], &owners[offsets[i + 1]], i);
+    });
+
+    // Counting sort by bucket, then a parallel sort within the buckets.
+    bucket_bits_ = 8;
+    while (bucket_bits_ < 24 &&
+           (int64_t(1) << (bucket_bits_ + 2)) < num_entries)
+      bucket_bits_++;
+    size_t num_buckets = size_t(1) << bucket_bits_;
+    buckets_.assign(num_buckets + 1, 0);
+    for (uint64_t h : hashes)
+      buckets_[Bucket(h) + 1]++;
+    for (size_t b = 0; b < num_buckets; b++)
+      buckets_[b + 1] += buckets_[b];
+    entries_.resize(num_entries);
+    std::vector<int64_t> fill(buckets_.begin(), buckets_.end() - 1);
+    for (int64_t e = 0; e < num_entries; e++)
+      entries_[fill[Bucket(hashes[e])]++] = {static_cast<uint32_t>(hashes[e]),
+                                             owners[e]};
+    ParallelFor(0, num_buckets, 64, [&](int64_t b) {
+      std::sort(entries_.begin() + buckets_[b],
+                entries_.begin() + buckets_[b + 1]);
+    });
+    INSTRUMENT_COUNT("fuzzy.entries", num_entries);
+  }
+
+  int max_distance() const { return max_distance_; }
+  int64_t num_entries() const { return entries_.size(); }
+  int64_t memory_bytes() const {
+    return entries_.size() * sizeof(entries_[0]) +
+           buckets_.size() * sizeof(buckets_[0]);
+  }
+
+  // Names within |max_distance| (at most the index's) of |query|, in id
+  // order.
+  std::vector<Match> Search(const std::string& query, int max_distance) const {
+    INSTRUMENT_SCOPE("FuzzyIndex::Search");
+    max_distance = std::max(0, std::min(max_distance, max_distance_));
+    std::vector<uint32_t> pattern = CodePoints(query);
+    std::vector<int> candidates;
+    for (uint64_t h : Deletions(Prefix(pattern), max_distance)) {
+      Entry key = {static_cast<uint32_t>(h), 0};
+      auto first = entries_.begin() + buckets_[Bucket(h)];
+      auto last = entries_.begin() + buckets_[Bucket(h) + 1];
+      for (auto it = std::lower_bound(first, last, key);
+           it != last && it->fingerprint == key.fingerprint; ++it)
+        candidates.push_back(it->id);
+    }
+    std::sort(candidates.begin(), candidates.end());
+    candidates.erase(std::unique(candidates.begin(), candidates.end()),
+                     candidates.end());
+    INSTRUMENT_HISTOGRAM("fuzzy.candidates", candidates.size());
+
+    std::vector<Match> matches;
+    Matcher matcher(pattern);
+    for (int id : candidates) {
+      int distance = matcher.Distance(CodePoints(names_[id]), max_distance);
+      if (distance <= max_distance)
+        matches.push_back({id, distance});
+    }
+    return matches;
+  }
+
+  // Edit distance between the code points of |a| and |b|, or any value
+  // above |bound| once it exceeds |bound|.
+  static int Distance(const std::string& a, const std::string& b, int bound) {
+    return Matcher(CodePoints(a)).Distance(CodePoints(b), bound);
+  }
+
+  // Decodes UTF-8; a byte that does not start a valid sequence is one code
+  // point of its own.
+  static std::vector<uint32_t> CodePoints(const std::string& s) {
+    std::vector<uint32_t> result;
+    result.reserve(s.size());
+    for (size_t i = 0; i < s.size();) {
+      uint8_t c = s[i];
+      int length = c < 0x80 ? 1 : (c >> 5) == 6 ? 2 : (c >> 4) == 14 ? 3
+                 : (c >> 3) == 30 ? 4 : 0;
+      bool valid = length > 0 && i + length <= s.size();
+      for (int k = 1; valid && k < length; k++)
+        valid = (static_cast<uint8_t>(s[i + k]) >> 6) == 2;
+      if (!valid) {
+        result.push_back(c);
+        i++;
+        continue;
+      }
+      uint32_t cp = length == 1 ? c : c & (0x7F >> length);
+      for (int k = 1; k < length; k++)
+        cp = (cp << 6) | (static_cast<uint8_t>(s[i + k]) & 0x3F);
+      result.push_back(cp);
+      i += length;
+    }
+    return result;
+  }
+
+ private:
+  struct Entry {
+    uint32_t fingerprint;  // low bits of the deletion's hash
+    int id;
+    bool operator<(const Entry& other) const {
+      return fingerprint != other.fingerprint ? fingerprint < other.fingerprint
+                                              : id < other.id;
+    }
+  };
+
+  // Myers' bit-vector edit distance for patterns up to 64 code points, a
+  // banded dynamic program beyond.
+  class Matcher {
+   public:
+    explicit Matcher(std::vector<uint32_t> pattern)
+        : pattern_(std::move(pattern)) {
+      if (pattern_.size() > 64)
+        return;
+      for (size_t i = 0; i < pattern_.size(); i++) {
+        Slot& slot = slots_[Find(pattern_[i])];
+        slot.code_point = pattern_[i];
+        slot.used = true;
+        slot.mask |= uint64_t(1) << i;
+      }
+    }
+
+    int Distance(const std::vector<uint32_t>& text, int bound) const {
+      int m = pattern_.size();
+      int n = text.size();
+      if (std::abs(m - n) > bound)
+        return bound + 1;
+      if (m == 0)
+        return n;
+      if (m > 64)
+        return BandedDistance(text, bound);
+      uint64_t last = uint64_t(1) << (m - 1);
+      uint64_t pv = m == 64 ? ~uint64_t(0) : (last << 1) - 1;
+      uint64_t mv = 0;
+      int score = m;
+      for (int j = 0; j < n; j++) {
+        const Slot& slot = slots_[Find(text[j])];
+        uint64_t eq = slot.used ? slot.mask : 0;
+        uint64_t xv = eq | mv;
+        uint64_t xh = (((eq & pv) + pv) ^ pv) | eq;
+        uint64_t ph = mv | ~(xh | pv);
+        uint64_t mh = pv & xh;
+        if (ph & last)
+          score++;
+        else if (mh & last)
+          score--;
+        // Each remaining code point lowers the score by at most 1.
+        if (score - (n - j - 1) > bound)
+          return bound + 1;
+        ph = (ph << 1) | 1;
+        mh <<= 1;
+        pv = mh | ~(xv | ph);
+        mv = ph & xv;
+      }
+      return score;
+    }
+
+   private:
+    struct Slot {
+      uint32_t code_point = 0;
+      bool used = false;
+      uint64_t mask = 0;
+    };
+
+    // Open addressing over 128 slots, enough for 64 distinct code points.
+    size_t Find(uint32_t code_point) const {
+      size_t i = (code_point * 0x9E3779B1u) >> 25;
+      while (slots_[i].used && slots_[i].code_point != code_point)
+        i = (i + 1) & 127;
+      return i;
+    }
+
+    int BandedDistance(const std::vector<uint32_t>& text, int bound) const {
+      int m = pattern_.size();
+      int n = text.size();
+      const int kInfinity = bound + 1;
+      std::vector<int> row(n + 1), next(n + 1);
+      for (int j = 0; j <= n; j++)
+        row[j] = std::min(j, kInfinity);
+      for (int i = 1; i <= m; i++) {
+        int from = std::max(1, i - bound);
+        int to = std::min(n, i + bound);
+        std::fill(next.begin(), next.end(), kInfinity);
+        next[0] = std::min(i, kInfinity);
+        int best = next[0];
+        for (int j = from; j <= to; j++) {
+          int d = row[j - 1] + (pattern_[i - 1] != text[j - 1]);
+          d = std::min(d, std::min(row[j], next[j - 1]) + 1);
+          next[j] = std::min(d, kInfinity);
+          best = std::min(best, next[j]);
+        }
+        if (best > bound)
+          return kInfinity;
+        row.swap(next);
+      }
+      return row[n];
+    }
+
+    std::vector<uint32_t> pattern_;
+    Slot slots_[128];
+  };
+
+  std::vector<uint32_t> Prefix(const std::string& name) const {
+    return Prefix(CodePoints(name));
+  }
+
+  std::vector<uint32_t> Prefix(std::vector<uint32_t> code_points) const {
+    if (static_cast<int>(code_points.size()) > prefix_length_)
+      code_points.resize(prefix_length_);
+    return code_points;
+  }
+
+  // Distinct hashes of the strings |s| minus at most |max_distance| code
+  // points (the index's distance by default).
+  std::vector<uint64_t> Deletions(const std::vector<uint32_t>& s,
+                                  int max_distance = -1) const {
+    if (max_distance < 0)
+      max_distance = max_distance_;
+    std::vector<uint64_t> hashes;
+    std::vector<uint32_t> current = s;
+    AddDeletions(&current, 0, max_distance, &hashes);
+    std::sort(hashes.begin(), hashes.end());
+    hashes.erase(std::unique(hashes.begin(), hashes.end()), hashes.end());
+    return hashes;
+  }
+
+  // Adds |*s| and, while |budget| lasts, every string with one more code
+  // point deleted at or after |from|.
+  static void AddDeletions(std::vector<uint32_t>* s, size_t from, int budget,
+                           std::vector<uint64_t>* hashes) {
+    hashes->push_back(Hash(*s));
+    if (budget == 0)
+      return;
+    for (size_t i = from; i < s->size(); i++) {
+      uint32_t removed = (*s)[i];
+      s->erase(s->begin() + i);
+      AddDeletions(s, i, budget - 1, hashes);
+      s->insert(s->begin() + i, removed);
+    }
+  }
+
+  static uint64_t Hash(const std::vector<uint32_t>& s) {
+    uint64_t h = s.size();
+    for (uint32_t c : s)
+      h = (h ^ c) * 0x100000001B3ULL + 0x9E3779B97F4A7C15ULL;
+    return Mix64(h);
+  }
+
+  size_t Bucket(uint64_t hash) const { return hash >> (64 - bucket_bits_); }
+
+  const std::vector<std::string>& names_;
+  int max_distance_;
+  int prefix_length_;
+  int bucket_bits_ = 8;
+  std::vector<int64_t> buckets_;  // 2^bucket_bits_ + 1 offsets
+  std::vector<Entry> entries_;
+};
+
+#endif  // COMMON_FUZZY_INDEX_H_
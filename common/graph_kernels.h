@@ -0,0 +1,312 @@
+// Graph kernels timed by the benchmarks (bench/graph_bench.cc and the
+// *_bench.cc programs of homework2_cpp), kept in one place so that every
+// benchmark measures the same code.
+//
+// The kernels take any graph with num_vertexes(), degree(v) and
+// ForEachNeighbor(v, fn): CsrGraph, CompressedGraph or a
+// DynamicGraph::Snapshot. Where a kernel takes a |trace|, trace->Access()
+// sees the address of each of its random accesses (dist[] for BFS,
+// contribution[] for PageRank), e.g. to replay them through a cache model.
+//
+// The Parallel* kernels split the vertexes into one contiguous slice per
+// thread of parallel.h. Slice i of a vertex-indexed array is then on the
+// node of thread i when the array is placed with GRAPH_NUMA=partition and
+// the threads are pinned (GRAPH_PIN_THREADS=1), see graph_memory.h.
+#ifndef COMMON_GRAPH_KERNELS_H_
+#define COMMON_GRAPH_KERNELS_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <numeric>
+#include <vector>
+
+#include "csr_graph.h"
+#include "parallel.h"
+
+// Ignores every access.
+struct NoTrace {
+  void Access(const void*) {}
+};
+
+// Top-down BFS from |source|. Leaves the hop counts in |dist| (-1 where
+// unreached) and the vertexes in visiting order in |queue|. Returns the
+// number of traversed links.
+template <typename Graph, typename Dist, typename Trace>
+int64_t Bfs(const Graph& graph, int source, Dist* dist,
+            std::vector<int>* queue, Trace* trace) {
+  std::fill(dist->begin(), dist->end(), -1);
+  queue->assign(1, source);
+  (*dist)[source] = 0;
+  int64_t edges = 0;
+  for (size_t head = 0; head < queue->size(); head++) {
+    int v = (*queue)[head];
+    graph.ForEachNeighbor(v, [&](int w) {
+      edges++;
+      trace->Access(&(*dist)[w]);
+      if ((*dist)[w] < 0) {
+        (*dist)[w] = (*dist)[v] + 1;
+        queue->push_back(w);
+      }
+    });
+  }
+  return edges;
+}
+
+template <typename Graph, typename Dist>
+int64_t Bfs(const Graph& graph, int source, Dist* dist,
+            std::vector<int>* queue) {
+  NoTrace trace;
+  return Bfs(graph, source, dist, queue, &trace);
+}
+
+// Pull-style PageRank: every vertex sums the contributions of its
+// in-neighbours in |reversed|. Returns links * iterations.
+template <typename Graph, typename Vector, typename Trace>
+int64_t PullPageRank(const Graph& graph, const Graph& reversed,
+                     int iterations, Vector* rank, Trace* trace) {
+  int n = graph.num_vertexes();
+  Vector contribution(n);
+  rank->assign(n, 1.0 / n);
+  int64_t edges = 0;
+  for (int i = 0; i < iterations; i++) {
+    double dangling = 0;
+    for (int v = 0; v < n; v++) {
+      int degree = graph.degree(v);
+      if (degree == 0) {
+        dangling += (*rank)[v];
+        contribution[v] = 0;
+      } else {
+        contribution[v] = (*rank)[v] / degree;
+      }
+    }
+    for (int v = 0; v < n; v++) {
+      double sum = 0;
+      reversed.ForEachNeighbor(v, [&](int w) {
+        edges++;
+        trace->Access(&contribution[w]);
+        sum += contribution[w];
+      });
+      (*rank)[v] = 0.15 / n + 0.85 * (sum + dangling / n);
+    }
+  }
+  return edges;
+}
+
+template <typename Graph, typename Vector>
+int64_t PullPageRank(const Graph& graph, const Graph& reversed,
+                     int iterations, Vector* rank) {
+  NoTrace trace;
+  return PullPageRank(graph, reversed, iterations, rank, &trace);
+}
+
+// Push-style PageRank: every vertex adds its share to its out-neighbours,
+// so no reversed graph is needed. Returns links * iterations.
+template <typename Graph>
+int64_t PushPageRank(const Graph& graph, int iterations,
+                     std::vector<double>* rank) {
+  int n = graph.num_vertexes();
+  // Degrees are read once; a DynamicGraph::Snapshot looks them up in its
+  // delta.
+  std::vector<int> degree(n);
+  int64_t num_edges = 0;
+  for (int v = 0; v < n; v++) {
+    degree[v] = graph.degree(v);
+    num_edges += degree[v];
+  }
+  std::vector<double> next(n);
+  rank->assign(n, 1.0 / n);
+  for (int i = 0; i < iterations; i++) {
+    double dangling = 0;
+    std::fill(next.begin(), next.end(), 0);
+    for (int v = 0; v < n; v++) {
+      if (degree[v] == 0) {
+        dangling += (*rank)[v];
+        continue;
+      }
+      double out = (*rank)[v] / degree[v];
+      graph.ForEachNeighbor(v, [&](int w) { next[w] += out; });
+    }
+    for (int v = 0; v < n; v++)
+      next[v] = 0.15 / n + 0.85 * (next[v] + dangling / n);
+    rank->swap(next);
+  }
+  return num_edges * iterations;
+}
+
+// First vertex of the slice of thread |tid| out of |num_threads|.
+inline int SliceBegin(int n, int tid, int num_threads) {
+  return static_cast<int>(static_cast<int64_t>(n) * tid / num_threads);
+}
+
+// Level-synchronous BFS from |source| on NumThreads() threads. Every level,
+// each thread expands the vertexes of its slice that are on the frontier
+// and claims unvisited neighbours with a compare-and-swap on |dist|.
+// Returns the number of traversed links, the same as Bfs().
+template <typename Graph, typename Dist>
+int64_t ParallelBfs(const Graph& graph, int source, Dist* dist) {
+  int n = graph.num_vertexes();
+  int num_threads = NumThreads();
+  std::vector<int64_t> edges(num_threads);
+  // found[level % 3] is set by whoever reaches a vertex at level + 1. With
+  // three flags, the one a level resets was last read two barriers ago.
+  std::atomic<bool> found[3];
+  for (auto& f : found)
+    f.store(false, std::memory_order_relaxed);
+  int* d = dist->data();
+  SpinBarrier barrier(num_threads);
+  RunOnThreads(num_threads, [&](int tid) {
+    int begin = SliceBegin(n, tid, num_threads);
+    int end = SliceBegin(n, tid + 1, num_threads);
+    std::fill(d + begin, d + end, -1);
+    barrier.Wait();
+    if (tid == 0)
+      d[source] = 0;
+    barrier.Wait();
+    int64_t local_edges = 0;
+    for (int level = 0;; level++) {
+      if (tid == 0)
+        found[(level + 1) % 3].store(false, std::memory_order_relaxed);
+      bool any = false;
+      for (int v = begin; v < end; v++) {
+        if (__atomic_load_n(&d[v], __ATOMIC_RELAXED) != level)
+          continue;
+        graph.ForEachNeighbor(v, [&](int w) {
+          local_edges++;
+          int unvisited = -1;
+          if (__atomic_load_n(&d[w], __ATOMIC_RELAXED) < 0 &&
+              __atomic_compare_exchange_n(&d[w], &unvisited, level + 1, false,
+                                          __ATOMIC_RELAXED,
+                                          __ATOMIC_RELAXED))
+            any = true;
+        });
+      }
+      if (any)
+        found[level % 3].store(true, std::memory_order_relaxed);
+      barrier.Wait();
+      if (!found[level % 3].load(std::memory_order_relaxed))
+        break;
+    }
+    edges[tid] = local_edges;
+  });
+  int64_t total = 0;
+  for (int64_t e : edges)
+    total += e;
+  return total;
+}
+
+// PullPageRank() on NumThreads() threads; each thread computes the
+// contributions and ranks of its slice. Returns links * iterations.
+template <typename Graph, typename Vector>
+int64_t ParallelPullPageRank(const Graph& graph, const Graph& reversed,
+                             int iterations, Vector* rank) {
+  int n = graph.num_vertexes();
+  int num_threads = NumThreads();
+  Vector contribution(n);
+  rank->resize(n);
+  std::vector<double> dangling(num_threads);
+  std::vector<int64_t> edges(num_threads);
+  SpinBarrier barrier(num_threads);
+  RunOnThreads(num_threads, [&](int tid) {
+    int begin = SliceBegin(n, tid, num_threads);
+    int end = SliceBegin(n, tid + 1, num_threads);
+    std::fill(rank->begin() + begin, rank->begin() + end, 1.0 / n);
+    int64_t local_edges = 0;
+    for (int i = 0; i < iterations; i++) {
+      double local_dangling = 0;
+      for (int v = begin; v < end; v++) {
+        int degree = graph.degree(v);
+        if (degree == 0) {
+          local_dangling += (*rank)[v];
+          contribution[v] = 0;
+        } else {
+          contribution[v] = (*rank)[v] / degree;
+        }
+      }
+      dangling[tid] = local_dangling;
+      barrier.Wait();
+      double total_dangling = 0;
+      for (double x : dangling)
+        total_dangling += x;
+      for (int v = begin; v < end; v++) {
+        double sum = 0;
+        reversed.ForEachNeighbor(v, [&](int w) {
+          local_edges++;
+          sum += contribution[w];
+        });
+        (*rank)[v] = 0.15 / n + 0.85 * (sum + total_dangling / n);
+      }
+      // Nobody may overwrite contribution[] or dangling[] before all ranks
+      // of this iteration are done.
+      barrier.Wait();
+    }
+    edges[tid] = local_edges;
+  });
+  int64_t total = 0;
+  for (int64_t e : edges)
+    total += e;
+  return total;
+}
+
+// Root of |v| in a union-find forest, halving the path on the way.
+inline int FindRoot(std::vector<int>* parent, int v) {
+  while ((*parent)[v] != v) {
+    (*parent)[v] = (*parent)[(*parent)[v]];
+    v = (*parent)[v];
+  }
+  return v;
+}
+
+// Weakly connected components by union-find over every link. Returns the
+// number of links.
+template <typename Graph>
+int64_t WeaklyConnectedComponents(const Graph& graph, int* components) {
+  std::vector<int> parent(graph.num_vertexes());
+  std::iota(parent.begin(), parent.end(), 0);
+  *components = graph.num_vertexes();
+  int64_t edges = 0;
+  for (int v = 0; v < graph.num_vertexes(); v++) {
+    graph.ForEachNeighbor(v, [&](int w) {
+      edges++;
+      int a = FindRoot(&parent, v), b = FindRoot(&parent, w);
+      if (a != b) {
+        parent[std::max(a, b)] = std::min(a, b);
+        --*components;
+      }
+    });
+  }
+  return edges;
+}
+
+inline bool HasEdge(const CsrGraph& graph, int from, int to) {
+  return std::binary_search(graph.begin(from), graph.end(from), to);
+}
+
+// Greedily grows a clique of reciprocal links around every sampled page, the
+// bounded variant of homework1_cpp/clique.cc. |graph| must be sorted.
+// Returns the number of adjacency probes.
+inline int64_t GreedyCliques(const CsrGraph& graph,
+                             const std::vector<int>& samples, int* largest) {
+  int64_t probes = 0;
+  std::vector<int> clique;
+  *largest = 0;
+  for (int src : samples) {
+    clique.assign(1, src);
+    for (const int* it = graph.begin(src); it != graph.end(src); ++it) {
+      bool ok = true;
+      for (int member : clique) {
+        probes += 2;
+        if (!HasEdge(graph, member, *it) || !HasEdge(graph, *it, member)) {
+          ok = false;
+          break;
+        }
+      }
+      if (ok)
+        clique.push_back(*it);
+    }
+    *largest = std::max(*largest, static_cast<int>(clique.size()));
+  }
+  return probes;
+}
+
+#endif  // COMMON_GRAPH_KERNELS_H_
@@ -0,0 +1,331 @@
+// Placement of the large graph arrays: huge pages, NUMA nodes and thread
+// pinning.
+//
+// GraphVector<T> is a std::vector whose blocks of kLargeAllocation bytes or
+// more are mapped with mmap and then, following GraphMemory::options():
+//
+//   huge_pages  kOff          4 KB pages
+//               kTransparent  madvise(MADV_HUGEPAGE), 2 MB pages from THP
+//               kExplicit     MAP_HUGETLB from the hugetlbfs pool, falling
+//                             back to kTransparent if the pool is empty
+//   placement   kFirstTouch   whichever node touches a page first
+//               kInterleave   pages round-robin over all nodes (mbind)
+//               kPartition    the block split into one contiguous slice per
+//                             node, slice i on node i (mbind)
+//   pin_threads workers of parallel.h are pinned to CPUs ordered node by
+//               node, so thread ranges line up with kPartition slices
+//
+// The defaults come from GRAPH_HUGEPAGES=off|thp|explicit,
+// GRAPH_NUMA=off|interleave|partition and GRAPH_PIN_THREADS=1, and can be
+// changed at runtime with set_options() (blocks keep the placement they
+// were allocated with). Everything degrades to plain pages when the kernel
+// refuses a request; only Linux implements the policies.
+#ifndef COMMON_GRAPH_MEMORY_H_
+#define COMMON_GRAPH_MEMORY_H_
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+class GraphMemory {
+ public:
+  enum class HugePages { kOff, kTransparent, kExplicit };
+  enum class Placement { kFirstTouch, kInterleave, kPartition };
+
+  struct Options {
+    HugePages huge_pages = HugePages::kOff;
+    Placement placement = Placement::kFirstTouch;
+    bool pin_threads = false;
+  };
+
+  // Blocks below this size come from operator new.
+  static constexpr size_t kLargeAllocation = size_t(1) << 20;
+  static constexpr size_t kHugePageSize = size_t(2) << 20;
+
+  static GraphMemory& Get() {
+    static GraphMemory instance;
+    return instance;
+  }
+
+  const Options& options() const { return options_; }
+  void set_options(const Options& options) { options_ = options; }
+
+  // CPUs of every NUMA node; a single node with all CPUs if the topology
+  // cannot be read.
+  const std::vector<std::vector<int>>& nodes() const { return nodes_; }
+
+  void* Allocate(size_t bytes) {
+    if (bytes < kLargeAllocation)
+      return ::operator new(bytes);
+    size_t length = RoundUp(bytes);
+#ifdef __linux__
+    void* p = MAP_FAILED;
+    if (options_.huge_pages == HugePages::kExplicit) {
+      p = mmap(nullptr, length, PROT_READ | PROT_WRITE,
+               MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    }
+    if (p == MAP_FAILED) {
+      p = mmap(nullptr, length, PROT_READ | PROT_WRITE,
+               MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (p == MAP_FAILED)
+        throw std::bad_alloc();
+      if (options_.huge_pages != HugePages::kOff)
+        madvise(p, length, MADV_HUGEPAGE);
+    }
+    Place(p, length);
+    return p;
+#else
+    return ::operator new(length);
+#endif
+  }
+
+  void Deallocate(void* p, size_t bytes) {
+    if (bytes < kLargeAllocation) {
+      ::operator delete(p);
+      return;
+    }
+#ifdef __linux__
+    munmap(p, RoundUp(bytes));
+#else
+    ::operator delete(p);
+#endif
+  }
+
+  // Pins the calling thread to the |index|-th CPU in node order. Returns
+  // false if pinning is unsupported or refused.
+  bool PinCurrentThread(int index) const {
+#ifdef __linux__
+    if (cpu_order_.empty())
+      return false;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu_order_[index % cpu_order_.size()], &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    (void)index;
+    return false;
+#endif
+  }
+
+  // Binds the whole pages inside [p, p + bytes) to |node|, migrating pages
+  // already touched elsewhere. A no-op on single node machines.
+  bool MoveToNode(void* p, size_t bytes, int node) {
+#ifdef __linux__
+    if (nodes_.size() < 2)
+      return true;
+    const uintptr_t kPage = sysconf(_SC_PAGESIZE);
+    uintptr_t begin = (reinterpret_cast<uintptr_t>(p) + kPage - 1) / kPage *
+                      kPage;
+    uintptr_t end = (reinterpret_cast<uintptr_t>(p) + bytes) / kPage * kPage;
+    if (end <= begin)
+      return true;
+    return Mbind(reinterpret_cast<void*>(begin), end - begin, kMpolBind,
+                 NodeMask(node, node), kMpolMfMove);
+#else
+    (void)p;
+    (void)bytes;
+    (void)node;
+    return true;
+#endif
+  }
+
+  // Node whose CPUs thread |index| of |num_threads| runs on when pinned.
+  int NodeOfThread(int index, int num_threads) const {
+    return static_cast<int>(static_cast<int64_t>(index % num_threads) *
+                            nodes_.size() / num_threads);
+  }
+
+  std::string Describe() const {
+    static const char* kHugePages[] = {"off", "thp", "explicit"};
+    static const char* kPlacement[] = {"first-touch", "interleave",
+                                       "partition"};
+    std::ostringstream out;
+    out << "huge pages: " << kHugePages[static_cast<int>(options_.huge_pages)]
+        << ", numa: " << kPlacement[static_cast<int>(options_.placement)]
+        << " over " << nodes_.size() << " node(s)"
+        << ", pinned: " << (options_.pin_threads ? "yes" : "no");
+    return out.str();
+  }
+
+  static bool ParseHugePages(const std::string& name, HugePages* huge_pages) {
+    if (name == "off")
+      *huge_pages = HugePages::kOff;
+    else if (name == "thp")
+      *huge_pages = HugePages::kTransparent;
+    else if (name == "explicit")
+      *huge_pages = HugePages::kExplicit;
+    else
+      return false;
+    return true;
+  }
+
+  static bool ParsePlacement(const std::string& name, Placement* placement) {
+    if (name == "off")
+      *placement = Placement::kFirstTouch;
+    else if (name == "interleave")
+      *placement = Placement::kInterleave;
+    else if (name == "partition")
+      *placement = Placement::kPartition;
+    else
+      return false;
+    return true;
+  }
+
+ private:
+  GraphMemory() {
+    ReadTopology();
+    const char* env = std::getenv("GRAPH_HUGEPAGES");
+    if (env && !ParseHugePages(env, &options_.huge_pages))
+      std::cerr << "unknown GRAPH_HUGEPAGES: " << env << std::endl;
+    env = std::getenv("GRAPH_NUMA");
+    if (env && !ParsePlacement(env, &options_.placement))
+      std::cerr << "unknown GRAPH_NUMA: " << env << std::endl;
+    env = std::getenv("GRAPH_PIN_THREADS");
+    options_.pin_threads = env && std::atoi(env) != 0;
+  }
+
+  static size_t RoundUp(size_t bytes) {
+    return (bytes + kHugePageSize - 1) / kHugePageSize * kHugePageSize;
+  }
+
+  // Parses a sysfs CPU list such as "0-3,8-11".
+  static std::vector<int> ParseCpuList(const std::string& list) {
+    std::vector<int> cpus;
+    std::stringstream stream(list);
+    std::string range;
+    while (std::getline(stream, range, ',')) {
+      int first = 0, last = 0;
+      if (std::sscanf(range.c_str(), "%d-%d", &first, &last) == 2) {
+        for (int cpu = first; cpu <= last; cpu++)
+          cpus.push_back(cpu);
+      } else if (std::sscanf(range.c_str(), "%d", &first) == 1) {
+        cpus.push_back(first);
+      }
+    }
+    return cpus;
+  }
+
+  void ReadTopology() {
+    for (int node = 0;; node++) {
+      std::ifstream cpulist("/sys/devices/system/node/node" +
+                            std::to_string(node) + "/cpulist");
+      std::string list;
+      if (!cpulist || !std::getline(cpulist, list))
+        break;
+      nodes_.push_back(ParseCpuList(list));
+    }
+    if (nodes_.empty()) {
+      int hw = std::max(1u, std::thread::hardware_concurrency());
+      nodes_.emplace_back();
+      for (int cpu = 0; cpu < hw; cpu++)
+        nodes_.back().push_back(cpu);
+    }
+    for (const auto& cpus : nodes_)
+      cpu_order_.insert(cpu_order_.end(), cpus.begin(), cpus.end());
+  }
+
+#ifdef __linux__
+  // Values of <numaif.h>, which needs libnuma.
+  static constexpr int kMpolBind = 2;
+  static constexpr int kMpolInterleave = 3;
+
+  static constexpr unsigned kMpolMfMove = 2;
+
+  static bool Mbind(void* p, size_t length, int mode,
+                    const std::vector<unsigned long>& mask,
+                    unsigned flags = 0) {
+    return syscall(__NR_mbind, p, length, mode, mask.data(),
+                   mask.size() * 8 * sizeof(unsigned long) + 1, flags) == 0;
+  }
+
+  static std::vector<unsigned long> NodeMask(int first, int last) {
+    const int kBits = 8 * sizeof(unsigned long);
+    std::vector<unsigned long> mask(last / kBits + 1, 0);
+    for (int node = first; node <= last; node++)
+      mask[node / kBits] |= 1UL << (node % kBits);
+    return mask;
+  }
+
+  void Place(void* p, size_t length) {
+    int num_nodes = nodes_.size();
+    if (num_nodes < 2 || options_.placement == Placement::kFirstTouch)
+      return;
+    bool ok = true;
+    if (options_.placement == Placement::kInterleave) {
+      ok = Mbind(p, length, kMpolInterleave, NodeMask(0, num_nodes - 1));
+    } else {
+      size_t pages = length / kHugePageSize;
+      for (int node = 0; node < num_nodes; node++) {
+        size_t begin = pages * node / num_nodes * kHugePageSize;
+        size_t end = pages * (node + 1) / num_nodes * kHugePageSize;
+        if (end > begin) {
+          ok &= Mbind(static_cast<char*>(p) + begin, end - begin, kMpolBind,
+                      NodeMask(node, node));
+        }
+      }
+    }
+    if (!ok && !warned_) {
+      std::cerr << "mbind failed: " << std::strerror(errno) << std::endl;
+      warned_ = true;
+    }
+  }
+#else
+  void Place(void*, size_t) {}
+#endif
+
+  Options options_;
+  std::vector<std::vector<int>> nodes_;
+  std::vector<int> cpu_order_;
+  bool warned_ = false;
+};
+
+// STL allocator backed by GraphMemory.
+template <typename T>
+class GraphAllocator {
+ public:
+  using value_type = T;
+
+  GraphAllocator() = default;
+  template <typename U>
+  GraphAllocator(const GraphAllocator<U>&) {}
+
+  T* allocate(size_t n) {
+    return static_cast<T*>(GraphMemory::Get().Allocate(n * sizeof(T)));
+  }
+  void deallocate(T* p, size_t n) {
+    GraphMemory::Get().Deallocate(p, n * sizeof(T));
+  }
+
+  template <typename U>
+  bool operator==(const GraphAllocator<U>&) const {
+    return true;
+  }
+  template <typename U>
+  bool operator!=(const GraphAllocator<U>&) const {
+    return false;
+  }
+};
+
+template <typename T>
+using GraphVector = std::vector<T, GraphAllocator<T>>;
+
+#endif  // COMMON_GRAPH_MEMORY_H_
@@ -0,0 +1,21 @@
+// Integer hashing shared by the indexes and graph algorithms.
+#ifndef COMMON_HASH_H_
+#define COMMON_HASH_H_
+
+#include <cstdint>
+
+// The splitmix64 finalizer: a bijection in which every input bit flips
+// about half of the output bits.
+inline uint64_t Mix64(uint64_t x) {
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+  return x ^ (x >> 31);
+}
+
+// A whole splitmix64 step, which also maps 0 to a well-mixed value. For
+// small keys such as vertex ids.
+inline uint64_t SplitMix64(uint64_t x) {
+  return Mix64(x + 0x9e3779b97f4a7c15ULL);
+}
+
+#endif  // COMMON_HASH_H_
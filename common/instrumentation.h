@@ -0,0 +1,340 @@
+// Scoped timers, counters, histograms and trace events for the graph
+// programs.
+//
+// ScopedTimer is always available; it prints the wall time of a phase
+// measured with the monotonic clock:
+//
+//   {
+//     ScopedTimer t("Create graph");
+//     ...
+//   }
+//
+// The rest only exists when compiled with -DGRAPH_INSTRUMENTATION
+// (make INSTRUMENT=1); otherwise the macros expand to nothing and their
+// arguments are not evaluated.
+//
+//   INSTRUMENT_COUNT("bfs.edges", degree);       // named counter
+//   INSTRUMENT_HISTOGRAM("bfs.frontier", size);  // log2 buckets
+//   INSTRUMENT_SCOPE("UpdatePageRank");          // trace event
+//
+// Every thread writes to its own shard, so recording takes no lock. At exit
+// the shards are merged and the totals printed to stderr. If GRAPH_TRACE is
+// set to a path, the scopes (including ScopedTimer and every worker thread
+// of parallel.h) are written there as Chrome trace-event JSON, viewable in
+// chrome://tracing or Perfetto.
+#ifndef COMMON_INSTRUMENTATION_H_
+#define COMMON_INSTRUMENTATION_H_
+
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <utility>
+
+#ifdef GRAPH_INSTRUMENTATION
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+#endif
+
+inline int64_t MonotonicMicros() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+#ifdef GRAPH_INSTRUMENTATION
+
+class Instrumentation {
+ public:
+  struct Histogram {
+    uint64_t count = 0;
+    uint64_t sum = 0;
+    uint64_t max = 0;
+    uint64_t buckets[64] = {};  // bucket b holds values in [2^(b-1), 2^b)
+
+    void Add(uint64_t value) {
+      count++;
+      sum += value;
+      max = std::max(max, value);
+      buckets[value == 0 ? 0 : 64 - __builtin_clzll(value)]++;
+    }
+  };
+
+  struct TraceEvent {
+    std::string name;
+    int64_t begin_us;
+    int64_t duration_us;
+  };
+
+  // Per-thread state. A shard is handed back to a pool when its thread
+  // exits and reused by the next one, so the short-lived workers of
+  // parallel.h show up as a bounded set of trace rows.
+  struct Shard {
+    int index;
+    std::vector<int64_t> counters;
+    std::vector<Histogram> histograms;
+    std::vector<TraceEvent> events;
+  };
+
+  static Instrumentation& Get() {
+    static Instrumentation instance;
+    return instance;
+  }
+
+  int RegisterCounter(const char* name) {
+    return Register(name, &counter_names_);
+  }
+  int RegisterHistogram(const char* name) {
+    return Register(name, &histogram_names_);
+  }
+
+  Shard* LocalShard() {
+    struct Lease {
+      Shard* shard = nullptr;
+      ~Lease() {
+        if (shard)
+          Get().Release(shard);
+      }
+    };
+    thread_local Lease lease;
+    if (!lease.shard)
+      lease.shard = Acquire();
+    return lease.shard;
+  }
+
+  bool tracing() const { return !trace_path_.empty(); }
+  int64_t start_us() const { return start_us_; }
+
+ private:
+  Instrumentation() : start_us_(MonotonicMicros()) {
+    if (const char* path = std::getenv("GRAPH_TRACE"))
+      trace_path_ = path;
+  }
+
+  // Threads have been joined by now; merge and report.
+  ~Instrumentation() {
+    std::vector<int64_t> counters(counter_names_.size());
+    std::vector<Histogram> histograms(histogram_names_.size());
+    for (const auto& shard : shards_) {
+      for (size_t i = 0; i < shard->counters.size(); i++)
+        counters[i] += shard->counters[i];
+      for (size_t i = 0; i < shard->histograms.size(); i++) {
+        const Histogram& h = shard->histograms[i];
+        Histogram& total = histograms[i];
+        total.count += h.count;
+        total.sum += h.sum;
+        total.max = std::max(total.max, h.max);
+        for (int b = 0; b < 64; b++)
+          total.buckets[b] += h.buckets[b];
+      }
+    }
+    for (size_t i = 0; i < counters.size(); i++)
+      std::cerr << "counter " << counter_names_[i] << ": " << counters[i]
+                << "\n";
+    for (size_t i = 0; i < histograms.size(); i++) {
+      const Histogram& h = histograms[i];
+      std::cerr << "histogram " << histogram_names_[i] << ": count " << h.count
+                << " mean " << (h.count ? static_cast<double>(h.sum) / h.count
+                                        : 0)
+                << " max " << h.max << " p50< " << Quantile(h, 0.5)
+                << " p99< " << Quantile(h, 0.99) << "\n";
+    }
+    if (tracing())
+      WriteTrace(counters);
+  }
+
+  // Upper bound of the log2 bucket holding the |q| quantile.
+  static uint64_t Quantile(const Histogram& h, double q) {
+    uint64_t seen = 0;
+    for (int b = 0; b < 64; b++) {
+      seen += h.buckets[b];
+      if (h.count && seen >= q * h.count)
+        return b == 0 ? 1 : b == 63 ? h.max : uint64_t(1) << b;
+    }
+    return 0;
+  }
+
+  static std::string Escape(const std::string& s) {
+    std::string out;
+    for (char c : s) {
+      if (c == '"' || c == '\\')
+        out += '\\';
+      out += c;
+    }
+    return out;
+  }
+
+  void WriteTrace(const std::vector<int64_t>& counters) const {
+    std::ofstream out(trace_path_);
+    if (out.fail()) {
+      std::cerr << "cannot write trace: " << trace_path_ << "\n";
+      return;
+    }
+    int64_t end_us = MonotonicMicros() - start_us_;
+    out << "{\"traceEvents\": [\n";
+    bool first = true;
+    for (const auto& shard : shards_) {
+      for (const TraceEvent& e : shard->events) {
+        out << (first ? "" : ",\n") << "{\"name\": \"" << Escape(e.name)
+            << "\", \"ph\": \"X\", \"pid\": 0, \"tid\": " << shard->index
+            << ", \"ts\": " << e.begin_us << ", \"dur\": " << e.duration_us
+            << "}";
+        first = false;
+      }
+    }
+    for (size_t i = 0; i < counters.size(); i++) {
+      out << (first ? "" : ",\n") << "{\"name\": \""
+          << Escape(counter_names_[i])
+          << "\", \"ph\": \"C\", \"pid\": 0, \"ts\": " << end_us
+          << ", \"args\": {\"value\": " << counters[i] << "}}";
+      first = false;
+    }
+    out << "\n]}\n";
+    std::cerr << "trace written to " << trace_path_ << "\n";
+  }
+
+  int Register(const char* name, std::vector<std::string>* names) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = std::find(names->begin(), names->end(), name);
+    if (it != names->end())
+      return it - names->begin();
+    names->push_back(name);
+    return names->size() - 1;
+  }
+
+  Shard* Acquire() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!free_shards_.empty()) {
+      Shard* shard = free_shards_.back();
+      free_shards_.pop_back();
+      return shard;
+    }
+    shards_.emplace_back(new Shard());
+    shards_.back()->index = shards_.size() - 1;
+    return shards_.back().get();
+  }
+
+  void Release(Shard* shard) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    free_shards_.push_back(shard);
+  }
+
+  const int64_t start_us_;
+  std::string trace_path_;
+  std::mutex mutex_;
+  std::vector<std::string> counter_names_;
+  std::vector<std::string> histogram_names_;
+  std::vector<std::unique_ptr<Shard>> shards_;
+  std::vector<Shard*> free_shards_;
+};
+
+class InstrumentCounter {
+ public:
+  explicit InstrumentCounter(const char* name)
+      : id_(Instrumentation::Get().RegisterCounter(name)) {}
+
+  void Add(int64_t delta) const {
+    auto* shard = Instrumentation::Get().LocalShard();
+    if (shard->counters.size() <= id_)
+      shard->counters.resize(id_ + 1);
+    shard->counters[id_] += delta;
+  }
+
+ private:
+  const size_t id_;
+};
+
+class InstrumentHistogram {
+ public:
+  explicit InstrumentHistogram(const char* name)
+      : id_(Instrumentation::Get().RegisterHistogram(name)) {}
+
+  void Add(uint64_t value) const {
+    auto* shard = Instrumentation::Get().LocalShard();
+    if (shard->histograms.size() <= id_)
+      shard->histograms.resize(id_ + 1);
+    shard->histograms[id_].Add(value);
+  }
+
+ private:
+  const size_t id_;
+};
+
+// Records one trace event covering its lifetime when GRAPH_TRACE is set.
+class TraceScope {
+ public:
+  explicit TraceScope(std::string name)
+      : instrumentation_(Instrumentation::Get()), name_(std::move(name)),
+        begin_us_(MonotonicMicros()) {}
+
+  ~TraceScope() {
+    if (!instrumentation_.tracing())
+      return;
+    int64_t now = MonotonicMicros();
+    instrumentation_.LocalShard()->events.push_back(
+        {std::move(name_), begin_us_ - instrumentation_.start_us(),
+         now - begin_us_});
+  }
+
+ private:
+  Instrumentation& instrumentation_;  // constructed before |begin_us_|
+  std::string name_;
+  const int64_t begin_us_;
+};
+
+#define INSTRUMENT_CONCAT_INNER(a, b) a##b
+#define INSTRUMENT_CONCAT(a, b) INSTRUMENT_CONCAT_INNER(a, b)
+#define INSTRUMENT_COUNT(name, delta)                        \
+  do {                                                       \
+    static const InstrumentCounter instrument_counter(name); \
+    instrument_counter.Add(delta);                           \
+  } while (0)
+#define INSTRUMENT_HISTOGRAM(name, value)                        \
+  do {                                                           \
+    static const InstrumentHistogram instrument_histogram(name); \
+    instrument_histogram.Add(value);                             \
+  } while (0)
+#define INSTRUMENT_SCOPE(name) \
+  TraceScope INSTRUMENT_CONCAT(instrument_scope_, __LINE__)(name)
+
+#else  // GRAPH_INSTRUMENTATION
+
+#define INSTRUMENT_COUNT(name, delta) static_cast<void>(0)
+#define INSTRUMENT_HISTOGRAM(name, value) static_cast<void>(0)
+#define INSTRUMENT_SCOPE(name) static_cast<void>(0)
+
+#endif  // GRAPH_INSTRUMENTATION
+
+// Prints "==== tag ====" when constructed and the elapsed wall time when
+// destroyed.
+class ScopedTimer {
+ public:
+  explicit ScopedTimer(const std::string& tag)
+      : tag_(tag),
+#ifdef GRAPH_INSTRUMENTATION
+        trace_(tag),
+#endif
+        begin_us_(MonotonicMicros()) {
+    std::cout << "==== " << tag_ << " ====\n";
+  }
+
+  ~ScopedTimer() {
+    std::cout << "Elapsed: " << std::setprecision(3) << elapsed() << " sec\n\n";
+  }
+
+  double elapsed() const { return (MonotonicMicros() - begin_us_) / 1E6; }
+
+ private:
+  std::string tag_;
+#ifdef GRAPH_INSTRUMENTATION
+  TraceScope trace_;
+#endif
+  const int64_t begin_us_;
+};
+
+#endif  // COMMON_INSTRUMENTATION_H_
@@ -0,0 +1,174 @@
+// Community detection by label propagation (Raghavan et al., 2007).
+//
+//   CsrGraph undirected = graph.Symmetrized();
+//   Communities c = LabelPropagation(undirected).Run(20);
+//
+// Every vertex starts in a community of its own and repeatedly adopts the
+// label most frequent among its neighbours, until no label changes. Ties
+// keep the current label if it is among them, else go to the label with
+// the smallest hash of (label, vertex, round): a fixed rule such as the
+// smallest label would let a few labels flood across community borders
+// in the first rounds, when every neighbour label counts once. Updates are
+// asynchronous: a round visits the frontier in parallel and each vertex
+// reads the labels as they are at that moment, which converges in fewer
+// rounds than synchronous updates and avoids their oscillation on
+// bipartite parts. Only the neighbours of vertexes whose label changed form
+// the next frontier, so late rounds touch a small part of the graph. Label
+// counts use one dense array per thread, cleared through the list of
+// labels it touched.
+//
+// Run() renumbers the communities 0, 1, ... by decreasing size and reports
+// the modularity of the result.
+#ifndef COMMON_LABEL_PROPAGATION_H_
+#define COMMON_LABEL_PROPAGATION_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "csr_graph.h"
+#include "hash.h"
+#include "instrumentation.h"
+#include "parallel.h"
+
+struct Communities {
+  std::vector<int> community;  // per vertex, 0 is the largest community
+  std::vector<int> sizes;      // per community
+  int rounds = 0;
+  int64_t updates = 0;  // vertexes visited over all rounds
+  double modularity = 0;
+};
+
+class LabelPropagation {
+ public:
+  // |graph| must be undirected (see CsrGraph::Symmetrized()).
+  explicit LabelPropagation(const CsrGraph& graph) : graph_(graph) {}
+
+  Communities Run(int max_rounds) const {
+    INSTRUMENT_SCOPE("LabelPropagation::Run");
+    int n = graph_.num_vertexes();
+    int num_threads = NumThreads();
+    std::unique_ptr<std::atomic<int>[]> labels(new std::atomic<int>[n]);
+    std::unique_ptr<std::atomic<bool>[]> queued(new std::atomic<bool>[n]);
+    ParallelFor(0, n, 4096, [&](int64_t v) {
+      labels[v].store(v, std::memory_order_relaxed);
+      queued[v].store(false, std::memory_order_relaxed);
+    });
+    std::vector<int> frontier(n);
+    for (int v = 0; v < n; v++)
+      frontier[v] = v;
+
+    Communities result;
+    std::vector<std::vector<int>> counts(num_threads);
+    std::vector<std::vector<int>> touched(num_threads);
+    std::vector<std::vector<int>> next(num_threads);
+    while (!frontier.empty() && result.rounds < max_rounds) {
+      result.rounds++;
+      result.updates += frontier.size();
+      INSTRUMENT_HISTOGRAM("lp.frontier", frontier.size());
+      ParallelForWithThreadId(0, frontier.size(), 256, [&](int tid,
+                                                           int64_t i) {
+        int v = frontier[i];
+        queued[v].store(false, std::memory_order_relaxed);
+        if (graph_.degree(v) == 0)
+          return;
+        std::vector<int>& count = counts[tid];
+        std::vector<int>& seen = touched[tid];
+        if (count.empty())
+          count.assign(n, 0);
+        for (const int* it = graph_.begin(v); it != graph_.end(v); ++it) {
+          int label = labels[*it].load(std::memory_order_relaxed);
+          if (count[label]++ == 0)
+            seen.push_back(label);
+        }
+        int current = labels[v].load(std::memory_order_relaxed);
+        int best = current;
+        int best_count = count[current];
+        uint64_t salt =
+            SplitMix64((static_cast<uint64_t>(v) << 20) ^ result.rounds);
+        uint64_t best_hash = ~uint64_t(0);
+        for (int label : seen) {
+          int c = count[label];
+          count[label] = 0;
+          if (c < best_count || (c == best_count && best == current))
+            continue;
+          uint64_t hash = SplitMix64(label ^ salt);
+          if (c > best_count || hash < best_hash) {
+            best = label;
+            best_count = c;
+            best_hash = hash;
+          }
+        }
+        count[current] = 0;
+        seen.clear();
+        if (best == current)
+          return;
+        labels[v].store(best, std::memory_order_relaxed);
+        for (const int* it = graph_.begin(v); it != graph_.end(v); ++it) {
+          if (!queued[*it].exchange(true, std::memory_order_relaxed))
+            next[tid].push_back(*it);
+        }
+      });
+      frontier.clear();
+      for (std::vector<int>& part : next) {
+        frontier.insert(frontier.end(), part.begin(), part.end());
+        part.clear();
+      }
+    }
+
+    // Renumber by decreasing size.
+    std::vector<int> size(n, 0);
+    for (int v = 0; v < n; v++)
+      size[labels[v].load(std::memory_order_relaxed)]++;
+    std::vector<int> order;
+    for (int label = 0; label < n; label++) {
+      if (size[label] > 0)
+        order.push_back(label);
+    }
+    std::sort(order.begin(), order.end(), [&](int a, int b) {
+      return size[a] != size[b] ? size[a] > size[b] : a < b;
+    });
+    std::vector<int> id(n, -1);
+    for (size_t c = 0; c < order.size(); c++) {
+      id[order[c]] = c;
+      result.sizes.push_back(size[order[c]]);
+    }
+    result.community.resize(n);
+    ParallelFor(0, n, 4096, [&](int64_t v) {
+      result.community[v] = id[labels[v].load(std::memory_order_relaxed)];
+    });
+    result.modularity = Modularity(result.community, result.sizes.size());
+    return result;
+  }
+
+  // Newman's modularity: the fraction of edges inside communities minus the
+  // fraction expected if the edges were rewired at random.
+  double Modularity(const std::vector<int>& community,
+                    int num_communities) const {
+    int n = graph_.num_vertexes();
+    double m2 = graph_.num_edges();  // both directions of each edge
+    if (m2 == 0)
+      return 0;
+    std::vector<double> inside(NumThreads(), 0);
+    ParallelForWithThreadId(0, n, 4096, [&](int tid, int64_t v) {
+      for (const int* it = graph_.begin(v); it != graph_.end(v); ++it)
+        inside[tid] += community[*it] == community[v];
+    });
+    std::vector<double> degree_sum(num_communities, 0);
+    for (int v = 0; v < n; v++)
+      degree_sum[community[v]] += graph_.degree(v);
+    double q = 0;
+    for (double e : inside)
+      q += e / m2;
+    for (double d : degree_sum)
+      q -= (d / m2) * (d / m2);
+    return q;
+  }
+
+ private:
+  const CsrGraph& graph_;
+};
+
+#endif  // COMMON_LABEL_PROPAGATION_H_
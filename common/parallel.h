@@ -0,0 +1,181 @@
+// Tiny std::thread based helpers shared by the graph programs.
+//
+// The number of workers defaults to std::thread::hardware_concurrency() and
+// can be overridden with the NUM_THREADS environment variable.
+#ifndef COMMON_PARALLEL_H_
+#define COMMON_PARALLEL_H_
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "graph_memory.h"
+#include "instrumentation.h"
+
+inline int NumThreads() {
+  static const int num_threads = [] {
+    const char* env = std::getenv("NUM_THREADS");
+    if (env && std::atoi(env) > 0)
+      return std::atoi(env);
+    int hw = static_cast<int>(std::thread::hardware_concurrency());
+    return hw > 0 ? hw : 1;
+  }();
+  return num_threads;
+}
+
+// Runs |fn(thread_id)| on |num_threads| threads and waits for all of them.
+// The calling thread works as thread 0. With GRAPH_PIN_THREADS=1 thread i
+// is pinned to the i-th CPU in NUMA node order (see graph_memory.h).
+template <typename Fn>
+void RunOnThreads(int num_threads, Fn fn) {
+  auto worker = [&fn](int tid) {
+    INSTRUMENT_SCOPE("worker");
+    if (GraphMemory::Get().options().pin_threads)
+      GraphMemory::Get().PinCurrentThread(tid);
+    fn(tid);
+  };
+  std::vector<std::thread> threads;
+  for (int t = 1; t < num_threads; t++)
+    threads.emplace_back(worker, t);
+  worker(0);
+  for (auto& th : threads)
+    th.join();
+}
+
+// Threads that outlive a call, for work too short to pay for starting
+// threads every time (e.g. one shortest path query). Run() works like
+// RunOnThreads() on num_threads() threads; it must not be called
+// concurrently.
+class WorkerPool {
+ public:
+  explicit WorkerPool(int num_threads) : num_threads_(num_threads) {
+    for (int t = 1; t < num_threads_; t++)
+      threads_.emplace_back([this, t] { Work(t); });
+  }
+
+  ~WorkerPool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    wake_.notify_all();
+    for (auto& th : threads_)
+      th.join();
+  }
+
+  int num_threads() const { return num_threads_; }
+
+  template <typename Fn>
+  void Run(Fn fn) {
+    if (GraphMemory::Get().options().pin_threads)
+      GraphMemory::Get().PinCurrentThread(0);
+    if (num_threads_ == 1) {
+      fn(0);
+      return;
+    }
+    pending_.store(num_threads_ - 1, std::memory_order_relaxed);
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      job_ = [](void* context, int tid) { (*static_cast<Fn*>(context))(tid); };
+      context_ = &fn;
+      generation_++;
+    }
+    wake_.notify_all();
+    fn(0);
+    while (pending_.load(std::memory_order_acquire) > 0)
+      std::this_thread::yield();
+  }
+
+ private:
+  void Work(int tid) {
+    if (GraphMemory::Get().options().pin_threads)
+      GraphMemory::Get().PinCurrentThread(tid);
+    uint64_t seen = 0;
+    while (true) {
+      void (*job)(void*, int);
+      void* context;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        wake_.wait(lock, [&] { return stop_ || generation_ != seen; });
+        if (stop_)
+          return;
+        seen = generation_;
+        job = job_;
+        context = context_;
+      }
+      job(context, tid);
+      pending_.fetch_sub(1, std::memory_order_release);
+    }
+  }
+
+  const int num_threads_;
+  std::vector<std::thread> threads_;
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  uint64_t generation_ = 0;  // number of Run() calls
+  bool stop_ = false;
+  void (*job_)(void*, int) = nullptr;
+  void* context_ = nullptr;
+  std::atomic<int> pending_{0};  // workers still running the current job
+};
+
+// Calls |fn(thread_id, i)| for every i in [begin, end). Iterations are handed
+// out dynamically in chunks of |grain| so skewed work (e.g. hub vertices) is
+// balanced across threads.
+template <typename Fn>
+void ParallelForWithThreadId(int64_t begin, int64_t end, int64_t grain,
+                             Fn fn) {
+  if (end <= begin)
+    return;
+  grain = std::max<int64_t>(grain, 1);
+  int num_threads = static_cast<int>(
+      std::min<int64_t>(NumThreads(), (end - begin + grain - 1) / grain));
+  std::atomic<int64_t> next(begin);
+  RunOnThreads(num_threads, [&](int tid) {
+    while (true) {
+      int64_t chunk_begin = next.fetch_add(grain, std::memory_order_relaxed);
+      if (chunk_begin >= end)
+        break;
+      int64_t chunk_end = std::min(chunk_begin + grain, end);
+      for (int64_t i = chunk_begin; i < chunk_end; i++)
+        fn(tid, i);
+    }
+  });
+}
+
+template <typename Fn>
+void ParallelFor(int64_t begin, int64_t end, int64_t grain, Fn fn) {
+  ParallelForWithThreadId(begin, end, grain,
+                          [&fn](int, int64_t i) { fn(i); });
+}
+
+// Reusable barrier for a fixed number of threads. Waiters spin and yield,
+// which is cheap when the barrier is crossed many times per second.
+class SpinBarrier {
+ public:
+  explicit SpinBarrier(int num_threads)
+      : num_threads_(num_threads), waiting_(0), generation_(0) {}
+
+  void Wait() {
+    int generation = generation_.load(std::memory_order_acquire);
+    if (waiting_.fetch_add(1, std::memory_order_acq_rel) + 1 == num_threads_) {
+      waiting_.store(0, std::memory_order_relaxed);
+      generation_.fetch_add(1, std::memory_order_acq_rel);
+      return;
+    }
+    while (generation_.load(std::memory_order_acquire) == generation)
+      std::this_thread::yield();
+  }
+
+ private:
+  const int num_threads_;
+  std::atomic<int> waiting_;
+  std::atomic<int> generation_;
+};
+
+#endif  // COMMON_PARALLEL_H_
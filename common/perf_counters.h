@@ -0,0 +1,231 @@
+// Hardware performance counters around code regions.
+//
+// Opt in with GRAPH_PERF=1. Counters for cycles, instructions, LLC misses,
+// dTLB load misses and branch misses are then opened with perf_event_open
+// for the whole process (threads started later are included), and every
+// PerfScope adds the counter deltas of its lifetime to its region:
+//
+//   {
+//     PerfScope perf("UpdatePageRank");
+//     ...
+//     perf.AddItems(edges);  // for the "per edge" columns
+//   }
+//
+// The regions are printed to stderr at exit with IPC and misses per item.
+// Events the kernel refuses (no PMU in a VM or container, or
+// perf_event_paranoid too strict) are reported as n/a; if none can be
+// opened a PerfScope costs one branch.
+#ifndef COMMON_PERF_COUNTERS_H_
+#define COMMON_PERF_COUNTERS_H_
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+class PerfProfiler {
+ public:
+  enum Event {
+    kCycles,
+    kInstructions,
+    kLlcMisses,
+    kDtlbMisses,
+    kBranchMisses,
+    kNumEvents
+  };
+
+  struct Sample {
+    uint64_t values[kNumEvents] = {};
+  };
+
+  static PerfProfiler& Get() {
+    static PerfProfiler instance;
+    return instance;
+  }
+
+  bool enabled() const { return enabled_; }
+
+  Sample Read() const {
+    Sample sample;
+#ifdef __linux__
+    for (int e = 0; e < kNumEvents; e++) {
+      if (fds_[e] < 0)
+        continue;
+      // value, time enabled, time running; scale up if the PMU had to
+      // multiplex the events.
+      uint64_t data[3] = {};
+      if (read(fds_[e], data, sizeof(data)) != sizeof(data))
+        continue;
+      sample.values[e] =
+          data[2] ? static_cast<uint64_t>(static_cast<double>(data[0]) *
+                                          data[1] / data[2])
+                  : 0;
+    }
+#endif
+    return sample;
+  }
+
+  void Add(const std::string& region, const Sample& begin, const Sample& end,
+           int64_t items) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Region* r = nullptr;
+    for (auto& candidate : regions_)
+      if (candidate.name == region)
+        r = &candidate;
+    if (!r) {
+      regions_.push_back(Region{region});
+      r = &regions_.back();
+    }
+    r->calls++;
+    r->items += items;
+    for (int e = 0; e < kNumEvents; e++)
+      r->totals[e] += end.values[e] - begin.values[e];
+  }
+
+ private:
+  struct Region {
+    std::string name;
+    int64_t calls = 0;
+    int64_t items = 0;
+    uint64_t totals[kNumEvents] = {};
+  };
+
+  PerfProfiler() {
+    for (int e = 0; e < kNumEvents; e++)
+      fds_[e] = -1;
+    const char* env = std::getenv("GRAPH_PERF");
+    if (!env || std::atoi(env) == 0)
+      return;
+#ifdef __linux__
+    int error = 0;
+    for (int e = 0; e < kNumEvents; e++) {
+      perf_event_attr attr;
+      std::memset(&attr, 0, sizeof(attr));
+      attr.size = sizeof(attr);
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      attr.inherit = 1;
+      attr.read_format =
+          PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+      attr.type = PERF_TYPE_HARDWARE;
+      switch (e) {
+        case kCycles:
+          attr.config = PERF_COUNT_HW_CPU_CYCLES;
+          break;
+        case kInstructions:
+          attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+          break;
+        case kLlcMisses:
+          attr.config = PERF_COUNT_HW_CACHE_MISSES;
+          break;
+        case kDtlbMisses:
+          attr.type = PERF_TYPE_HW_CACHE;
+          attr.config = PERF_COUNT_HW_CACHE_DTLB |
+                        (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                        (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+          break;
+        case kBranchMisses:
+          attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+          break;
+      }
+      fds_[e] = static_cast<int>(
+          syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+      if (fds_[e] < 0)
+        error = errno;
+      else
+        enabled_ = true;
+    }
+    if (!enabled_) {
+      std::cerr << "perf counters unavailable: " << std::strerror(error)
+                << " (check /proc/sys/kernel/perf_event_paranoid)\n";
+    }
+#else
+    std::cerr << "perf counters unavailable on this platform\n";
+#endif
+  }
+
+  ~PerfProfiler() {
+    for (const Region& r : regions_)
+      Print(r);
+#ifdef __linux__
+    for (int e = 0; e < kNumEvents; e++)
+      if (fds_[e] >= 0)
+        close(fds_[e]);
+#endif
+  }
+
+  void Print(const Region& r) const {
+    auto column = [&](const char* label, Event e, int64_t per) {
+      std::cerr << " " << label << " ";
+      if (fds_[e] < 0)
+        std::cerr << "n/a";
+      else
+        std::cerr << static_cast<double>(r.totals[e]) /
+                         std::max<int64_t>(per, 1);
+    };
+    std::cerr << "perf " << r.name << ": calls " << r.calls
+              << std::setprecision(4);
+    column("cycles", kCycles, 1);
+    column("instructions", kInstructions, 1);
+    std::cerr << " IPC ";
+    if (fds_[kCycles] < 0 || fds_[kInstructions] < 0 || !r.totals[kCycles])
+      std::cerr << "n/a";
+    else
+      std::cerr << static_cast<double>(r.totals[kInstructions]) /
+                       r.totals[kCycles];
+    if (r.items > 0) {
+      std::cerr << " items " << r.items;
+      column("LLC-miss/item", kLlcMisses, r.items);
+      column("dTLB-miss/item", kDtlbMisses, r.items);
+      column("branch-miss/item", kBranchMisses, r.items);
+    } else {
+      column("LLC-misses", kLlcMisses, 1);
+      column("dTLB-misses", kDtlbMisses, 1);
+      column("branch-misses", kBranchMisses, 1);
+    }
+    std::cerr << "\n";
+  }
+
+  bool enabled_ = false;
+  int fds_[kNumEvents];
+  std::mutex mutex_;
+  std::vector<Region> regions_;
+};
+
+// Adds the counter deltas over its lifetime to region |name|.
+class PerfScope {
+ public:
+  explicit PerfScope(const char* name)
+      : profiler_(PerfProfiler::Get()), name_(name) {
+    if (profiler_.enabled())
+      begin_ = profiler_.Read();
+  }
+
+  ~PerfScope() {
+    if (profiler_.enabled())
+      profiler_.Add(name_, begin_, profiler_.Read(), items_);
+  }
+
+  // Work done in the region, e.g. edges traversed.
+  void AddItems(int64_t items) { items_ += items; }
+
+ private:
+  PerfProfiler& profiler_;
+  const char* name_;
+  PerfProfiler::Sample begin_;
+  int64_t items_ = 0;
+};
+
+#endif  // COMMON_PERF_COUNTERS_H_
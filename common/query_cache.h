@@ -0,0 +1,204 @@
+// Concurrent cache of query answers, invalidated by graph version.
+//
+//   QueryCache<std::string, Answers> cache(64 << 20);
+//   if (!cache.Get(query, graph.version(), &answers)) {
+//     answers = graph.Search(query);
+//     cache.Put(query, graph.version(), answers, BytesOf(answers));
+//   }
+//
+// Keys are hashed to one of |num_shards| shards, each with its own mutex,
+// hash table and share of the memory budget, so threads working on
+// different keys rarely wait for each other. A shard evicts with the CLOCK
+// algorithm: a hit sets the entry's reference bit, and the hand clears set
+// bits and evicts the first entry found without one, which approximates LRU
+// without reordering a list on every hit.
+//
+// Every entry is tagged with the version of the graph that produced it. A
+// Get() or Put() with another version empties the shard first, so an
+// answer never outlives the graph it was computed on. NextGraphVersion()
+// hands out process-wide unique versions; a graph takes a new one whenever
+// it is loaded or its links change.
+#ifndef COMMON_QUERY_CACHE_H_
+#define COMMON_QUERY_CACHE_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "hash.h"
+
+inline uint64_t NextGraphVersion() {
+  static std::atomic<uint64_t> version(0);
+  return version.fetch_add(1) + 1;
+}
+
+struct PairHash {
+  size_t operator()(const std::pair<int, int>& p) const {
+    uint64_t x = (static_cast<uint64_t>(static_cast<uint32_t>(p.first)) << 32) |
+                 static_cast<uint32_t>(p.second);
+    return Mix64(x);
+  }
+};
+
+template <typename Key, typename Value, typename Hash = std::hash<Key>>
+class QueryCache {
+ public:
+  struct Stats {
+    int64_t hits = 0;
+    int64_t misses = 0;
+    int64_t evictions = 0;
+    int64_t invalidations = 0;  // entries dropped for a new graph version
+    int64_t entries = 0;
+    int64_t bytes = 0;
+  };
+
+  // Bookkeeping charged to every entry on top of the caller's size.
+  static const size_t kEntryOverhead = sizeof(Key) + sizeof(Value) + 64;
+
+  explicit QueryCache(size_t budget_bytes, int num_shards = 16)
+      : shards_(std::max(1, num_shards)) {
+    for (Shard& shard : shards_)
+      shard.budget = budget_bytes / shards_.size();
+  }
+
+  // Copies the answer for |key| computed on graph |version| into |*value|.
+  bool Get(const Key& key, uint64_t version, Value* value) {
+    Shard& shard = ShardOf(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    Validate(&shard, version);
+    auto it = shard.index.find(key);
+    if (it == shard.index.end()) {
+      shard.stats.misses++;
+      return false;
+    }
+    Slot& slot = shard.slots[it->second];
+    slot.referenced = true;
+    *value = slot.value;
+    shard.stats.hits++;
+    return true;
+  }
+
+  // Stores |value|, about |bytes| bytes beyond its sizeof, unless it is
+  // larger than a shard's budget.
+  void Put(const Key& key, uint64_t version, Value value, size_t bytes) {
+    Shard& shard = ShardOf(key);
+    size_t charge = bytes + kEntryOverhead;
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    Validate(&shard, version);
+    if (charge > shard.budget)
+      return;
+    auto it = shard.index.find(key);
+    if (it != shard.index.end())
+      Erase(&shard, it->second);
+    while (shard.stats.bytes + charge > shard.budget)
+      Evict(&shard);
+
+    size_t i;
+    if (!shard.free.empty()) {
+      i = shard.free.back();
+      shard.free.pop_back();
+    } else {
+      i = shard.slots.size();
+      shard.slots.emplace_back();
+    }
+    Slot& slot = shard.slots[i];
+    slot.key = key;
+    slot.value = std::move(value);
+    slot.bytes = charge;
+    slot.used = true;
+    slot.referenced = false;
+    shard.index.emplace(key, i);
+    shard.stats.entries++;
+    shard.stats.bytes += charge;
+  }
+
+  Stats stats() const {
+    Stats total;
+    for (const Shard& shard : shards_) {
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      total.hits += shard.stats.hits;
+      total.misses += shard.stats.misses;
+      total.evictions += shard.stats.evictions;
+      total.invalidations += shard.stats.invalidations;
+      total.entries += shard.stats.entries;
+      total.bytes += shard.stats.bytes;
+    }
+    return total;
+  }
+
+ private:
+  struct Slot {
+    Key key;
+    Value value;
+    size_t bytes = 0;
+    bool used = false;
+    bool referenced = false;
+  };
+
+  struct Shard {
+    mutable std::mutex mutex;
+    size_t budget = 0;
+    uint64_t version = 0;
+    std::unordered_map<Key, size_t, Hash> index;
+    std::vector<Slot> slots;
+    std::vector<size_t> free;
+    size_t hand = 0;
+    Stats stats;
+  };
+
+  Shard& ShardOf(const Key& key) {
+    // The low bits may also pick the hash table bucket, so mix first.
+    uint64_t h = Hash()(key) * 0x9E3779B97F4A7C15ULL;
+    return shards_[(h >> 32) % shards_.size()];
+  }
+
+  static void Validate(Shard* shard, uint64_t version) {
+    if (shard->version == version)
+      return;
+    shard->stats.invalidations += shard->stats.entries;
+    shard->index.clear();
+    shard->slots.clear();
+    shard->free.clear();
+    shard->hand = 0;
+    shard->stats.entries = 0;
+    shard->stats.bytes = 0;
+    shard->version = version;
+  }
+
+  static void Erase(Shard* shard, size_t i) {
+    Slot& slot = shard->slots[i];
+    shard->index.erase(slot.key);
+    shard->stats.entries--;
+    shard->stats.bytes -= slot.bytes;
+    slot = Slot();
+    shard->free.push_back(i);
+  }
+
+  // Advances the clock hand to the first unreferenced entry and drops it.
+  static void Evict(Shard* shard) {
+    while (true) {
+      if (shard->hand >= shard->slots.size())
+        shard->hand = 0;
+      Slot& slot = shard->slots[shard->hand++];
+      if (!slot.used)
+        continue;
+      if (slot.referenced) {
+        slot.referenced = false;
+        continue;
+      }
+      Erase(shard, shard->hand - 1);
+      shard->stats.evictions++;
+      return;
+    }
+  }
+
+  std::vector<Shard> shards_;
+};
+
+#endif  // COMMON_QUERY_CACHE_H_
@@ -0,0 +1,284 @@
+// Reachability index: can vertex u reach vertex v along the links?
+//
+//   ReachabilityIndex index(graph, 3);
+//   bool yes = index.Reaches(u, v);
+//
+// The strongly connected components (iterative Tarjan) are collapsed into
+// a DAG whose vertexes are numbered in topological order, so u can only
+// reach v if comp(u) <= comp(v). Three filters then answer most queries
+// without a traversal, all of them necessary conditions for comp(u) to
+// reach a different comp(v):
+//   - topological order: comp(u) < comp(v);
+//   - level, the longest path from a DAG root: level(u) < level(v);
+//   - GRAIL (Yildirim et al., VLDB 2010): for each of |num_intervals|
+//     randomized DFS traversals, the interval [lowest post-order rank of a
+//     descendant, own post-order rank] of comp(v) lies inside that of
+//     comp(u).
+// A query that passes all of them runs a DFS on the DAG from comp(u) that
+// only descends into components passing the filters for comp(v), which is
+// short in practice.
+//
+// Reaches() reuses a visited array and is not thread-safe; it counts how
+// each query was answered in stats().
+#ifndef COMMON_REACHABILITY_INDEX_H_
+#define COMMON_REACHABILITY_INDEX_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "csr_graph.h"
+#include "hash.h"
+#include "instrumentation.h"
+
+class ReachabilityIndex {
+ public:
+  struct Stats {
+    int64_t same_component = 0;
+    int64_t order_filter = 0;     // rejected by topological order or level
+    int64_t interval_filter = 0;  // rejected by a GRAIL interval
+    int64_t searched = 0;         // needed a DFS
+    int64_t searched_reachable = 0;
+    int64_t searched_vertexes = 0;  // DAG vertexes visited by those DFSs
+  };
+
+  ReachabilityIndex(const CsrGraph& graph, int num_intervals)
+      : num_intervals_(std::max(1, num_intervals)) {
+    INSTRUMENT_SCOPE("ReachabilityIndex::Build");
+    FindComponents(graph);
+    BuildDag(graph);
+    ComputeLevels();
+    ComputeIntervals();
+    visited_.assign(num_components(), 0);
+  }
+
+  int num_components() const { return static_cast<int>(level_.size()); }
+  int component(int v) const { return component_[v]; }
+  const CsrGraph& dag() const { return dag_; }
+  const Stats& stats() const { return stats_; }
+
+  int64_t memory_bytes() const {
+    return component_.size() * sizeof(int) + level_.size() * sizeof(int) +
+           intervals_.size() * sizeof(Interval) +
+           dag_.offsets().size() * sizeof(int64_t) +
+           dag_.targets().size() * sizeof(int);
+  }
+
+  bool Reaches(int u, int v) {
+    int from = component_[u];
+    int to = component_[v];
+    if (from == to) {
+      stats_.same_component++;
+      return true;
+    }
+    if (from > to || level_[from] >= level_[to]) {
+      stats_.order_filter++;
+      return false;
+    }
+    if (!Contains(from, to)) {
+      stats_.interval_filter++;
+      return false;
+    }
+    stats_.searched++;
+    bool found = Search(from, to);
+    stats_.searched_reachable += found;
+    return found;
+  }
+
+ private:
+  struct Interval {
+    int low;   // lowest post-order rank among the descendants
+    int rank;  // own post-order rank
+  };
+
+  // Tarjan's algorithm without recursion. Components are found sinks
+  // first, so they are numbered backwards to get a topological order.
+  void FindComponents(const CsrGraph& graph) {
+    int n = graph.num_vertexes();
+    std::vector<int> index(n, -1), low(n, 0);
+    std::vector<bool> on_stack(n, false);
+    std::vector<int> stack;
+    std::vector<std::pair<int, const int*>> calls;  // vertex, next link
+    component_.assign(n, -1);
+    int next_index = 0;
+    int found = 0;
+    for (int s = 0; s < n; s++) {
+      if (index[s] >= 0)
+        continue;
+      calls.emplace_back(s, graph.begin(s));
+      index[s] = low[s] = next_index++;
+      stack.push_back(s);
+      on_stack[s] = true;
+      while (!calls.empty()) {
+        int v = calls.back().first;
+        const int*& it = calls.back().second;
+        if (it != graph.end(v)) {
+          int w = *it++;
+          if (index[w] < 0) {
+            index[w] = low[w] = next_index++;
+            stack.push_back(w);
+            on_stack[w] = true;
+            calls.emplace_back(w, graph.begin(w));
+          } else if (on_stack[w]) {
+            low[v] = std::min(low[v], index[w]);
+          }
+          continue;
+        }
+        calls.pop_back();
+        if (!calls.empty()) {
+          int parent = calls.back().first;
+          low[parent] = std::min(low[parent], low[v]);
+        }
+        if (low[v] != index[v])
+          continue;
+        int w;
+        do {
+          w = stack.back();
+          stack.pop_back();
+          on_stack[w] = false;
+          component_[w] = found;
+        } while (w != v);
+        found++;
+      }
+    }
+    for (int& c : component_)
+      c = found - 1 - c;
+    INSTRUMENT_COUNT("reach.components", found);
+  }
+
+  void BuildDag(const CsrGraph& graph) {
+    int c = 0;
+    for (int comp : component_)
+      c = std::max(c, comp + 1);
+    std::vector<std::vector<std::pair<int, int>>> parts(1);
+    for (int u = 0; u < graph.num_vertexes(); u++) {
+      for (const int* it = graph.begin(u); it != graph.end(u); ++it) {
+        if (component_[u] != component_[*it])
+          parts[0].emplace_back(component_[u], component_[*it]);
+      }
+    }
+    dag_ = CsrGraph::FromUnsortedEdges(c, parts);
+    level_.assign(c, 0);
+  }
+
+  // Longest path from a root, in topological order.
+  void ComputeLevels() {
+    for (int c = 0; c < num_components(); c++) {
+      for (const int* it = dag_.begin(c); it != dag_.end(c); ++it)
+        level_[*it] = std::max(level_[*it], level_[c] + 1);
+    }
+  }
+
+  // One DFS per interval set; children are visited from a different
+  // starting offset each time so that the traversals differ.
+  void ComputeIntervals() {
+    int c = num_components();
+    intervals_.resize(static_cast<size_t>(c) * num_intervals_);
+    std::vector<int> in_degree(c, 0);
+    for (int d : dag_.targets())
+      in_degree[d]++;
+    std::vector<bool> done(c);
+    std::vector<std::pair<int, int>> calls;  // component, children visited
+    for (int t = 0; t < num_intervals_; t++) {
+      std::fill(done.begin(), done.end(), false);
+      int rank = 0;
+      auto start = [&](int x) {
+        int degree = dag_.degree(x);
+        return degree ? static_cast<int>(Mix64(x * 0x9E3779B9ULL + t) % degree)
+                      : 0;
+      };
+      auto visit_root = [&](int root) {
+        if (done[root] || in_degree[root] != 0)
+          return;
+        done[root] = true;
+        calls.emplace_back(root, 0);
+        At(root, t) = {c, -1};
+        while (!calls.empty()) {
+          int x = calls.back().first;
+          int& i = calls.back().second;
+          int degree = dag_.degree(x);
+          if (i < degree) {
+            int y = dag_.begin(x)[(start(x) + i++) % degree];
+            if (!done[y]) {
+              done[y] = true;
+              At(y, t) = {c, -1};
+              calls.emplace_back(y, 0);
+            } else {
+              At(x, t).low = std::min(At(x, t).low, At(y, t).low);
+            }
+            continue;
+          }
+          At(x, t).rank = rank++;
+          At(x, t).low = std::min(At(x, t).low, At(x, t).rank);
+          calls.pop_back();
+          if (!calls.empty()) {
+            int parent = calls.back().first;
+            At(parent, t).low = std::min(At(parent, t).low, At(x, t).low);
+          }
+        }
+      };
+      // Roots in a different order for every traversal as well.
+      if (t % 2 == 0) {
+        for (int r = 0; r < c; r++)
+          visit_root(r);
+      } else {
+        for (int r = c - 1; r >= 0; r--)
+          visit_root(r);
+      }
+    }
+  }
+
+  Interval& At(int c, int t) {
+    return intervals_[static_cast<size_t>(c) * num_intervals_ + t];
+  }
+
+  bool Contains(int from, int to) const {
+    const Interval* a = &intervals_[static_cast<size_t>(from) *
+                                    num_intervals_];
+    const Interval* b = &intervals_[static_cast<size_t>(to) * num_intervals_];
+    for (int t = 0; t < num_intervals_; t++) {
+      if (b[t].low < a[t].low || b[t].rank > a[t].rank)
+        return false;
+    }
+    return true;
+  }
+
+  // DFS on the DAG from |from|, pruned by the filters for |to|.
+  bool Search(int from, int to) {
+    if (++epoch_ == 0) {
+      std::fill(visited_.begin(), visited_.end(), 0);
+      epoch_ = 1;
+    }
+    stack_.assign(1, from);
+    visited_[from] = epoch_;
+    while (!stack_.empty()) {
+      int x = stack_.back();
+      stack_.pop_back();
+      stats_.searched_vertexes++;
+      for (const int* it = dag_.begin(x); it != dag_.end(x); ++it) {
+        int y = *it;
+        if (y == to)
+          return true;
+        if (visited_[y] == epoch_ || y > to || level_[y] >= level_[to] ||
+            !Contains(y, to))
+          continue;
+        visited_[y] = epoch_;
+        stack_.push_back(y);
+      }
+    }
+    return false;
+  }
+
+  int num_intervals_;
+  std::vector<int> component_;
+  CsrGraph dag_;  // component links, in topological order
+  std::vector<int> level_;
+  std::vector<Interval> intervals_;  // num_intervals_ per component
+  Stats stats_;
+  std::vector<uint32_t> visited_;
+  uint32_t epoch_ = 0;
+  std::vector<int> stack_;
+};
+
+#endif  // COMMON_REACHABILITY_INDEX_H_
@@ -0,0 +1,127 @@
+// Stream VByte coding of uint32 arrays (Lemire, Kurz and Rupp).
+//
+// Integers are taken in groups of 4. Each group has one control byte with
+// the byte length (1-4) of every integer, two bits each; the control bytes
+// of all groups come first, followed by the data bytes. Unlike the group
+// varint of compressed_graph.h, where the tag sits in front of its group,
+// the control stream can be read ahead of the data, and with SSSE3 a group
+// is decoded with a single pshufb. SSSE3 needs make SIMD=1 (or
+// SIMD=native); other builds use the scalar loop.
+//
+// Decode() may load up to kPadding bytes past the end of the data, so
+// buffers handed to it must be padded.
+#ifndef COMMON_STREAM_VBYTE_H_
+#define COMMON_STREAM_VBYTE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#ifdef __SSSE3__
+#include <tmmintrin.h>
+#endif
+
+class StreamVByte {
+ public:
+  static constexpr size_t kPadding = 16;
+
+  static size_t MaxEncodedBytes(size_t count) {
+    return (count + 3) / 4 + 4 * count;
+  }
+
+  // Encodes |count| integers into |out|, which must hold MaxEncodedBytes().
+  // Returns the bytes written.
+  static size_t Encode(const uint32_t* in, size_t count, uint8_t* out) {
+    uint8_t* control = out;
+    uint8_t* data = out + (count + 3) / 4;
+    std::memset(control, 0, (count + 3) / 4);
+    for (size_t i = 0; i < count; i++) {
+      uint32_t x = in[i];
+      int length = x < (1u << 8) ? 1 : x < (1u << 16) ? 2
+                   : x < (1u << 24) ? 3 : 4;
+      control[i / 4] |= (length - 1) << (2 * (i % 4));
+      for (int b = 0; b < length; b++)
+        *data++ = static_cast<uint8_t>(x >> (8 * b));
+    }
+    return data - out;
+  }
+
+  // Bytes taken by |count| encoded integers at |in|, read from the control
+  // bytes alone; lets callers check a stream before decoding it.
+  static size_t EncodedBytes(const uint8_t* in, size_t count) {
+    size_t control_bytes = (count + 3) / 4;
+    size_t bytes = control_bytes + count;
+    for (size_t i = 0; i < count; i++)
+      bytes += (in[i / 4] >> (2 * (i % 4))) & 3;
+    return bytes;
+  }
+
+  // Decodes |count| integers from |in| into |out| and returns the end of
+  // the encoded bytes.
+  static const uint8_t* Decode(const uint8_t* in, size_t count,
+                               uint32_t* out) {
+    const uint8_t* control = in;
+    const uint8_t* data = in + (count + 3) / 4;
+    size_t groups = count / 4;
+    for (size_t g = 0; g < groups; g++)
+      data += DecodeGroup(control[g], data, out + 4 * g);
+    for (size_t i = 4 * groups; i < count; i++)
+      out[i] = Get(&data, ((control[i / 4] >> (2 * (i % 4))) & 3) + 1);
+    return data;
+  }
+
+  // Decodes the 4 integers of one group, whose byte lengths are packed in
+  // |control|, and returns the data bytes they took. Loads 16 bytes from
+  // |data|. Also decodes the group varint of compressed_graph.h.
+  static size_t DecodeGroup(uint8_t control, const uint8_t* data,
+                            uint32_t* out) {
+#ifdef __SSSE3__
+    const Tables& tables = GetTables();
+    __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+    __m128i shuffle = _mm_loadu_si128(
+        reinterpret_cast<const __m128i*>(tables.shuffle[control]));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out),
+                     _mm_shuffle_epi8(bytes, shuffle));
+    return tables.length[control];
+#else
+    const uint8_t* p = data;
+    for (int i = 0; i < 4; i++)
+      out[i] = Get(&p, ((control >> (2 * i)) & 3) + 1);
+    return p - data;
+#endif
+  }
+
+ private:
+  static uint32_t Get(const uint8_t** data, int length) {
+    uint32_t x = 0;
+    std::memcpy(&x, *data, 4);  // little endian; input is padded
+    *data += length;
+    return length == 4 ? x : x & ((1u << (8 * length)) - 1);
+  }
+
+#ifdef __SSSE3__
+  struct Tables {
+    Tables() {
+      for (int c = 0; c < 256; c++) {
+        int pos = 0;
+        for (int i = 0; i < 4; i++) {
+          int length = ((c >> (2 * i)) & 3) + 1;
+          for (int b = 0; b < 4; b++)
+            shuffle[c][4 * i + b] = b < length ? pos + b : 0x80;
+          pos += length;
+        }
+        length[c] = pos;
+      }
+    }
+    uint8_t shuffle[256][16];
+    uint8_t length[256];
+  };
+
+  static const Tables& GetTables() {
+    static const Tables tables;
+    return tables;
+  }
+#endif
+};
+
+#endif  // COMMON_STREAM_VBYTE_H_
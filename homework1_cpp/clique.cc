@@ -1,6 +1,4 @@
 //! clang++ -std=c++14 -Wall -Wextra shortest.cc
-#include <sys/time.h>
-
 #include <cstdio>
 #include <fstream>
 #include <iomanip>
@@ -176,30 +174,6 @@ class Graph {
   std::vector<std::string> names_;
 };
 
-class Timer {
- public:
-  Timer(const std::string &tag) : tag_(tag) {
-    timeval tv;
-    gettimeofday(&tv, nullptr);
-    begin_ = tv.tv_sec + tv.tv_usec / 1E6;
-    std::cout << "==== Begin: " << tag_ << " ====" << std::endl;
-  }
-
-  ~Timer() {
-    timeval tv;
-    gettimeofday(&tv, nullptr);
-    double end = tv.tv_sec + tv.tv_usec / 1E6;
-
-    std::cout << "Elapsed: " << std::setprecision(3) << end - begin_ << " sec"
-              << std::endl;
-    std::cout << "==== End: " << tag_ << " ====" << std::endl;
-  }
-
- private:
-  double begin_;
-  std::string tag_;
-};
-
 int main() {
   auto graph = Graph::Create(NICKNAMES_TXT_PATH, LINKS_TXT_PATH);
   graph->PrintCliques();
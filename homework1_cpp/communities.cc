@@ -0,0 +1,112 @@
+//! clang++ -std=c++14 -O3 -Wall -Wextra -pthread communities.cc
+//
+// Finds communities of the SNS graph (or of pages.txt / links.txt) by label
+// propagation over the symmetrized links; see common/label_propagation.h.
+// Prints the largest communities and writes the community of every vertex
+// to out_communities.txt as "<id>\t<name>\t<community>".
+//
+// Usage: ./a.out [--max-rounds=N] [nicknames.txt links.txt]
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../common/csr_graph.h"
+#include "../common/instrumentation.h"
+#include "../common/label_propagation.h"
+#include "../common/parallel.h"
+
+const char* LINKS_TXT_PATH = "links.txt";
+const char* NICKNAMES_TXT_PATH = "nicknames.txt";
+const char* OUT_COMMUNITIES_TXT_PATH = "out_communities.txt";
+
+int main(int argc, char** argv) {
+  int max_rounds = 100;
+  const char* nicknames_path = NICKNAMES_TXT_PATH;
+  const char* links_path = LINKS_TXT_PATH;
+  std::vector<const char*> paths;
+  for (int i = 1; i < argc; i++) {
+    if (std::strncmp(argv[i], "--max-rounds=", 13) == 0)
+      max_rounds = std::max(1, std::atoi(argv[i] + 13));
+    else
+      paths.push_back(argv[i]);
+  }
+  if (paths.size() == 2) {
+    nicknames_path = paths[0];
+    links_path = paths[1];
+  }
+
+  std::unique_ptr<CsrGraph> graph;
+  std::vector<std::string> names;
+  {
+    ScopedTimer t("Create graph");
+    graph = LoadLinks(links_path);
+    if (!graph || !LoadNames(nicknames_path, &names))
+      return -1;
+    graph->EnsureVertexes(names.size());
+    std::cout << "num vertexes: " << graph->num_vertexes() << " "
+              << "num edges: " << graph->num_edges() << std::endl;
+  }
+
+  CsrGraph undirected;
+  {
+    ScopedTimer t("Symmetrize graph");
+    undirected = graph->Symmetrized();
+    graph.reset();
+    std::cout << "undirected edges: " << undirected.num_edges() / 2
+              << std::endl;
+  }
+
+  Communities communities;
+  {
+    ScopedTimer t("Label propagation");
+    communities = LabelPropagation(undirected).Run(max_rounds);
+    double sec = t.elapsed();
+    std::cout << "threads: " << NumThreads() << std::endl;
+    std::cout << "rounds: " << communities.rounds
+              << " updates: " << communities.updates << std::endl;
+    std::cout << "throughput: " << std::setprecision(3)
+              << (sec > 0 ? undirected.num_edges() * communities.updates /
+                                std::max<double>(1, undirected.num_vertexes()) /
+                                sec
+                          : 0)
+              << " edges/sec" << std::endl;
+  }
+
+  std::cout << "communities: " << communities.sizes.size()
+            << " modularity: " << std::setprecision(4)
+            << communities.modularity << std::endl;
+  // The highest degree member names each of the largest communities.
+  const size_t kTop = 10;
+  size_t top = std::min(kTop, communities.sizes.size());
+  std::vector<int> leader(top, -1);
+  for (int v = 0; v < undirected.num_vertexes(); v++) {
+    size_t c = communities.community[v];
+    if (c < top &&
+        (leader[c] < 0 || undirected.degree(v) > undirected.degree(leader[c])))
+      leader[c] = v;
+  }
+  std::cout << "Largest communities:" << std::endl;
+  for (size_t c = 0; c < top; c++) {
+    int v = leader[c];
+    std::cout << c << " size: " << communities.sizes[c] << " around: "
+              << (v < static_cast<int>(names.size()) ? names[v] : "?")
+              << std::endl;
+  }
+
+  std::ofstream out(OUT_COMMUNITIES_TXT_PATH);
+  if (out.fail()) {
+    std::cerr << "cannot open: " << OUT_COMMUNITIES_TXT_PATH << std::endl;
+    return -1;
+  }
+  for (int v = 0; v < undirected.num_vertexes(); v++) {
+    out << v << "\t" << (v < static_cast<int>(names.size()) ? names[v] : "?")
+        << "\t" << communities.community[v] << "\n";
+  }
+  return 0;
+}
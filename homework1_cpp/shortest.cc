@@ -1,6 +1,4 @@
 //! clang++ -std=c++14 -Wall -Wextra shortest.cc
-#include <sys/time.h>
-
 #include <cstdio>
 #include <fstream>
 #include <iomanip>
@@ -9,6 +7,8 @@
 #include <queue>
 #include <vector>
 
+#include "../common/instrumentation.h"
+
 const char* LINKS_TXT_PATH = "links.txt";
 const char* NICKNAMES_TXT_PATH = "nicknames.txt";
 
@@ -153,34 +153,10 @@ class Graph {
 };
 
 
-class Timer {
- public:
-  Timer(const std::string& tag) : tag_(tag) {
-    timeval tv;
-    gettimeofday(&tv, nullptr);
-    begin_ = tv.tv_sec + tv.tv_usec / 1E6;
-    std::cout << "==== Begin: " << tag_ << " ====" << std::endl;
-  }
-
-  ~Timer() {
-    timeval tv;
-    gettimeofday(&tv, nullptr);
-    double end = tv.tv_sec + tv.tv_usec / 1E6;
-
-    std::cout << "Elapsed: " << std::setprecision(3)
-              << end - begin_ << " sec" << std::endl;
-    std::cout << "==== End: " << tag_ << " ====" << std::endl;
-  }
-
- private:
-  double begin_;
-  std::string tag_;
-};
-
 int main() {
   std::unique_ptr<Graph> graph;
   {
-    Timer t("Create graph");
+    ScopedTimer t("Create graph");
     graph = Graph::Create(NICKNAMES_TXT_PATH, LINKS_TXT_PATH);
     if (!graph)
       return -1;
@@ -209,7 +185,7 @@ int main() {
       continue;
     }
 
-    Timer t("BFS");
+    ScopedTimer t("BFS");
     graph->PrintShortestPath(from, to);
   }
 
@@ -1,6 +1,4 @@
 //! clang++ -std=c++14 -Wall -Wextra start_with_a.cc
-#include <sys/time.h>
-
 #include <cstdio>
 #include <algorithm>
 #include <fstream>
@@ -8,36 +6,14 @@
 #include <iostream>
 #include <vector>
 
-constexpr char kNicknamesTextPath[] = "nicknames.txt";
-
-class Timer {
- public:
-  Timer(const std::string& tag) : tag_(tag) {
-    timeval tv;
-    gettimeofday(&tv, nullptr);
-    begin_ = tv.tv_sec + tv.tv_usec / 1E6;
-    std::cout << "==== Begin: " << tag_ << " ====" << std::endl;
-  }
-
-  ~Timer() {
-    timeval tv;
-    gettimeofday(&tv, nullptr);
-    double end = tv.tv_sec + tv.tv_usec / 1E6;
-
-    std::cout << "Elapsed: " << std::setprecision(3)
-              << end - begin_ << " sec" << std::endl;
-    std::cout << "==== End: " << tag_ << " ====" << std::endl;
-  }
+#include "../common/instrumentation.h"
 
- private:
-  double begin_;
-  std::string tag_;
-};
+constexpr char kNicknamesTextPath[] = "nicknames.txt";
 
 int main() {
   std::vector<std::string> nicknames;
   {
-    Timer t("Read nicknames");
+    ScopedTimer t("Read nicknames");
     std::fstream nickname_file(kNicknamesTextPath);
     if (nickname_file.fail()) {
       std::cerr << "file not found:" << kNicknamesTextPath << std::endl;
@@ -58,12 +34,12 @@ int main() {
   }
 
   {
-    Timer t("sort (while it's already sorted by nickname)");
+    ScopedTimer t("sort (while it's already sorted by nickname)");
     std::sort(nicknames.begin(), nicknames.end());
   }
 
   {
-    Timer t("print a-nicknames");
+    ScopedTimer t("print a-nicknames");
     for (auto iter = nicknames.begin(); (*iter)[0] == 'a'; ++iter) {
       std::cout << *iter << std::endl;
     }
@@ -0,0 +1,269 @@
+//! clang++ -std=c++14 -O3 -Wall -Wextra -pthread triangles.cc
+//
+// Counts triangles and local clustering coefficients of the SNS graph.
+//
+// The graph is symmetrized, then every undirected edge is oriented from the
+// lower-ranked to the higher-ranked endpoint where vertexes are ranked by
+// (degree, id). Each triangle is then found exactly once as the intersection
+// of two sorted out-lists, and no out-list is longer than sqrt(2m).
+//
+// Usage: ./a.out [--mutual] [nicknames.txt links.txt]
+//   --mutual: only count links that exist in both directions (friendships).
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include "../common/csr_graph.h"
+#include "../common/instrumentation.h"
+#include "../common/parallel.h"
+
+const char* LINKS_TXT_PATH = "links.txt";
+const char* NICKNAMES_TXT_PATH = "nicknames.txt";
+const char* OUT_TRIANGLES_TXT_PATH = "out_triangles.txt";
+
+// First element of the sorted range [b, b_end) that is not less than |x|,
+// found by exponential search from |b|: O(log d) where d is the distance to
+// the result, so a walk over sorted keys costs little per key.
+inline const int* Gallop(const int* b, const int* b_end, int x) {
+  const int* lo = b;
+  ptrdiff_t step = 1;
+  while (step < b_end - b && b[step] < x) {
+    lo = b + step;
+    step *= 2;
+  }
+  return std::lower_bound(lo, b + std::min(step, b_end - b), x);
+}
+
+// Counts |a| ∩ |b| for sorted ranges and calls |on_match| for every common
+// element. Falls back to galloping search when one side is much shorter,
+// which is the common case between a low-degree vertex and a hub.
+template <typename Fn>
+void IntersectSorted(const int* a, const int* a_end, const int* b,
+                     const int* b_end, Fn on_match) {
+  if ((a_end - a) * 32 < (b_end - b)) {
+    for (; a != a_end && b != b_end; ++a) {
+      b = Gallop(b, b_end, *a);
+      if (b != b_end && *b == *a)
+        on_match(*a);
+    }
+    return;
+  }
+  if ((b_end - b) * 32 < (a_end - a)) {
+    IntersectSorted(b, b_end, a, a_end, on_match);
+    return;
+  }
+  while (a != a_end && b != b_end) {
+    int x = *a, y = *b;
+    if (x == y)
+      on_match(x);
+    a += (x <= y);
+    b += (y <= x);
+  }
+}
+
+class TriangleCounter {
+ public:
+  // |graph| is the directed link graph. If |mutual_only| is true an
+  // undirected edge {u, v} exists only if both u->v and v->u exist.
+  TriangleCounter(const CsrGraph& graph, bool mutual_only) {
+    Build(graph, mutual_only);
+  }
+
+  int num_vertexes() const { return static_cast<int>(degrees_.size()); }
+  int64_t num_undirected_edges() const { return oriented_.num_edges(); }
+  int degree(int v) const { return degrees_[v]; }
+  uint64_t triangles(int v) const { return triangles_[v]; }
+  uint64_t total_triangles() const { return total_triangles_; }
+
+  // Local clustering coefficient of |v|: the fraction of pairs of neighbours
+  // that are connected with each other.
+  double ClusteringCoefficient(int v) const {
+    double d = degrees_[v];
+    if (d < 2)
+      return 0;
+    return 2.0 * triangles_[v] / (d * (d - 1));
+  }
+
+  double AverageClusteringCoefficient() const {
+    double sum = 0;
+    for (int v = 0; v < num_vertexes(); v++)
+      sum += ClusteringCoefficient(v);
+    return num_vertexes() ? sum / num_vertexes() : 0;
+  }
+
+  // 3 * triangles / connected triples.
+  double Transitivity() const {
+    double wedges = 0;
+    for (int d : degrees_)
+      wedges += 0.5 * d * (d - 1.0);
+    return wedges > 0 ? 3.0 * total_triangles_ / wedges : 0;
+  }
+
+  void Count() {
+    int n = num_vertexes();
+    std::vector<std::atomic<uint64_t>> counts(n);
+    std::vector<uint64_t> per_thread_total(NumThreads(), 0);
+    ParallelForWithThreadId(0, n, 64, [&](int tid, int64_t u) {
+      uint64_t local = 0;
+      const int* u_begin = oriented_.begin(u);
+      const int* u_end = oriented_.end(u);
+      for (const int* it = u_begin; it != u_end; ++it) {
+        int v = *it;
+        uint64_t uv = 0;
+        IntersectSorted(u_begin, u_end, oriented_.begin(v), oriented_.end(v),
+                        [&](int w) {
+                          uv++;
+                          counts[w].fetch_add(1, std::memory_order_relaxed);
+                        });
+        if (uv)
+          counts[v].fetch_add(uv, std::memory_order_relaxed);
+        local += uv;
+      }
+      if (local)
+        counts[u].fetch_add(local, std::memory_order_relaxed);
+      per_thread_total[tid] += local;
+    });
+
+    triangles_.resize(n);
+    for (int v = 0; v < n; v++)
+      triangles_[v] = counts[v].load(std::memory_order_relaxed);
+    total_triangles_ = 0;
+    for (uint64_t t : per_thread_total)
+      total_triangles_ += t;
+  }
+
+ private:
+  // The undirected graph of the links that exist in both directions.
+  static CsrGraph MutualLinks(const CsrGraph& graph) {
+    CsrGraph sorted = graph;
+    sorted.SortNeighbors();
+    std::vector<std::pair<int, int>> edges;
+    for (int u = 0; u < sorted.num_vertexes(); u++) {
+      for (const int* it = sorted.begin(u); it != sorted.end(u); ++it) {
+        int v = *it;
+        if (u == v || (it != sorted.begin(u) && it[-1] == v))
+          continue;
+        if (std::binary_search(sorted.begin(v), sorted.end(v), u))
+          edges.emplace_back(u, v);
+      }
+    }
+    return CsrGraph::FromEdges(sorted.num_vertexes(), edges);
+  }
+
+  void Build(const CsrGraph& graph, bool mutual_only) {
+    int n = graph.num_vertexes();
+    // Sorted neighbour lists without duplicates or self loops.
+    CsrGraph undirected =
+        mutual_only ? MutualLinks(graph) : graph.Symmetrized();
+    degrees_.resize(n);
+    for (int v = 0; v < n; v++)
+      degrees_[v] = undirected.degree(v);
+
+    // Orient every edge towards the endpoint with the higher (degree, id).
+    // The lists stay sorted as they are filtered in order.
+    auto lower = [this](int a, int b) {
+      return degrees_[a] < degrees_[b] || (degrees_[a] == degrees_[b] && a < b);
+    };
+    std::vector<std::pair<int, int>> edges;
+    edges.reserve(undirected.num_edges() / 2);
+    for (int u = 0; u < n; u++) {
+      for (const int* it = undirected.begin(u); it != undirected.end(u); ++it) {
+        if (lower(u, *it))
+          edges.emplace_back(u, *it);
+      }
+    }
+    undirected = CsrGraph();
+    oriented_ = CsrGraph::FromEdges(n, edges);
+  }
+
+  CsrGraph oriented_;
+  std::vector<int> degrees_;
+  std::vector<uint64_t> triangles_;
+  uint64_t total_triangles_ = 0;
+};
+
+int main(int argc, char** argv) {
+  bool mutual_only = false;
+  const char* nicknames_path = NICKNAMES_TXT_PATH;
+  const char* links_path = LINKS_TXT_PATH;
+  std::vector<const char*> paths;
+  for (int i = 1; i < argc; i++) {
+    if (std::strcmp(argv[i], "--mutual") == 0)
+      mutual_only = true;
+    else
+      paths.push_back(argv[i]);
+  }
+  if (paths.size() == 2) {
+    nicknames_path = paths[0];
+    links_path = paths[1];
+  }
+
+  std::unique_ptr<CsrGraph> graph;
+  std::vector<std::string> names;
+  {
+    ScopedTimer t("Create graph");
+    graph = LoadLinks(links_path);
+    if (!graph || !LoadNames(nicknames_path, &names))
+      return -1;
+    graph->EnsureVertexes(names.size());
+    std::cout << "num vertexes: " << graph->num_vertexes() << " "
+              << "num edges: " << graph->num_edges() << std::endl;
+  }
+
+  std::unique_ptr<TriangleCounter> counter;
+  {
+    ScopedTimer t("Orient graph");
+    counter = std::make_unique<TriangleCounter>(*graph, mutual_only);
+    std::cout << "undirected edges: " << counter->num_undirected_edges()
+              << std::endl;
+  }
+
+  {
+    ScopedTimer t("Count triangles");
+    counter->Count();
+    double sec = t.elapsed();
+    std::cout << "threads: " << NumThreads() << std::endl;
+    std::cout << "triangles: " << counter->total_triangles() << std::endl;
+    std::cout << "throughput: " << std::setprecision(3)
+              << (sec > 0 ? counter->num_undirected_edges() / sec : 0)
+              << " edges/sec" << std::endl;
+  }
+
+  std::cout << "average clustering coefficient: " << std::setprecision(4)
+            << counter->AverageClusteringCoefficient() << std::endl;
+  std::cout << "transitivity: " << counter->Transitivity() << std::endl;
+
+  std::vector<int> order(counter->num_vertexes());
+  for (size_t i = 0; i < order.size(); i++)
+    order[i] = i;
+  std::sort(order.begin(), order.end(), [&](int a, int b) {
+    return counter->triangles(a) > counter->triangles(b);
+  });
+  std::cout << "Top triangles:" << std::endl;
+  for (size_t i = 0; i < order.size() && i < 10; i++) {
+    int v = order[i];
+    std::cout << (v < static_cast<int>(names.size()) ? names[v] : "?")
+              << " triangles: " << counter->triangles(v)
+              << " clustering: " << counter->ClusteringCoefficient(v)
+              << std::endl;
+  }
+
+  std::ofstream out(OUT_TRIANGLES_TXT_PATH);
+  if (out.fail()) {
+    std::cerr << "cannot open: " << OUT_TRIANGLES_TXT_PATH << std::endl;
+    return -1;
+  }
+  for (int v = 0; v < counter->num_vertexes(); v++) {
+    out << v << "\t" << (v < static_cast<int>(names.size()) ? names[v] : "?")
+        << "\t" << counter->triangles(v) << "\t"
+        << counter->ClusteringCoefficient(v) << "\n";
+  }
+  return 0;
+}
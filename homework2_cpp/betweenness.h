@@ -0,0 +1,174 @@
+// Betweenness centrality of a directed, unweighted graph (Brandes, 2001).
+//
+// The betweenness of v is the sum over pairs (s, t), s != v != t, of the
+// fraction of the shortest s-t paths through v. A BFS from s counts the
+// shortest paths sigma[w] to every w, then the vertexes are revisited in
+// reverse BFS order to accumulate the dependencies
+//   delta[v] = sum over out-links v -> w with dist[w] = dist[v] + 1 of
+//              sigma[v] / sigma[w] * (1 + delta[w]),
+// and delta[v] is v's share of the paths from s. The successors are found
+// by rescanning the out-links, so no predecessor lists are kept.
+//
+// Sources are spread over NumThreads() threads; each thread owns its BFS
+// arrays (reset sparsely after each source) and a dependency accumulator of
+// one double per vertex, summed once at the end.
+//
+// Sample() runs the BFSs from k uniformly sampled sources instead and scales
+// by n / k (Brandes and Pich, 2007). delta_s(v) / (n - 2) lies in [0, 1], so
+// by Hoeffding's inequality and a union bound over the vertexes every
+// estimate is, with probability 1 - failure, within
+//   epsilon = sqrt(ln(2n / failure) / (2k))
+// of the exact value, both divided by n(n - 2).
+#ifndef HOMEWORK2_CPP_BETWEENNESS_H_
+#define HOMEWORK2_CPP_BETWEENNESS_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#include "../common/csr_graph.h"
+#include "../common/instrumentation.h"
+#include "../common/parallel.h"
+
+class Betweenness {
+ public:
+  struct Result {
+    std::vector<double> centrality;
+    int64_t num_sources = 0;
+    int64_t traversed_edges = 0;  // out-links scanned, both passes
+    // Bound on |estimate - exact| / (n(n - 2)) for every vertex, with
+    // probability 1 - failure; 0 when exact.
+    double epsilon = 0;
+  };
+
+  explicit Betweenness(const CsrGraph& graph) : graph_(graph) {}
+
+  Result Exact() const {
+    INSTRUMENT_SCOPE("Betweenness::Exact");
+    std::vector<int> sources(graph_.num_vertexes());
+    std::iota(sources.begin(), sources.end(), 0);
+    return Run(sources, 1.0);
+  }
+
+  // Estimate from |num_samples| distinct sources drawn with |seed|.
+  Result Sample(int64_t num_samples, uint64_t seed, double failure) const {
+    INSTRUMENT_SCOPE("Betweenness::Sample");
+    int n = graph_.num_vertexes();
+    if (num_samples >= n)
+      return Exact();
+    std::vector<int> sources(n);
+    std::iota(sources.begin(), sources.end(), 0);
+    std::mt19937_64 rng(seed);
+    // Partial Fisher-Yates shuffle.
+    for (int64_t i = 0; i < num_samples; i++) {
+      std::uniform_int_distribution<int> pick(i, n - 1);
+      std::swap(sources[i], sources[pick(rng)]);
+    }
+    sources.resize(num_samples);
+    Result result = Run(sources, static_cast<double>(n) / num_samples);
+    result.epsilon = Epsilon(n, num_samples, failure);
+    return result;
+  }
+
+  static double Epsilon(int n, int64_t num_samples, double failure) {
+    return std::sqrt(std::log(2.0 * n / failure) / (2.0 * num_samples));
+  }
+
+  // The number of samples for which Epsilon() is at most |epsilon|.
+  static int64_t SamplesFor(int n, double epsilon, double failure) {
+    return static_cast<int64_t>(
+        std::ceil(std::log(2.0 * n / failure) / (2.0 * epsilon * epsilon)));
+  }
+
+ private:
+  // Per-thread BFS state. dist is -1 and sigma, delta are 0 outside of the
+  // BFS in progress.
+  struct Workspace {
+    std::vector<int> dist;
+    std::vector<double> sigma;
+    std::vector<double> delta;
+    std::vector<int> order;
+    std::vector<double> centrality;
+    int64_t traversed_edges = 0;
+  };
+
+  Result Run(const std::vector<int>& sources, double scale) const {
+    int n = graph_.num_vertexes();
+    int num_threads = NumThreads();
+    std::vector<Workspace> workspaces(num_threads);
+    ParallelForWithThreadId(0, sources.size(), 1, [&](int tid, int64_t i) {
+      Workspace& ws = workspaces[tid];
+      if (ws.dist.empty()) {
+        ws.dist.assign(n, -1);
+        ws.sigma.assign(n, 0);
+        ws.delta.assign(n, 0);
+        ws.centrality.assign(n, 0);
+      }
+      Accumulate(sources[i], &ws);
+    });
+
+    Result result;
+    result.num_sources = sources.size();
+    result.centrality.assign(n, 0);
+    ParallelFor(0, n, 4096, [&](int64_t v) {
+      double sum = 0;
+      for (const Workspace& ws : workspaces) {
+        if (!ws.centrality.empty())
+          sum += ws.centrality[v];
+      }
+      result.centrality[v] = sum * scale;
+    });
+    for (const Workspace& ws : workspaces)
+      result.traversed_edges += ws.traversed_edges;
+    INSTRUMENT_COUNT("betweenness.edges", result.traversed_edges);
+    return result;
+  }
+
+  // Adds the dependencies of every vertex on |source| to ws->centrality.
+  void Accumulate(int source, Workspace* ws) const {
+    std::vector<int>& dist = ws->dist;
+    std::vector<double>& sigma = ws->sigma;
+    std::vector<double>& delta = ws->delta;
+    std::vector<int>& order = ws->order;
+    order.assign(1, source);
+    dist[source] = 0;
+    sigma[source] = 1;
+    for (size_t head = 0; head < order.size(); head++) {
+      int v = order[head];
+      ws->traversed_edges += graph_.degree(v);
+      for (const int* it = graph_.begin(v); it != graph_.end(v); ++it) {
+        int w = *it;
+        if (dist[w] < 0) {
+          dist[w] = dist[v] + 1;
+          order.push_back(w);
+        }
+        if (dist[w] == dist[v] + 1)
+          sigma[w] += sigma[v];
+      }
+    }
+    for (size_t i = order.size(); i-- > 1;) {
+      int v = order[i];
+      double sum = 0;
+      ws->traversed_edges += graph_.degree(v);
+      for (const int* it = graph_.begin(v); it != graph_.end(v); ++it) {
+        int w = *it;
+        if (dist[w] == dist[v] + 1)
+          sum += (1 + delta[w]) / sigma[w];
+      }
+      delta[v] = sigma[v] * sum;
+      ws->centrality[v] += delta[v];
+    }
+    for (int v : order) {
+      dist[v] = -1;
+      sigma[v] = 0;
+      delta[v] = 0;
+    }
+  }
+
+  const CsrGraph& graph_;
+};
+
+#endif  // HOMEWORK2_CPP_BETWEENNESS_H_
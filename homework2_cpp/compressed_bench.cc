@@ -0,0 +1,205 @@
+//! clang++ -std=c++14 -O3 -Wall -Wextra compressed_bench.cc
+//
+// Compares the plain CSR adjacency with the delta + varint and delta +
+// group varint encodings: bytes per edge against the time of a full
+// neighbour scan, BFS and push-style PageRank (common/graph_kernels.h) on
+// each representation.
+//
+// Usage: ./a.out [--order=none|degree|rcm|gorder] [--sources=8]
+//                [--iterations=10]
+//   Build with make SIMD=1 (or SIMD=native) to decode groups with pshufb.
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../common/compressed_graph.h"
+#include "../common/csr_graph.h"
+#include "../common/graph_kernels.h"
+#include "../common/instrumentation.h"
+#include "../common/vertex_order.h"
+
+const char* LINKS_TXT_PATH = "links.txt";
+
+// Gives the plain CSR graph the same interface as CompressedGraph.
+class CsrAdjacency {
+ public:
+  explicit CsrAdjacency(const CsrGraph& graph) : graph_(graph) {}
+
+  int num_vertexes() const { return graph_.num_vertexes(); }
+  int degree(int v) const { return graph_.degree(v); }
+  size_t memory_bytes() const {
+    return graph_.targets().size() * sizeof(int) +
+           graph_.offsets().size() * sizeof(int64_t);
+  }
+
+  template <typename Fn>
+  void ForEachNeighbor(int v, Fn fn) const {
+    graph_.ForEachNeighbor(v, fn);
+  }
+
+ private:
+  const CsrGraph& graph_;
+};
+
+template <typename Graph>
+uint64_t ScanAll(const Graph& graph) {
+  uint64_t checksum = 0;
+  for (int v = 0; v < graph.num_vertexes(); v++)
+    graph.ForEachNeighbor(v, [&](int w) { checksum += w ^ v; });
+  return checksum;
+}
+
+template <typename Graph>
+uint64_t BfsChecksum(const Graph& graph, const std::vector<int>& sources) {
+  std::vector<int> dist(graph.num_vertexes());
+  std::vector<int> queue;
+  uint64_t checksum = 0;
+  for (int source : sources) {
+    Bfs(graph, source, &dist, &queue);
+    for (int d : dist)
+      checksum += d;
+  }
+  return checksum;
+}
+
+template <typename Graph>
+double PageRankChecksum(const Graph& graph, int iterations) {
+  std::vector<double> rank;
+  PushPageRank(graph, iterations, &rank);
+  double checksum = 0;
+  for (size_t v = 0; v < rank.size(); v++)
+    checksum += rank[v] * (v % 7);
+  return checksum;
+}
+
+struct Result {
+  std::string name;
+  double bytes_per_edge;
+  double scan_sec;
+  double bfs_sec;
+  double pagerank_sec;
+  uint64_t scan_checksum;
+  uint64_t bfs_checksum;
+  double pagerank_checksum;
+};
+
+template <typename Graph>
+Result Measure(const std::string& name, const Graph& graph, int64_t num_edges,
+               const std::vector<int>& sources, int iterations) {
+  Result r;
+  r.name = name;
+  r.bytes_per_edge =
+      num_edges ? static_cast<double>(graph.memory_bytes()) / num_edges : 0;
+  {
+    ScopedTimer t("Scan: " + name);
+    r.scan_checksum = ScanAll(graph);
+    r.scan_sec = t.elapsed();
+  }
+  {
+    ScopedTimer t("BFS: " + name);
+    r.bfs_checksum = BfsChecksum(graph, sources);
+    r.bfs_sec = t.elapsed();
+  }
+  {
+    ScopedTimer t("PageRank: " + name);
+    r.pagerank_checksum = PageRankChecksum(graph, iterations);
+    r.pagerank_sec = t.elapsed();
+  }
+  return r;
+}
+
+int main(int argc, char** argv) {
+  VertexOrder order = VertexOrder::kOriginal;
+  int num_sources = 8;
+  int iterations = 10;
+  for (int i = 1; i < argc; i++) {
+    if (std::strncmp(argv[i], "--order=", 8) == 0 &&
+        ParseVertexOrder(argv[i] + 8, &order)) {
+      continue;
+    } else if (std::strncmp(argv[i], "--sources=", 10) == 0) {
+      num_sources = std::max(1, std::atoi(argv[i] + 10));
+    } else if (std::strncmp(argv[i], "--iterations=", 13) == 0) {
+      iterations = std::max(1, std::atoi(argv[i] + 13));
+    } else {
+      std::cerr << "unknown option: " << argv[i] << std::endl;
+      return -1;
+    }
+  }
+
+  std::unique_ptr<CsrGraph> graph;
+  {
+    ScopedTimer t("Create graph");
+    graph = LoadLinks(LINKS_TXT_PATH);
+    if (!graph || graph->num_vertexes() == 0)
+      return -1;
+    std::cout << "num vertexes: " << graph->num_vertexes() << " "
+              << "num edges: " << graph->num_edges() << std::endl;
+  }
+  if (order != VertexOrder::kOriginal) {
+    ScopedTimer t(std::string("Reorder vertexes: ") + VertexOrderName(order));
+    *graph = Relabel(*graph,
+                     ComputeVertexOrder(order, *graph, graph->Reversed()));
+  }
+  // Compressed lists are sorted; sort the plain one too so that BFS visits
+  // vertexes in the same order and the checksums can be compared.
+  graph->SortNeighbors();
+
+  std::mt19937 rng(12345);
+  std::uniform_int_distribution<int> pick(0, graph->num_vertexes() - 1);
+  std::vector<int> sources;
+  for (int i = 0; i < num_sources; i++)
+    sources.push_back(pick(rng));
+
+  std::vector<Result> results;
+  results.push_back(Measure("csr", CsrAdjacency(*graph), graph->num_edges(),
+                            sources, iterations));
+  for (auto encoding : {CompressedGraph::Encoding::kVarint,
+                        CompressedGraph::Encoding::kGroupVarint}) {
+    std::string name =
+        encoding == CompressedGraph::Encoding::kVarint ? "varint" : "group";
+    std::unique_ptr<CompressedGraph> compressed;
+    {
+      ScopedTimer t("Encode: " + name);
+      compressed = std::make_unique<CompressedGraph>(*graph, encoding);
+    }
+    results.push_back(Measure(name, *compressed, graph->num_edges(), sources,
+                              iterations));
+
+    // The cursor must agree with ForEachNeighbor().
+    uint64_t checksum = 0;
+    for (int v = 0; v < compressed->num_vertexes(); v++) {
+      for (CompressedGraph::NeighborCursor c(*compressed, v); !c.done();
+           c.Next())
+        checksum += c.value() ^ v;
+    }
+    if (checksum != results.back().scan_checksum)
+      std::cerr << name << ": cursor checksum mismatch" << std::endl;
+  }
+
+  const Result& base = results[0];
+  int64_t m = std::max<int64_t>(1, graph->num_edges());
+  std::cout << std::left << std::setw(8) << "format" << std::right
+            << std::setw(12) << "bytes/edge" << std::setw(12) << "scan ns/e"
+            << std::setw(10) << "bfs/csr" << std::setw(10) << "pr/csr"
+            << std::setw(10) << "ok" << std::endl;
+  std::cout << std::fixed << std::setprecision(3);
+  for (const Result& r : results) {
+    bool ok = r.scan_checksum == base.scan_checksum &&
+              r.bfs_checksum == base.bfs_checksum &&
+              r.pagerank_checksum == base.pagerank_checksum;
+    std::cout << std::left << std::setw(8) << r.name << std::right
+              << std::setw(12) << r.bytes_per_edge << std::setw(12)
+              << r.scan_sec * 1E9 / m << std::setw(10)
+              << (r.bfs_sec > 0 ? r.bfs_sec / base.bfs_sec : 0)
+              << std::setw(10)
+              << (r.pagerank_sec > 0 ? r.pagerank_sec / base.pagerank_sec : 0)
+              << std::setw(10) << (ok ? "yes" : "NO") << std::endl;
+  }
+  return 0;
+}
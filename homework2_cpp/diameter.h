@@ -0,0 +1,372 @@
+// Diameter, eccentricities and the hop-distance distribution of a directed
+// graph.
+//
+// ExactDiameter() runs DiFUB (Crescenzi et al., TCS 2013) on the strongly
+// connected component of the highest degree vertex u, where every distance
+// is finite. With F_i / B_i the vertexes i hops after / before u, a pair
+// more than 2(i - 1) hops apart must start in some B_j or end in some F_j
+// with j >= i, so the fringes are scanned from the outside in: the largest
+// forward eccentricity in B_i and backward eccentricity in F_i raise the
+// lower bound, and the upper bound drops to 2(i - 1) until they meet. Only
+// the fringe BFSs are needed, typically a few hundred instead of one per
+// vertex, and the BFSs of a fringe run in parallel.
+//
+// EstimateNeighbourhood() is HyperANF (Boldi et al., WWW 2011): every
+// vertex keeps a HyperLogLog counter of the vertexes it reaches within t
+// hops, and step t + 1 merges (register-wise max) the counters of its
+// out-neighbours into it. Summing the estimates gives N(t), the number of
+// pairs at most t hops apart, from which the distance distribution, the
+// average distance and the effective diameter follow. Per vertex, the step
+// at which its counter last grows and the growth at each step give rough
+// estimates of its eccentricity and distance sum, good enough to pick the
+// candidates for Eccentricities(), which is exact.
+#ifndef HOMEWORK2_CPP_DIAMETER_H_
+#define HOMEWORK2_CPP_DIAMETER_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "../common/csr_graph.h"
+#include "../common/graph_memory.h"
+#include "../common/hash.h"
+#include "../common/instrumentation.h"
+#include "../common/parallel.h"
+
+class DiameterEngine {
+ public:
+  struct ExactResult {
+    int diameter = 0;
+    int from = -1;  // a pair |diameter| hops apart
+    int to = -1;
+    int center = -1;  // u
+    int component_size = 0;
+    int64_t num_bfs = 0;
+  };
+
+  struct Neighbourhood {
+    // pairs[t]: estimated (source, target) pairs at most t hops apart,
+    // including the pairs (v, v).
+    std::vector<double> pairs;
+    double average_distance = 0;
+    // Distance below which |percentile| of the reachable pairs lie,
+    // interpolated between steps.
+    double effective_diameter = 0;
+    // Last step that grew each vertex's counter: a lower estimate of its
+    // forward eccentricity, as growth below the counter's resolution is
+    // missed.
+    std::vector<int> eccentricity;
+    // Estimated number of vertexes each vertex reaches (itself included),
+    // and the sum of the distances to them.
+    std::vector<float> reached;
+    std::vector<float> distance_sum;
+  };
+
+  explicit DiameterEngine(const CsrGraph& graph)
+      : graph_(graph), reversed_(graph.Reversed()) {}
+
+  // Vertexes of the strongly connected component of the highest degree
+  // vertex, which ExactDiameter() and Eccentricities() work inside. Found
+  // by the first call that needs it.
+  const std::vector<bool>& component() {
+    if (in_component_.empty()) {
+      std::vector<int> forward, backward;
+      FindComponent(&forward, &backward);
+    }
+    return in_component_;
+  }
+
+  ExactResult ExactDiameter() {
+    INSTRUMENT_SCOPE("DiameterEngine::ExactDiameter");
+    ExactResult result;
+    int n = graph_.num_vertexes();
+    if (n == 0)
+      return result;
+    std::vector<int> forward, backward;
+    int u = FindComponent(&forward, &backward);
+    result.center = u;
+    result.num_bfs += 2;
+    for (int v = 0; v < n; v++)
+      result.component_size += in_component_[v];
+    // Fringes by level, restricted to the component.
+    std::vector<std::vector<int>> forward_fringe, backward_fringe;
+    for (int v = 0; v < n; v++) {
+      if (!in_component_[v])
+        continue;
+      AddToLevel(&forward_fringe, forward[v], v);
+      AddToLevel(&backward_fringe, backward[v], v);
+    }
+    int forward_ecc = forward_fringe.size() - 1;
+    int backward_ecc = backward_fringe.size() - 1;
+    if (forward_ecc >= backward_ecc) {
+      result.diameter = forward_ecc;
+      result.from = u;
+      result.to = forward_fringe.back()[0];
+    } else {
+      result.diameter = backward_ecc;
+      result.from = backward_fringe.back()[0];
+      result.to = u;
+    }
+
+    int upper = 2 * std::max(forward_ecc, backward_ecc);
+    for (int i = std::max(forward_ecc, backward_ecc);
+         i > 0 && upper > result.diameter; i--) {
+      if (i <= backward_ecc) {
+        // Pairs starting i hops before u.
+        Farthest best = FarthestOf(graph_, backward_fringe[i]);
+        result.num_bfs += backward_fringe[i].size();
+        if (best.distance > result.diameter) {
+          result.diameter = best.distance;
+          result.from = best.source;
+          result.to = best.target;
+        }
+      }
+      if (i <= forward_ecc) {
+        // Pairs ending i hops after u, found backwards.
+        Farthest best = FarthestOf(reversed_, forward_fringe[i]);
+        result.num_bfs += forward_fringe[i].size();
+        if (best.distance > result.diameter) {
+          result.diameter = best.distance;
+          result.from = best.target;
+          result.to = best.source;
+        }
+      }
+      if (result.diameter > 2 * (i - 1))
+        break;
+      upper = 2 * (i - 1);
+    }
+    INSTRUMENT_COUNT("diameter.bfs", result.num_bfs);
+    return result;
+  }
+
+  // HyperANF with 2^|log2_registers| registers per counter (4 to 16; the
+  // relative error is about 1.04 / sqrt(2^log2_registers)) for at most
+  // |max_steps| steps.
+  Neighbourhood EstimateNeighbourhood(int log2_registers, double percentile,
+                                      int max_steps) {
+    INSTRUMENT_SCOPE("DiameterEngine::EstimateNeighbourhood");
+    Neighbourhood result;
+    int n = graph_.num_vertexes();
+    int b = std::max(4, std::min(16, log2_registers));
+    size_t m = size_t(1) << b;
+    GraphVector<uint8_t> current(n * m), next(n * m);
+    ParallelFor(0, n, 1024, [&](int64_t v) {
+      uint8_t* c = &current[v * m];
+      std::fill(c, c + m, 0);
+      uint64_t hash = SplitMix64(v);
+      int rank = hash << b ? __builtin_clzll(hash << b) + 1 : 64 - b + 1;
+      c[hash >> (64 - b)] = rank;
+    });
+    result.eccentricity.assign(n, 0);
+    result.distance_sum.assign(n, 0);
+    result.reached.assign(n, 0);
+    std::vector<float>& last_estimate = result.reached;
+
+    int num_threads = NumThreads();
+    std::vector<double> sums(num_threads);
+    // Sums go to a local per chunk of vertexes, so that threads do not
+    // share the cache line of sums[] on every vertex.
+    const int64_t kChunk = 1024;
+    int64_t num_chunks = (n + kChunk - 1) / kChunk;
+    auto estimate_all = [&](const GraphVector<uint8_t>& counters, int step) {
+      std::fill(sums.begin(), sums.end(), 0);
+      ParallelForWithThreadId(0, num_chunks, 1, [&](int tid, int64_t c) {
+        double local = 0;
+        for (int64_t v = c * kChunk;
+             v < std::min<int64_t>(n, (c + 1) * kChunk); v++) {
+          float estimate = Estimate(&counters[v * m], m);
+          if (estimate > last_estimate[v]) {
+            result.distance_sum[v] += step * (estimate - last_estimate[v]);
+            last_estimate[v] = estimate;
+          }
+          local += estimate;
+        }
+        sums[tid] += local;
+      });
+      double sum = 0;
+      for (double s : sums)
+        sum += s;
+      return sum;
+    };
+    result.pairs.push_back(estimate_all(current, 0));
+
+    for (int step = 1; step <= max_steps; step++) {
+      std::atomic<bool> changed(false);
+      ParallelFor(0, n, 256, [&](int64_t v) {
+        uint8_t* out = &next[v * m];
+        const uint8_t* own = &current[v * m];
+        std::copy(own, own + m, out);
+        for (const int* it = graph_.begin(v); it != graph_.end(v); ++it) {
+          const uint8_t* other = &current[static_cast<size_t>(*it) * m];
+          for (size_t j = 0; j < m; j++)
+            out[j] = std::max(out[j], other[j]);
+        }
+        if (!std::equal(out, out + m, own)) {
+          result.eccentricity[v] = step;
+          changed.store(true, std::memory_order_relaxed);
+        }
+      });
+      if (!changed)
+        break;
+      current.swap(next);
+      // The counters only grow, and so does N(t).
+      result.pairs.push_back(
+          std::max(result.pairs.back(), estimate_all(current, step)));
+    }
+
+    // Distance distribution over the pairs (v, w), v != w, that are
+    // connected.
+    double base = result.pairs[0];
+    double reachable = result.pairs.back() - base;
+    if (reachable > 0) {
+      double weighted = 0;
+      for (size_t t = 1; t < result.pairs.size(); t++)
+        weighted += t * (result.pairs[t] - result.pairs[t - 1]);
+      result.average_distance = weighted / reachable;
+      double goal = base + percentile * reachable;
+      for (size_t t = 1; t < result.pairs.size(); t++) {
+        if (result.pairs[t] >= goal) {
+          double step = result.pairs[t] - result.pairs[t - 1];
+          result.effective_diameter =
+              t - 1 + (step > 0 ? (goal - result.pairs[t - 1]) / step : 1);
+          break;
+        }
+      }
+    }
+    return result;
+  }
+
+  // Exact forward eccentricities of |sources| inside component(), one BFS
+  // per source spread over the threads.
+  std::vector<int> Eccentricities(const std::vector<int>& sources) {
+    component();
+    std::vector<int> result(sources.size());
+    ForEachBfs(graph_, sources, [&](int, int64_t i, int, int distance) {
+      result[i] = distance;
+    });
+    return result;
+  }
+
+ private:
+  struct Farthest {
+    int distance = -1;
+    int source = -1;
+    int target = -1;
+  };
+
+  // Sets in_component_ to the vertexes that the highest degree vertex
+  // reaches both ways and returns that vertex. Leaves the BFS distances
+  // from it in |forward| and |backward|.
+  int FindComponent(std::vector<int>* forward, std::vector<int>* backward) {
+    int n = graph_.num_vertexes();
+    int u = 0;
+    for (int v = 1; v < n; v++) {
+      if (graph_.degree(v) + reversed_.degree(v) >
+          graph_.degree(u) + reversed_.degree(u))
+        u = v;
+    }
+    in_component_.assign(n, true);
+    *forward = Distances(graph_, u);
+    *backward = Distances(reversed_, u);
+    for (int v = 0; v < n; v++)
+      in_component_[v] = (*forward)[v] >= 0 && (*backward)[v] >= 0;
+    return u;
+  }
+
+  static void AddToLevel(std::vector<std::vector<int>>* levels, int level,
+                         int v) {
+    if (static_cast<int>(levels->size()) <= level)
+      levels->resize(level + 1);
+    (*levels)[level].push_back(v);
+  }
+
+  // BFS distances from |source| inside the component (all vertexes before
+  // it is known); -1 where unreachable.
+  std::vector<int> Distances(const CsrGraph& graph, int source) const {
+    std::vector<int> dist(graph.num_vertexes(), -1);
+    std::vector<int> queue(1, source);
+    dist[source] = 0;
+    for (size_t head = 0; head < queue.size(); head++) {
+      int v = queue[head];
+      for (const int* it = graph.begin(v); it != graph.end(v); ++it) {
+        if (dist[*it] < 0 && in_component_[*it]) {
+          dist[*it] = dist[v] + 1;
+          queue.push_back(*it);
+        }
+      }
+    }
+    return dist;
+  }
+
+  // Runs a BFS along |graph| inside the component from every one of
+  // |sources|, spread over the threads, and calls |fn(thread id, i,
+  // farthest vertex, its distance)| for the i-th source.
+  template <typename Fn>
+  void ForEachBfs(const CsrGraph& graph, const std::vector<int>& sources,
+                  Fn fn) const {
+    int num_threads = NumThreads();
+    std::vector<std::vector<int>> dists(num_threads), queues(num_threads);
+    ParallelForWithThreadId(0, sources.size(), 1, [&](int tid, int64_t i) {
+      std::vector<int>& dist = dists[tid];
+      std::vector<int>& queue = queues[tid];
+      if (dist.empty())
+        dist.assign(graph.num_vertexes(), -1);
+      queue.assign(1, sources[i]);
+      dist[sources[i]] = 0;
+      for (size_t head = 0; head < queue.size(); head++) {
+        int v = queue[head];
+        for (const int* it = graph.begin(v); it != graph.end(v); ++it) {
+          if (dist[*it] < 0 && in_component_[*it]) {
+            dist[*it] = dist[v] + 1;
+            queue.push_back(*it);
+          }
+        }
+      }
+      fn(tid, i, queue.back(), dist[queue.back()]);
+      for (int v : queue)
+        dist[v] = -1;
+    });
+  }
+
+  // The largest eccentricity along |graph| among |sources|.
+  Farthest FarthestOf(const CsrGraph& graph,
+                      const std::vector<int>& sources) const {
+    std::vector<Farthest> best(NumThreads());
+    ForEachBfs(graph, sources,
+               [&](int tid, int64_t i, int farthest, int distance) {
+                 if (distance > best[tid].distance)
+                   best[tid] = Farthest{distance, sources[i], farthest};
+               });
+    Farthest result;
+    for (const Farthest& f : best) {
+      if (f.distance > result.distance)
+        result = f;
+    }
+    return result;
+  }
+
+  // HyperLogLog estimate with the small range correction.
+  static double Estimate(const uint8_t* registers, size_t m) {
+    double sum = 0;
+    int zeros = 0;
+    for (size_t j = 0; j < m; j++) {
+      sum += std::ldexp(1.0, -registers[j]);
+      zeros += registers[j] == 0;
+    }
+    double alpha = m == 16 ? 0.673 : m == 32 ? 0.697 : m == 64 ? 0.709
+                 : 0.7213 / (1 + 1.079 / m);
+    double estimate = alpha * m * m / sum;
+    if (estimate <= 2.5 * m && zeros > 0)
+      estimate = m * std::log(static_cast<double>(m) / zeros);
+    return estimate;
+  }
+
+  const CsrGraph& graph_;
+  CsrGraph reversed_;
+  std::vector<bool> in_component_;
+};
+
+#endif  // HOMEWORK2_CPP_DIAMETER_H_
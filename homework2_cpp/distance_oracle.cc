@@ -0,0 +1,545 @@
+//! clang++ -std=c++14 -O3 -Wall -Wextra -pthread distance_oracle.cc
+//
+// Landmark based distance oracle for "degrees of separation" queries.
+//
+// K landmark vertexes are chosen offline (highest degree or highest
+// PageRank) and the BFS distances from and to every landmark are stored as
+// uint8 arrays. A query (s, t) is then answered from the triangle inequality
+// in O(K):
+//
+//   d(s, t) <= d(s, L) + d(L, t)
+//   d(s, t) >= d(L, t) - d(L, s)
+//   d(s, t) >= d(s, L) - d(t, L)
+//
+// The same lower bounds are used as the heuristic of an A* search (ALT) to
+// get the exact distance and path when the bounds do not meet.
+//
+// The oracle is saved next to links.txt as links.txt.oracle and reused on
+// the next run, unless links.txt or the landmark options have changed.
+//
+// Usage: ./a.out [--landmarks=K] [--pagerank] [--rebuild] [--bench=N]
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../common/csr_graph.h"
+#include "../common/instrumentation.h"
+#include "../common/parallel.h"
+
+const char* LINKS_TXT_PATH = "links.txt";
+const char* PAGES_TXT_PATH = "pages.txt";
+const char* ORACLE_SUFFIX = ".oracle";
+
+class DistanceOracle {
+ public:
+  // Distances are saturated to 254 hops and such cells are ignored by the
+  // bounds; 255 means "unreachable".
+  static constexpr uint8_t kSaturated = 254;
+  static constexpr uint8_t kUnreachable = 255;
+  static constexpr int kInfinity = 1 << 29;
+
+  struct Bounds {
+    int lower;
+    int upper;  // kInfinity if no landmark connects the pair.
+  };
+
+  // Chooses the |num_landmarks| vertexes with the highest |score| and runs a
+  // forward and a backward BFS from each of them.
+  static std::unique_ptr<DistanceOracle> Build(const CsrGraph& graph,
+                                               const CsrGraph& reversed,
+                                               const std::vector<double>& score,
+                                               int num_landmarks) {
+    int n = graph.num_vertexes();
+    std::unique_ptr<DistanceOracle> oracle(new DistanceOracle());
+    num_landmarks = std::min(num_landmarks, n);
+    std::vector<int> order(n);
+    for (int v = 0; v < n; v++)
+      order[v] = v;
+    std::partial_sort(order.begin(), order.begin() + num_landmarks, order.end(),
+                      [&](int a, int b) { return score[a] > score[b]; });
+    oracle->num_vertexes_ = n;
+    oracle->landmarks_.assign(order.begin(), order.begin() + num_landmarks);
+
+    // One BFS per (landmark, direction), each into its own column, then the
+    // columns are transposed into the vertex-major tables.
+    std::vector<std::vector<uint8_t>> columns(2 * num_landmarks);
+    ParallelFor(0, 2 * num_landmarks, 1, [&](int64_t task) {
+      int l = static_cast<int>(task / 2);
+      columns[task] = BfsColumn(task % 2 == 0 ? graph : reversed,
+                                oracle->landmarks_[l]);
+    });
+    oracle->from_landmark_.resize(static_cast<size_t>(n) * num_landmarks);
+    oracle->to_landmark_.resize(static_cast<size_t>(n) * num_landmarks);
+    ParallelFor(0, n, 4096, [&](int64_t v) {
+      for (int l = 0; l < num_landmarks; l++) {
+        size_t cell = static_cast<size_t>(v) * num_landmarks + l;
+        oracle->from_landmark_[cell] = columns[2 * l][v];
+        oracle->to_landmark_[cell] = columns[2 * l + 1][v];
+      }
+    });
+    return oracle;
+  }
+
+  int num_vertexes() const { return num_vertexes_; }
+  int num_landmarks() const { return static_cast<int>(landmarks_.size()); }
+  const std::vector<int>& landmarks() const { return landmarks_; }
+  size_t memory_bytes() const {
+    return from_landmark_.size() + to_landmark_.size() +
+           landmarks_.size() * sizeof(int);
+  }
+
+  // Upper and lower bounds of the hop distance from |s| to |t|.
+  Bounds Query(int s, int t) const {
+    if (s == t)
+      return {0, 0};
+    Bounds b = {1, kInfinity};
+    int k = num_landmarks();
+    const uint8_t* s_to = &to_landmark_[static_cast<size_t>(s) * k];
+    const uint8_t* s_from = &from_landmark_[static_cast<size_t>(s) * k];
+    const uint8_t* t_to = &to_landmark_[static_cast<size_t>(t) * k];
+    const uint8_t* t_from = &from_landmark_[static_cast<size_t>(t) * k];
+    for (int l = 0; l < k; l++) {
+      // L reaches s but not t, or t reaches L but s does not: then s cannot
+      // reach t at all.
+      if ((s_from[l] != kUnreachable && t_from[l] == kUnreachable) ||
+          (s_to[l] == kUnreachable && t_to[l] != kUnreachable)) {
+        return {kInfinity, kInfinity};
+      }
+      if (s_to[l] < kSaturated && t_from[l] < kSaturated)
+        b.upper = std::min(b.upper, s_to[l] + t_from[l]);
+      if (t_from[l] < kSaturated && s_from[l] < kSaturated)
+        b.lower = std::max(b.lower, t_from[l] - s_from[l]);
+      if (s_to[l] < kSaturated && t_to[l] < kSaturated)
+        b.lower = std::max(b.lower, s_to[l] - t_to[l]);
+    }
+    return b;
+  }
+
+  // Lower bound of d(v, t), used as the A* heuristic. Always consistent.
+  // kInfinity if |v| provably cannot reach |t|.
+  int LowerBound(int v, int t) const { return Query(v, t).lower; }
+
+  // What an oracle file was built from. Load() only accepts a file whose
+  // header equals the expected one.
+  struct Header {
+    int32_t magic;
+    int32_t num_vertexes;
+    int32_t num_landmarks;
+    int32_t use_pagerank;  // landmark selection: 0 degree, 1 PageRank
+    int64_t num_edges;
+    FileStamp links;  // of links.txt
+  };
+
+  static Header MakeHeader(const CsrGraph& graph, int num_landmarks,
+                           bool use_pagerank, const char* links_path) {
+    return Header{kMagic,
+                  graph.num_vertexes(),
+                  std::min(num_landmarks, graph.num_vertexes()),
+                  use_pagerank,
+                  graph.num_edges(),
+                  StampOf(links_path)};
+  }
+
+  bool Save(const std::string& path, const Header& header) const {
+    std::ofstream out(path, std::ios::binary);
+    if (out.fail()) {
+      std::cerr << "cannot open: " << path << std::endl;
+      return false;
+    }
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(landmarks_.data()),
+              landmarks_.size() * sizeof(int));
+    out.write(reinterpret_cast<const char*>(from_landmark_.data()),
+              from_landmark_.size());
+    out.write(reinterpret_cast<const char*>(to_landmark_.data()),
+              to_landmark_.size());
+    out.close();
+    if (out.fail()) {
+      std::cerr << "cannot write: " << path << std::endl;
+      std::remove(path.c_str());
+      return false;
+    }
+    return true;
+  }
+
+  // Returns nullptr if the file is missing or its header differs from
+  // |expected|, i.e. it was built from other links or with other options.
+  static std::unique_ptr<DistanceOracle> Load(const std::string& path,
+                                              const Header& expected) {
+    std::ifstream in(path, std::ios::binary);
+    if (in.fail())
+      return nullptr;
+    Header header;
+    in.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (in.fail() || header.magic != expected.magic ||
+        header.num_vertexes != expected.num_vertexes ||
+        header.num_landmarks != expected.num_landmarks ||
+        header.use_pagerank != expected.use_pagerank ||
+        header.num_edges != expected.num_edges ||
+        header.links != expected.links || header.num_landmarks <= 0) {
+      std::cerr << "stale " << path << ", rebuilding" << std::endl;
+      return nullptr;
+    }
+    std::unique_ptr<DistanceOracle> oracle(new DistanceOracle());
+    size_t cells = static_cast<size_t>(header.num_vertexes) *
+                   header.num_landmarks;
+    oracle->num_vertexes_ = header.num_vertexes;
+    oracle->landmarks_.resize(header.num_landmarks);
+    oracle->from_landmark_.resize(cells);
+    oracle->to_landmark_.resize(cells);
+    in.read(reinterpret_cast<char*>(oracle->landmarks_.data()),
+            oracle->landmarks_.size() * sizeof(int));
+    in.read(reinterpret_cast<char*>(oracle->from_landmark_.data()), cells);
+    in.read(reinterpret_cast<char*>(oracle->to_landmark_.data()), cells);
+    if (in.fail())
+      return nullptr;
+    return oracle;
+  }
+
+ private:
+  static constexpr int32_t kMagic = 0x324b4d4c;  // "LMK2"
+
+  DistanceOracle() {}
+
+  // Saturated BFS distances from |root| over |graph|.
+  static std::vector<uint8_t> BfsColumn(const CsrGraph& graph, int root) {
+    std::vector<uint8_t> column(graph.num_vertexes(), kUnreachable);
+    std::vector<int> frontier = {root};
+    std::vector<int> next;
+    column[root] = 0;
+    for (int depth = 1; !frontier.empty(); depth++) {
+      uint8_t d = static_cast<uint8_t>(std::min<int>(depth, kSaturated));
+      next.clear();
+      for (int v : frontier) {
+        for (const int* it = graph.begin(v); it != graph.end(v); ++it) {
+          uint8_t& cell = column[*it];
+          if (cell == kUnreachable) {
+            cell = d;
+            next.push_back(*it);
+          }
+        }
+      }
+      frontier.swap(next);
+    }
+    return column;
+  }
+
+  int num_vertexes_ = 0;
+  std::vector<int> landmarks_;
+  // Vertex-major: [v * K + l] so that a query reads two contiguous rows.
+  std::vector<uint8_t> from_landmark_;  // d(landmark, v)
+  std::vector<uint8_t> to_landmark_;    // d(v, landmark)
+};
+
+constexpr uint8_t DistanceOracle::kSaturated;
+constexpr uint8_t DistanceOracle::kUnreachable;
+constexpr int DistanceOracle::kInfinity;
+constexpr int32_t DistanceOracle::kMagic;
+
+// A* search guided by the landmark lower bounds. Scratch arrays are kept
+// between queries and reset lazily with a generation counter.
+class AltSearch {
+ public:
+  AltSearch(const CsrGraph& graph, const DistanceOracle& oracle)
+      : graph_(graph), oracle_(oracle), dist_(graph.num_vertexes()),
+        parent_(graph.num_vertexes()), stamp_(graph.num_vertexes(), 0) {}
+
+  // Returns the shortest path from |from| to |to| or an empty vector.
+  std::vector<int> FindPath(int from, int to) {
+    scanned_ = 0;
+    if (++generation_ == 0) {
+      std::fill(stamp_.begin(), stamp_.end(), 0);
+      generation_ = 1;
+    }
+    DistanceOracle::Bounds bounds = oracle_.Query(from, to);
+    if (bounds.lower >= DistanceOracle::kInfinity)
+      return std::vector<int>();
+
+    // Unit weights: a bucket queue indexed by f = g + h.
+    buckets_.clear();
+    Visit(from, 0, -1);
+    Push(from, oracle_.LowerBound(from, to));
+    for (size_t f = 0; f < buckets_.size(); f++) {
+      for (size_t i = 0; i < buckets_[f].size(); i++) {
+        int v = buckets_[f][i].first;
+        int g = buckets_[f][i].second;
+        if (g != dist_[v])
+          continue;  // stale entry
+        if (v == to)
+          return BuildPath(to);
+        for (const int* it = graph_.begin(v); it != graph_.end(v); ++it) {
+          scanned_++;
+          int w = *it;
+          if (stamp_[w] == generation_ && dist_[w] <= g + 1)
+            continue;
+          int h = oracle_.LowerBound(w, to);
+          if (h >= DistanceOracle::kInfinity)
+            continue;  // |w| cannot reach |to|
+          Visit(w, g + 1, v);
+          Push(w, g + 1 + h);
+        }
+      }
+    }
+    return std::vector<int>();
+  }
+
+  int64_t scanned_edges() const { return scanned_; }
+
+ private:
+  void Visit(int v, int dist, int parent) {
+    stamp_[v] = generation_;
+    dist_[v] = dist;
+    parent_[v] = parent;
+  }
+
+  void Push(int v, int f) {
+    if (static_cast<int>(buckets_.size()) <= f)
+      buckets_.resize(f + 1);
+    buckets_[f].emplace_back(v, dist_[v]);
+  }
+
+  std::vector<int> BuildPath(int to) const {
+    std::vector<int> path;
+    for (int v = to; v != -1; v = parent_[v])
+      path.push_back(v);
+    std::reverse(path.begin(), path.end());
+    return path;
+  }
+
+  const CsrGraph& graph_;
+  const DistanceOracle& oracle_;
+  std::vector<int> dist_;
+  std::vector<int> parent_;
+  std::vector<uint32_t> stamp_;
+  uint32_t generation_ = 0;
+  std::vector<std::vector<std::pair<int, int>>> buckets_;
+  int64_t scanned_ = 0;
+};
+
+// Plain BFS distance, used to measure the oracle against.
+int BfsDistance(const CsrGraph& graph, int from, int to) {
+  std::vector<int> dist(graph.num_vertexes(), -1);
+  std::vector<int> queue = {from};
+  dist[from] = 0;
+  for (size_t head = 0; head < queue.size(); head++) {
+    int v = queue[head];
+    if (v == to)
+      return dist[v];
+    for (const int* it = graph.begin(v); it != graph.end(v); ++it) {
+      if (dist[*it] < 0) {
+        dist[*it] = dist[v] + 1;
+        queue.push_back(*it);
+      }
+    }
+  }
+  return -1;
+}
+
+std::vector<double> PageRankScores(const CsrGraph& graph, int iterations) {
+  int n = graph.num_vertexes();
+  std::vector<double> rank(n, 1.0 / n), next(n);
+  for (int i = 0; i < iterations; i++) {
+    double dangling = 0;
+    std::fill(next.begin(), next.end(), 0);
+    for (int v = 0; v < n; v++) {
+      if (graph.degree(v) == 0) {
+        dangling += rank[v];
+        continue;
+      }
+      double out = rank[v] / graph.degree(v);
+      for (const int* it = graph.begin(v); it != graph.end(v); ++it)
+        next[*it] += out;
+    }
+    for (int v = 0; v < n; v++)
+      next[v] = 0.15 / n + 0.85 * (next[v] + dangling / n);
+    rank.swap(next);
+  }
+  return rank;
+}
+
+void PrintPath(const std::vector<std::string>& names,
+               const std::vector<int>& path) {
+  std::cout << "Path: {";
+  bool is_first = true;
+  for (int v : path) {
+    std::cout << (is_first ? "" : ", ") << names[v];
+    is_first = false;
+  }
+  std::cout << "}" << std::endl;
+}
+
+void RunBenchmark(const CsrGraph& graph, const DistanceOracle& oracle,
+                  AltSearch* alt, int num_queries) {
+  std::mt19937 rng(12345);
+  std::uniform_int_distribution<int> pick(0, graph.num_vertexes() - 1);
+  std::vector<std::pair<int, int>> queries;
+  for (int i = 0; i < num_queries; i++)
+    queries.emplace_back(pick(rng), pick(rng));
+
+  int exact_from_bounds = 0;
+  int64_t bound_gap = 0;
+  int64_t alt_scanned = 0;
+  double bounds_sec, alt_sec, bfs_sec;
+  {
+    ScopedTimer t("Landmark bounds");
+    for (const auto& q : queries) {
+      DistanceOracle::Bounds b = oracle.Query(q.first, q.second);
+      if (b.lower == b.upper)
+        exact_from_bounds++;
+      else if (b.upper < DistanceOracle::kInfinity)
+        bound_gap += b.upper - b.lower;
+    }
+    bounds_sec = t.elapsed();
+  }
+  std::vector<int> alt_dist;
+  {
+    ScopedTimer t("ALT search");
+    for (const auto& q : queries) {
+      alt_dist.push_back(
+          static_cast<int>(alt->FindPath(q.first, q.second).size()) - 1);
+      alt_scanned += alt->scanned_edges();
+    }
+    alt_sec = t.elapsed();
+  }
+  int mismatches = 0;
+  {
+    ScopedTimer t("BFS");
+    for (size_t i = 0; i < queries.size(); i++) {
+      if (BfsDistance(graph, queries[i].first, queries[i].second) !=
+          alt_dist[i])
+        mismatches++;
+    }
+    bfs_sec = t.elapsed();
+  }
+  std::cout << "queries: " << num_queries << std::endl;
+  std::cout << "bounds: " << std::setprecision(3)
+            << bounds_sec * 1E6 / num_queries << " usec/query, "
+            << "exact: " << exact_from_bounds << ", avg gap: "
+            << (num_queries > exact_from_bounds
+                    ? static_cast<double>(bound_gap) /
+                          (num_queries - exact_from_bounds)
+                    : 0)
+            << std::endl;
+  std::cout << "ALT: " << alt_sec * 1E6 / num_queries << " usec/query, "
+            << "scanned edges/query: " << alt_scanned / num_queries
+            << std::endl;
+  std::cout << "BFS: " << bfs_sec * 1E6 / num_queries << " usec/query"
+            << std::endl;
+  std::cout << "ALT mismatches against BFS: " << mismatches << std::endl;
+}
+
+int main(int argc, char** argv) {
+  int num_landmarks = 16;
+  bool use_pagerank = false;
+  bool rebuild = false;
+  int bench_queries = 0;
+  for (int i = 1; i < argc; i++) {
+    if (std::strncmp(argv[i], "--landmarks=", 12) == 0) {
+      num_landmarks = std::max(1, std::atoi(argv[i] + 12));
+    } else if (std::strcmp(argv[i], "--pagerank") == 0) {
+      use_pagerank = true;
+    } else if (std::strcmp(argv[i], "--rebuild") == 0) {
+      rebuild = true;
+    } else if (std::strncmp(argv[i], "--bench=", 8) == 0) {
+      bench_queries = std::atoi(argv[i] + 8);
+    } else {
+      std::cerr << "unknown option: " << argv[i] << std::endl;
+      return -1;
+    }
+  }
+
+  std::unique_ptr<CsrGraph> graph;
+  std::vector<std::string> names;
+  {
+    ScopedTimer t("Create graph");
+    graph = LoadLinks(LINKS_TXT_PATH);
+    if (!graph || !LoadNames(PAGES_TXT_PATH, &names))
+      return -1;
+    graph->EnsureVertexes(names.size());
+    names.resize(graph->num_vertexes());
+    std::cout << "num vertexes: " << graph->num_vertexes() << " "
+              << "num edges: " << graph->num_edges() << std::endl;
+  }
+  CsrGraph reversed = graph->Reversed();
+
+  std::string oracle_path = std::string(LINKS_TXT_PATH) + ORACLE_SUFFIX;
+  DistanceOracle::Header header = DistanceOracle::MakeHeader(
+      *graph, num_landmarks, use_pagerank, LINKS_TXT_PATH);
+  std::unique_ptr<DistanceOracle> oracle;
+  if (!rebuild)
+    oracle = DistanceOracle::Load(oracle_path, header);
+  if (oracle) {
+    std::cout << "loaded " << oracle_path << std::endl;
+  } else {
+    ScopedTimer t("Build oracle");
+    std::vector<double> score(graph->num_vertexes());
+    if (use_pagerank) {
+      score = PageRankScores(*graph, 20);
+    } else {
+      for (int v = 0; v < graph->num_vertexes(); v++)
+        score[v] = graph->degree(v) + reversed.degree(v);
+    }
+    oracle = DistanceOracle::Build(*graph, reversed, score, num_landmarks);
+    if (!oracle->Save(oracle_path, header))
+      return -1;
+  }
+  std::cout << "landmarks: " << oracle->num_landmarks() << " memory: "
+            << oracle->memory_bytes() / 1024.0 / 1024.0 << " MB" << std::endl;
+
+  AltSearch alt(*graph, *oracle);
+  if (bench_queries > 0) {
+    RunBenchmark(*graph, *oracle, &alt, bench_queries);
+    return 0;
+  }
+
+  while (true) {
+    int from, to;
+    std::cout << "Type the source's id: ";
+    std::cin >> from;
+    std::cout << "Type the destination's id: ";
+    std::cin >> to;
+    if (std::cin.eof())
+      break;
+    if (from < 0 || graph->num_vertexes() <= from) {
+      std::cout << "out of range (source)" << std::endl;
+      continue;
+    }
+    if (to < 0 || graph->num_vertexes() <= to) {
+      std::cout << "out of range (to)" << std::endl;
+      continue;
+    }
+
+    std::cout << "From: " << names[from] << ", To: " << names[to] << std::endl;
+    {
+      ScopedTimer t("Landmark bounds");
+      DistanceOracle::Bounds b = oracle->Query(from, to);
+      if (b.lower >= DistanceOracle::kInfinity)
+        std::cout << "unreachable" << std::endl;
+      else
+        std::cout << b.lower << " <= steps <= "
+                  << (b.upper >= DistanceOracle::kInfinity
+                          ? std::string("inf")
+                          : std::to_string(b.upper))
+                  << std::endl;
+    }
+    {
+      ScopedTimer t("ALT search");
+      auto path = alt.FindPath(from, to);
+      if (path.empty()) {
+        std::cout << "Path was not found" << std::endl;
+        continue;
+      }
+      std::cout << path.size() - 1 << " steps" << std::endl;
+      PrintPath(names, path);
+    }
+  }
+  return 0;
+}
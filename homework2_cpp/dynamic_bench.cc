@@ -0,0 +1,186 @@
+//! clang++ -std=c++14 -O3 -Wall -Wextra -pthread dynamic_bench.cc
+//
+// Replays links.txt as a link feed into a DynamicGraph: a share of the
+// links forms the initial graph, and a writer thread inserts the rest in
+// batches mixed with deletions of random existing links. Reader threads
+// meanwhile run BFS and PageRank on snapshots and check that every
+// snapshot is consistent (its degrees add up to its edge count). At the
+// end the graph is compared against the feed replayed into a plain set.
+//
+// Usage: ./a.out [--initial=0.5] [--batch=1000] [--delete=0.1]
+//                [--readers=2] [--iterations=10] [--compact-ratio=0.25]
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <set>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "../common/csr_graph.h"
+#include "../common/dynamic_graph.h"
+#include "../common/graph_kernels.h"
+#include "../common/instrumentation.h"
+
+const char* LINKS_TXT_PATH = "links.txt";
+
+int main(int argc, char** argv) {
+  double initial = 0.5;
+  int batch_size = 1000;
+  double delete_ratio = 0.1;
+  int num_readers = 2;
+  int iterations = 10;
+  DynamicGraph::Options options;
+  for (int i = 1; i < argc; i++) {
+    if (std::strncmp(argv[i], "--initial=", 10) == 0) {
+      initial = std::min(1.0, std::max(0.0, std::atof(argv[i] + 10)));
+    } else if (std::strncmp(argv[i], "--batch=", 8) == 0) {
+      batch_size = std::max(1, std::atoi(argv[i] + 8));
+    } else if (std::strncmp(argv[i], "--delete=", 9) == 0) {
+      delete_ratio = std::min(0.9, std::max(0.0, std::atof(argv[i] + 9)));
+    } else if (std::strncmp(argv[i], "--readers=", 10) == 0) {
+      num_readers = std::max(0, std::atoi(argv[i] + 10));
+    } else if (std::strncmp(argv[i], "--iterations=", 13) == 0) {
+      iterations = std::max(1, std::atoi(argv[i] + 13));
+    } else if (std::strncmp(argv[i], "--compact-ratio=", 16) == 0) {
+      options.compact_ratio = std::atof(argv[i] + 16);
+    } else {
+      std::cerr << "unknown option: " << argv[i] << std::endl;
+      return -1;
+    }
+  }
+
+  std::unique_ptr<CsrGraph> links;
+  {
+    ScopedTimer t("Create graph");
+    links = LoadLinks(LINKS_TXT_PATH);
+    if (!links || links->num_vertexes() == 0)
+      return -1;
+    std::cout << "num vertexes: " << links->num_vertexes() << " "
+              << "num edges: " << links->num_edges() << std::endl;
+  }
+
+  std::vector<std::pair<int, int>> feed;
+  for (int v = 0; v < links->num_vertexes(); v++) {
+    for (const int* it = links->begin(v); it != links->end(v); ++it)
+      feed.emplace_back(v, *it);
+  }
+  std::mt19937 rng(12345);
+  std::shuffle(feed.begin(), feed.end(), rng);
+  size_t num_initial = static_cast<size_t>(feed.size() * initial);
+  std::vector<std::pair<int, int>> base_edges(feed.begin(),
+                                              feed.begin() + num_initial);
+  // Vertex ids only grow as links arrive.
+  int base_vertexes = 0;
+  for (const auto& e : base_edges)
+    base_vertexes = std::max(base_vertexes, std::max(e.first, e.second) + 1);
+  std::unique_ptr<DynamicGraph> graph;
+  {
+    ScopedTimer t("Create dynamic graph");
+    graph = std::make_unique<DynamicGraph>(
+        CsrGraph::FromEdges(base_vertexes, base_edges), options);
+  }
+
+  // The expected state, kept by the writer.
+  std::set<std::pair<int, int>> expected(base_edges.begin(), base_edges.end());
+  std::vector<std::pair<int, int>> live(expected.begin(), expected.end());
+
+  std::atomic<bool> done(false);
+  std::atomic<int64_t> bfs_runs(0), pagerank_runs(0), inconsistent(0);
+  std::vector<std::thread> readers;
+  for (int r = 0; r < num_readers; r++) {
+    readers.emplace_back([&, r] {
+      std::mt19937 reader_rng(r);
+      std::vector<int> dist, queue;
+      std::vector<double> rank;
+      for (int run = 0; !done.load(std::memory_order_relaxed); run++) {
+        DynamicGraph::Snapshot snapshot = graph->snapshot();
+        if (snapshot.num_vertexes() == 0) {
+          std::this_thread::yield();
+          continue;
+        }
+        int64_t edges = 0;
+        for (int v = 0; v < snapshot.num_vertexes(); v++)
+          edges += snapshot.degree(v);
+        if (edges != snapshot.num_edges())
+          inconsistent++;
+        if (run % 2 == 0) {
+          std::uniform_int_distribution<int> pick(
+              0, snapshot.num_vertexes() - 1);
+          dist.resize(snapshot.num_vertexes());
+          Bfs(snapshot, pick(reader_rng), &dist, &queue);
+          bfs_runs++;
+        } else {
+          // The rank sum stays 1 on a consistent graph.
+          PushPageRank(snapshot, iterations, &rank);
+          double sum = 0;
+          for (double x : rank)
+            sum += x;
+          if (sum < 0.999 || sum > 1.001)
+            inconsistent++;
+          pagerank_runs++;
+        }
+      }
+    });
+  }
+
+  int64_t num_updates = 0;
+  double writer_sec = 0;
+  {
+    ScopedTimer t("Apply updates");
+    std::uniform_real_distribution<double> coin(0, 1);
+    std::vector<DynamicGraph::Update> batch;
+    size_t next = num_initial;
+    while (next < feed.size()) {
+      batch.clear();
+      while (batch.size() < static_cast<size_t>(batch_size) &&
+             next < feed.size()) {
+        if (!live.empty() && coin(rng) < delete_ratio) {
+          std::uniform_int_distribution<size_t> pick(0, live.size() - 1);
+          size_t i = pick(rng);
+          batch.push_back({live[i].first, live[i].second, false});
+          expected.erase(live[i]);
+          live[i] = live.back();
+          live.pop_back();
+        } else {
+          batch.push_back({feed[next].first, feed[next].second, true});
+          if (expected.insert(feed[next]).second)
+            live.push_back(feed[next]);
+          next++;
+        }
+      }
+      graph->Apply(batch);
+      num_updates += batch.size();
+    }
+    writer_sec = t.elapsed();
+  }
+  done = true;
+  for (auto& th : readers)
+    th.join();
+
+  DynamicGraph::Snapshot last = graph->snapshot();
+  CsrGraph compacted = last.ToCsr();
+  bool ok = compacted.num_edges() == static_cast<int64_t>(expected.size());
+  for (int v = 0; ok && v < compacted.num_vertexes(); v++) {
+    for (const int* it = compacted.begin(v); ok && it != compacted.end(v);
+         ++it)
+      ok = expected.count(std::make_pair(v, *it)) > 0;
+  }
+
+  std::cout << "updates: " << num_updates << " in " << graph->version()
+            << " batches, " << (writer_sec > 0 ? num_updates / writer_sec : 0)
+            << " updates/sec" << std::endl;
+  std::cout << "compactions: " << graph->compactions()
+            << " delta entries: " << graph->delta_entries() << std::endl;
+  std::cout << "readers: " << bfs_runs << " BFS, " << pagerank_runs
+            << " PageRank runs, " << inconsistent << " inconsistent"
+            << std::endl;
+  std::cout << "final edges: " << last.num_edges()
+            << " matches feed: " << (ok ? "yes" : "NO") << std::endl;
+  return ok && inconsistent == 0 ? 0 : 1;
+}
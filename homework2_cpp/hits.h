@@ -0,0 +1,109 @@
+// HITS hub and authority scores (Kleinberg, 1999).
+//
+// Every iteration first pulls the authorities over the in-link CSR,
+//   authority'(v) = sum over in-links u -> v of hub(u),
+// then the hubs over the out-link CSR from the new authorities,
+//   hub'(u) = sum over out-links u -> w of authority'(w),
+// and scales both vectors to unit L2 norm. Each pass reads one contiguous
+// edge array once and writes every vertex from a single thread, so an
+// iteration costs about two PageRank sweeps and needs no atomics. The
+// iterations stop when both vectors moved less than |tolerance| in L1
+// norm, or after |max_iterations|.
+#ifndef HOMEWORK2_CPP_HITS_H_
+#define HOMEWORK2_CPP_HITS_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "../common/csr_graph.h"
+#include "../common/instrumentation.h"
+#include "../common/parallel.h"
+
+class Hits {
+ public:
+  struct Result {
+    std::vector<double> authority;
+    std::vector<double> hub;
+    int iterations = 0;
+    double delta = 0;  // L1 change of the last iteration, both vectors
+    bool converged = false;
+  };
+
+  explicit Hits(const CsrGraph& graph)
+      : out_links_(graph), in_links_(graph.Reversed()) {}
+
+  Result Run(int max_iterations, double tolerance) const {
+    INSTRUMENT_SCOPE("Hits::Run");
+    int n = out_links_.num_vertexes();
+    Result result;
+    double initial = n > 0 ? 1 / std::sqrt(static_cast<double>(n)) : 0;
+    result.authority.assign(n, initial);
+    result.hub.assign(n, initial);
+    std::vector<double> next(n);
+    while (result.iterations < max_iterations) {
+      double delta = Pull(in_links_, result.hub, &result.authority, &next);
+      delta += Pull(out_links_, result.authority, &result.hub, &next);
+      result.iterations++;
+      result.delta = delta;
+      INSTRUMENT_COUNT("hits.edges", 2 * out_links_.num_edges());
+      if (delta < tolerance) {
+        result.converged = true;
+        break;
+      }
+    }
+    return result;
+  }
+
+ private:
+  // Replaces |*scores| with the normalized sums of |from| over |links| and
+  // returns the L1 distance moved. |next| is scratch space.
+  static double Pull(const CsrGraph& links, const std::vector<double>& from,
+                     std::vector<double>* scores, std::vector<double>* next) {
+    // Sums go to locals and reach the per-thread slots once per chunk, so
+    // threads do not keep bouncing the cache line of the slots.
+    const int64_t kChunk = 4096;
+    int n = links.num_vertexes();
+    int64_t num_chunks = (n + kChunk - 1) / kChunk;
+    std::vector<double> squares(NumThreads());
+    ParallelForWithThreadId(0, num_chunks, 1, [&](int tid, int64_t c) {
+      double local = 0;
+      for (int64_t v = c * kChunk; v < std::min<int64_t>(n, (c + 1) * kChunk);
+           v++) {
+        double sum = 0;
+        for (const int* it = links.begin(v); it != links.end(v); ++it)
+          sum += from[*it];
+        (*next)[v] = sum;
+        local += sum * sum;
+      }
+      squares[tid] += local;
+    });
+    double norm = 0;
+    for (double s : squares)
+      norm += s;
+    norm = std::sqrt(norm);
+    double scale = norm > 0 ? 1 / norm : 0;
+
+    std::vector<double> deltas(NumThreads());
+    ParallelForWithThreadId(0, num_chunks, 1, [&](int tid, int64_t c) {
+      double local = 0;
+      for (int64_t v = c * kChunk; v < std::min<int64_t>(n, (c + 1) * kChunk);
+           v++) {
+        double score = (*next)[v] * scale;
+        local += std::fabs(score - (*scores)[v]);
+        (*scores)[v] = score;
+      }
+      deltas[tid] += local;
+    });
+    double delta = 0;
+    for (double d : deltas)
+      delta += d;
+    return delta;
+  }
+
+  const CsrGraph& out_links_;
+  CsrGraph in_links_;
+};
+
+#endif  // HOMEWORK2_CPP_HITS_H_
@@ -1,17 +1,75 @@
-#include <sys/time.h>
-
+//! clang++ -std=c++14 -Wall -Wextra pagerank_for_wikipedia.cc
+//
+// Usage: ./a.out [--order=none|degree|rcm|gorder] [--compressed=varint|group]
+//                [--partitioned[=N] | --processes=N]
+//                [--betweenness[=K] | --betweenness-error=EPS]
+//                [--rank=pagerank|authority|hub] [--fuzzy[=D]]
+//                [--cache-mb=64]
+//   --order: relabel vertexes after loading for cache locality.
+//   --compressed: keep the links delta encoded in memory instead of as
+//                 std::vector<int>.
+//   --partitioned: run the page rank iterations on N vertex partitions (one
+//                  per NUMA node by default) in parallel; see
+//                  partitioned_pagerank.h.
+//   --processes: run the page rank iterations in N worker processes that
+//                exchange boundary ranks through shared-memory rings, and
+//                print the exchange volume; see sharded_pagerank.h.
+//   --betweenness: print the pages with the highest betweenness centrality
+//                  and exit, exact or estimated from K sampled sources, or
+//                  from as many as needed for an error of EPS (see
+//                  betweenness.h).
+//   --rank: order the search results by page rank (default) or by the HITS
+//           authority or hub score (see hits.h).
+//   --fuzzy: when no title contains the query, answer with the titles
+//            within D (1 by default, at most 2) edits of it, counted in
+//            code points (see common/fuzzy_index.h).
+//   --cache-mb: memory for the answers of repeated queries (0: off); see
+//               common/query_cache.h.
 #include <algorithm>
 #include <cstdio>
-#include <fstream>
+#include <cstdlib>
+#include <cstring>
 #include <iomanip>
 #include <iostream>
 #include <memory>
+#include <numeric>
 #include <queue>
+#include <string>
 #include <vector>
 
+#include "../common/compressed_graph.h"
+#include "../common/csr_graph.h"
+#include "../common/fuzzy_index.h"
+#include "../common/graph_memory.h"
+#include "../common/instrumentation.h"
+#include "../common/perf_counters.h"
+#include "../common/query_cache.h"
+#include "../common/vertex_order.h"
+#include "betweenness.h"
+#include "hits.h"
+#include "partitioned_pagerank.h"
+#include "sharded_pagerank.h"
+
 const char* LINKS_TXT_PATH = "links.txt";
 const char* PAGES_TXT_PATH = "pages.txt";
 const double DEFAULT_PAGE_RANK = 100;
+// Probability that a sampled betweenness misses its error bound.
+const double BETWEENNESS_FAILURE = 0.1;
+
+// The score Graph::Search() orders the answers by.
+enum class RankSignal { kPageRank, kAuthority, kHub };
+
+bool ParseRankSignal(const std::string& name, RankSignal* signal) {
+  if (name == "pagerank")
+    *signal = RankSignal::kPageRank;
+  else if (name == "authority")
+    *signal = RankSignal::kAuthority;
+  else if (name == "hub")
+    *signal = RankSignal::kHub;
+  else
+    return false;
+  return true;
+}
 
 class Vertex {
  public:
@@ -38,7 +96,14 @@ class Vertex {
   }
 
   const std::vector<int>& edges() const { return edges_; }
+
+  // Frees the adjacency vector once the graph keeps a compressed copy.
+  void ReleaseEdges() { std::vector<int>().swap(edges_); }
   double weight() const { return weight_; }
+  void set_weight(double weight) {
+    weight_ = weight;
+    next_weight_ = 0;
+  }
 
  private:
   std::vector<int> edges_;
@@ -48,12 +113,12 @@ class Vertex {
 
 class Graph {
  public:
-  Graph() {}
+  Graph() : version_(NextGraphVersion()) {}
   void AddVertex(Vertex vertex) {
     vertexes_.emplace_back(std::move(vertex));
   }
 
-  const std::vector<Vertex>& vertexes() const {
+  const GraphVector<Vertex>& vertexes() const {
     return vertexes_;
   }
 
@@ -81,16 +146,68 @@ class Graph {
       const std::string& name = names_[i];
       if (name.find(query) == std::string::npos)
         continue;
-      answers.emplace_back(vertexes_[i].weight(), name);
+      answers.emplace_back(score(i), name);
     }
     return answers;
   }
 
+  // Indexes the titles for FuzzySearch() within |max_distance| edits.
+  void BuildFuzzyIndex(int max_distance) {
+    fuzzy_index_ = std::make_unique<FuzzyIndex>(names_, max_distance);
+    std::cout << "entries: " << fuzzy_index_->num_entries() << " bytes: "
+              << fuzzy_index_->memory_bytes() << std::endl;
+  }
+
+  // Titles within the index's edit distance of |query|, like Search().
+  std::vector<std::pair<double, std::string>> FuzzySearch(
+      const std::string& query) const {
+    std::vector<std::pair<double, std::string>> answers;
+    if (!fuzzy_index_)
+      return answers;
+    for (const FuzzyIndex::Match& m :
+         fuzzy_index_->Search(query, fuzzy_index_->max_distance()))
+      answers.emplace_back(score(m.id), names_[m.id]);
+    return answers;
+  }
+
+  // Computes the HITS scores and makes Search() rank by |signal|.
+  void UpdateHits(RankSignal signal, int max_iterations, double tolerance) {
+    version_ = NextGraphVersion();
+    CsrGraph graph = ToCsrGraph();
+    Hits::Result result = Hits(graph).Run(max_iterations, tolerance);
+    std::cout << "iterations: " << result.iterations
+              << " delta: " << result.delta
+              << (result.converged ? " (converged)" : "") << std::endl;
+    authority_ = std::move(result.authority);
+    hub_ = std::move(result.hub);
+    rank_signal_ = signal;
+  }
+
+  double score(int v) const {
+    switch (rank_signal_) {
+      case RankSignal::kAuthority:
+        return authority_[v];
+      case RankSignal::kHub:
+        return hub_[v];
+      default:
+        return vertexes_[v].weight();
+    }
+  }
+
+  // Changes whenever the links, the vertex ids or the scores change.
+  uint64_t version() const { return version_; }
+
   void UpdatePageRank() {
-    for (const auto& v : vertexes_) {
-      double out_weight = v.weight() / v.edges().size();
-      for (int idx : v.edges())
+    INSTRUMENT_SCOPE("UpdatePageRank");
+    version_ = NextGraphVersion();
+    PerfScope perf("UpdatePageRank");
+    for (size_t i = 0; i < vertexes_.size(); i++) {
+      double out_weight = vertexes_[i].weight() / degree(i);
+      INSTRUMENT_COUNT("pagerank.edges", degree(i));
+      perf.AddItems(degree(i));
+      ForEachEdge(i, [&](int idx) {
         vertexes_[idx].AddNextWeight(out_weight);
+      });
     }
 
     for (auto& v : vertexes_)
@@ -99,126 +216,280 @@ class Graph {
 
 
 
+  // Same as calling UpdatePageRank() |iterations| times, on
+  // |num_partitions| NUMA partitions in parallel (<= 0: one per node).
+  void UpdatePageRankPartitioned(int iterations, int num_partitions) {
+    version_ = NextGraphVersion();
+    CsrGraph graph = ToCsrGraph();
+    PartitionedPageRank pagerank(graph, num_partitions);
+    std::cout << "partitions: " << pagerank.num_partitions()
+              << " threads: " << pagerank.num_threads() << std::endl;
+    std::vector<double> rank(graph.num_vertexes(), DEFAULT_PAGE_RANK);
+    for (size_t i = 0; i < vertexes_.size(); i++)
+      rank[i] = vertexes_[i].weight();
+    pagerank.Run(iterations, &rank);
+    for (size_t i = 0; i < vertexes_.size(); i++)
+      vertexes_[i].set_weight(rank[i]);
+  }
+
+  // Prints the |top| pages by betweenness centrality: exact if
+  // |num_samples| <= 0, else estimated from that many sources.
+  void PrintBetweenness(int64_t num_samples, int top) const {
+    CsrGraph graph = ToCsrGraph();
+    Betweenness betweenness(graph);
+    const uint64_t kSeed = 1;
+    Betweenness::Result result =
+        num_samples > 0
+            ? betweenness.Sample(num_samples, kSeed, BETWEENNESS_FAILURE)
+            : betweenness.Exact();
+    std::cout << "sources: " << result.num_sources
+              << " traversed edges: " << result.traversed_edges << std::endl;
+    if (result.epsilon > 0) {
+      double n = graph.num_vertexes();
+      std::cout << "error: +-" << result.epsilon * n * (n - 2) << " ("
+                << result.epsilon << " normalized) with probability "
+                << 1 - BETWEENNESS_FAILURE << std::endl;
+    }
+    std::vector<int> order(graph.num_vertexes());
+    std::iota(order.begin(), order.end(), 0);
+    top = std::min<int>(top, order.size());
+    std::partial_sort(order.begin(), order.begin() + top, order.end(),
+                      [&](int a, int b) {
+                        return result.centrality[a] > result.centrality[b];
+                      });
+    for (int i = 0; i < top; i++) {
+      int v = order[i];
+      std::cout << (v < static_cast<int>(names_.size()) ? names_[v]
+                                                        : std::to_string(v))
+                << " score: " << result.centrality[v] << std::endl;
+    }
+  }
+
+  // Same as calling UpdatePageRank() |iterations| times, in
+  // |num_processes| worker processes. Returns false if a worker failed.
+  bool UpdatePageRankSharded(int iterations, int num_processes) {
+    version_ = NextGraphVersion();
+    CsrGraph graph = ToCsrGraph();
+    ShardedPageRank pagerank(graph, num_processes);
+    int64_t values = pagerank.exchanged_values();
+    std::cout << "processes: " << pagerank.num_processes()
+              << " exchanged per iteration: " << values << " ranks, "
+              << values * sizeof(double) << " bytes ("
+              << std::setprecision(3)
+              << 100.0 * values / std::max<int64_t>(1, graph.num_edges())
+              << "% of the links)" << std::endl;
+    std::vector<double> rank(graph.num_vertexes(), DEFAULT_PAGE_RANK);
+    for (size_t i = 0; i < vertexes_.size(); i++)
+      rank[i] = vertexes_[i].weight();
+    std::vector<ShardedPageRank::WorkerStats> stats;
+    if (!pagerank.Run(iterations, &rank, &stats))
+      return false;
+    for (size_t w = 0; w < stats.size(); w++) {
+      const ShardedPageRank::WorkerStats& s = stats[w];
+      std::cout << "worker " << w << ": vertexes [" << s.begin << ", "
+                << s.end << ") in-links: " << s.in_links
+                << " sent: " << s.sent_values
+                << " received: " << s.received_values
+                << " compute: " << s.compute_sec << " sec"
+                << " wait: " << s.wait_sec << " sec" << std::endl;
+    }
+    for (size_t i = 0; i < vertexes_.size(); i++)
+      vertexes_[i].set_weight(rank[i]);
+    return true;
+  }
+
+  // Renames every vertex with |order| so that linked pages sit close in
+  // memory. Use internal_id() to translate the ids of pages.txt afterwards.
+  void Reorder(VertexOrder order) {
+    version_ = NextGraphVersion();
+    CsrGraph graph = ToCsrGraph();
+    int n = graph.num_vertexes();
+    new_id_ = ComputeVertexOrder(order, graph, graph.Reversed());
+    CsrGraph relabeled = Relabel(graph, new_id_);
+
+    GraphVector<Vertex> vertexes;
+    vertexes.reserve(n);
+    for (int v = 0; v < n; v++)
+      vertexes.emplace_back(
+          std::vector<int>(relabeled.begin(v), relabeled.end(v)));
+    vertexes_ = std::move(vertexes);
+
+    std::vector<std::string> names(n);
+    for (size_t v = 0; v < names_.size(); v++)
+      names[new_id_[v]] = std::move(names_[v]);
+    names_ = std::move(names);
+  }
+
+  int internal_id(int id) const {
+    return new_id_.empty() ? id : new_id_[id];
+  }
+
+  // Replaces every adjacency vector with one delta-encoded stream. Vertex
+  // edges() are empty afterwards; use degree() and ForEachEdge() instead.
+  void Compress(CompressedGraph::Encoding encoding) {
+    compressed_ = std::make_unique<CompressedGraph>(ToCsrGraph(), encoding);
+    while (static_cast<int>(vertexes_.size()) < compressed_->num_vertexes())
+      AddVertex(Vertex(std::vector<int>()));
+    for (auto& v : vertexes_)
+      v.ReleaseEdges();
+  }
+
+  const CompressedGraph* compressed() const { return compressed_.get(); }
+
+  int degree(int v) const {
+    return compressed_ ? compressed_->degree(v)
+                       : static_cast<int>(vertexes_[v].edges().size());
+  }
+
+  template <typename Fn>
+  void ForEachEdge(int v, Fn fn) const {
+    if (compressed_) {
+      compressed_->ForEachNeighbor(v, fn);
+      return;
+    }
+    for (int e : vertexes_[v].edges())
+      fn(e);
+  }
+
   static std::unique_ptr<Graph> Create(const char* pages_path,
                                        const char* links_path) {
+    INSTRUMENT_SCOPE("Graph::Create");
+    PerfScope perf("Graph::Create");
     std::unique_ptr<Graph> graph = std::make_unique<Graph>();
 
-    std::fstream links_stream(links_path);
-    if (links_stream.fail()) {
-      std::cerr << "file not found: " << links_path << std::endl;
+    std::unique_ptr<CsrGraph> links = LoadLinks(links_path);
+    if (!links)
       return nullptr;
-    }
-
-    std::vector<int> edges;
-    while (true) {
-      static int vertex_index = 0;
-      int in = -1, out = -1;
-      links_stream >> in >> out;
-      if (links_stream.eof())
-        break;
-      if (in == -1 || out == -1) {
-        std::cerr << "unexpected error: " << vertex_index << std::endl;
-        return nullptr;
-      }
-      // Add the previous vertex and prepare for the next one.
-      if (in != vertex_index) {
-        vertex_index++;
-        graph->AddVertex(std::move(edges));
-        if (edges.size() != 0)
-          break;
-      }
-      edges.push_back(out);
-    }
-    // Add the last vertex
-    if (edges.size() != 0)
-      graph->AddVertex(std::move(edges));
-
-    // Read names
-    std::vector<std::string> names;
-    std::fstream pages_stream(pages_path);
-    if (pages_stream.fail()) {
-      std::cerr << "file not found: " << pages_path <<  std::endl;
+    perf.AddItems(links->num_edges());
+    if (!LoadNames(pages_path, &graph->names_))
       return nullptr;
-    }
 
-    while (true) {
-      size_t id;
-      std::string name;
-      pages_stream >> id >> name;
-      if (pages_stream.eof())
-        break;
-      if (names.size() != id) {
-        std::cerr << "unmatch id" << std::endl;
-        return nullptr;
-      }
-      names.push_back(name);
-    }
-    graph->names_ = std::move(names);
+    // Pages without links are isolated vertexes.
+    links->EnsureVertexes(graph->names_.size());
+    graph->vertexes_.reserve(links->num_vertexes());
+    for (int v = 0; v < links->num_vertexes(); v++)
+      graph->AddVertex(
+          Vertex(std::vector<int>(links->begin(v), links->end(v))));
 
     return graph;
   }
 
  private:
+  CsrGraph ToCsrGraph() const {
+    return CsrGraph::FromAdjacency(
+        vertexes_.size(), [this](int v) { return degree(v); },
+        [this](int v, auto fn) { ForEachEdge(v, fn); });
+  }
+
   std::vector<int> bfs(int from, int to) {
+    INSTRUMENT_SCOPE("bfs");
+    PerfScope perf("bfs");
     std::vector<bool> visited(vertexes().size());
     std::queue<std::vector<int>> queue;
     queue.emplace(std::vector<int>({from}));
     visited[from] = true;
+    // Vertexes popped at |level|; routes in |queue| have non-decreasing
+    // length, so a longer route starts the next level.
+    size_t level = 0;
+    int64_t frontier = 0;
 
     while (!queue.empty()) {
       const auto& route = queue.front();
       int index = route.back();
+      if (route.size() - 1 != level) {
+        INSTRUMENT_HISTOGRAM("bfs.frontier", frontier);
+        level = route.size() - 1;
+        frontier = 0;
+      }
+      frontier++;
       if (index == to)
         return std::move(route);
+      INSTRUMENT_COUNT("bfs.edges", degree(index));
+      perf.AddItems(degree(index));
       // Push the outgoing nodes into the |queue|
-      const Vertex& v = vertexes_[index];
-      for (const auto& i : v.edges()) {
+      ForEachEdge(index, [&](int i) {
         if (!visited[i]) {
           visited[i] = true;
           auto new_route = route;
           new_route.push_back(i);
           queue.emplace(std::move(new_route));
         }
-      }
+      });
       queue.pop();
     }
     return std::vector<int>();
   }
 
-  std::vector<Vertex> vertexes_;
+  GraphVector<Vertex> vertexes_;
   std::vector<std::string> names_;
+  std::vector<int> new_id_;  // id in pages.txt -> vertex index
+  std::unique_ptr<CompressedGraph> compressed_;
+  RankSignal rank_signal_ = RankSignal::kPageRank;
+  std::vector<double> authority_;  // HITS scores, once computed
+  std::vector<double> hub_;
+  std::unique_ptr<FuzzyIndex> fuzzy_index_;
+  uint64_t version_;
 };
 
 
-class Timer {
- public:
-  Timer(const std::string& tag) : tag_(tag) {
-    timeval tv;
-    gettimeofday(&tv, nullptr);
-    begin_ = tv.tv_sec + tv.tv_usec / 1E6;
-    std::cout << "==== " << tag_ << " ====" << std::endl;
-  }
-
-  ~Timer() {
-    timeval tv;
-    gettimeofday(&tv, nullptr);
-    double end = tv.tv_sec + tv.tv_usec / 1E6;
-
-    std::cout << "Elapsed: " << std::setprecision(3)
-              << end - begin_ << " sec" << std::endl;
-    std::cout << std::endl;
-    // std::cout << "==== End: " << tag_ << " ====" << std::endl;
+int main(int argc, char** argv) {
+  VertexOrder order = VertexOrder::kOriginal;
+  bool compress = false;
+  CompressedGraph::Encoding encoding = CompressedGraph::Encoding::kVarint;
+  int partitions = -1;  // < 0: serial UpdatePageRank()
+  int processes = 0;     // > 0: UpdatePageRankSharded()
+  bool betweenness = false;
+  int64_t betweenness_samples = 0;  // 0: exact
+  double betweenness_error = 0;
+  RankSignal rank_signal = RankSignal::kPageRank;
+  int fuzzy_distance = 0;  // 0: substring search only
+  int cache_mb = 64;
+  for (int i = 1; i < argc; i++) {
+    if (std::strncmp(argv[i], "--order=", 8) == 0 &&
+        ParseVertexOrder(argv[i] + 8, &order)) {
+      continue;
+    } else if (std::strcmp(argv[i], "--compressed=varint") == 0) {
+      compress = true;
+      encoding = CompressedGraph::Encoding::kVarint;
+    } else if (std::strcmp(argv[i], "--compressed=group") == 0) {
+      compress = true;
+      encoding = CompressedGraph::Encoding::kGroupVarint;
+    } else if (std::strncmp(argv[i], "--rank=", 7) == 0 &&
+               ParseRankSignal(argv[i] + 7, &rank_signal)) {
+      continue;
+    } else if (std::strncmp(argv[i], "--cache-mb=", 11) == 0) {
+      cache_mb = std::max(0, std::atoi(argv[i] + 11));
+    } else if (std::strcmp(argv[i], "--fuzzy") == 0) {
+      fuzzy_distance = 1;
+    } else if (std::strncmp(argv[i], "--fuzzy=", 8) == 0) {
+      fuzzy_distance = std::max(1, std::min(2, std::atoi(argv[i] + 8)));
+    } else if (std::strcmp(argv[i], "--betweenness") == 0) {
+      betweenness = true;
+    } else if (std::strncmp(argv[i], "--betweenness=", 14) == 0) {
+      betweenness = true;
+      betweenness_samples = std::max(1LL, std::atoll(argv[i] + 14));
+    } else if (std::strncmp(argv[i], "--betweenness-error=", 20) == 0) {
+      betweenness = true;
+      betweenness_error = std::atof(argv[i] + 20);
+      if (betweenness_error <= 0) {
+        std::cerr << "bad error: " << argv[i] + 20 << std::endl;
+        return -1;
+      }
+    } else if (std::strncmp(argv[i], "--processes=", 12) == 0) {
+      processes = std::max(1, std::atoi(argv[i] + 12));
+    } else if (std::strcmp(argv[i], "--partitioned") == 0) {
+      partitions = 0;
+    } else if (std::strncmp(argv[i], "--partitioned=", 14) == 0) {
+      partitions = std::max(1, std::atoi(argv[i] + 14));
+    } else {
+      std::cerr << "unknown option: " << argv[i] << std::endl;
+      return -1;
+    }
   }
 
- private:
-  double begin_;
-  std::string tag_;
-};
-
-int main() {
   std::unique_ptr<Graph> graph;
   {
-    Timer t("Create graph");
+    ScopedTimer t("Create graph");
     graph = Graph::Create(PAGES_TXT_PATH, LINKS_TXT_PATH);
     if (!graph)
       return -1;
@@ -231,22 +502,79 @@ int main() {
   }
 
 
+  if (order != VertexOrder::kOriginal) {
+    ScopedTimer t(std::string("Reorder vertexes: ") + VertexOrderName(order));
+    graph->Reorder(order);
+  }
+
+  if (compress) {
+    ScopedTimer t("Compress links");
+    graph->Compress(encoding);
+    std::cout << "bytes per edge: "
+              << static_cast<double>(graph->compressed()->memory_bytes()) /
+                     graph->compressed()->num_edges()
+              << std::endl;
+  }
+
+  if (betweenness) {
+    if (betweenness_error > 0)
+      betweenness_samples = Betweenness::SamplesFor(
+          graph->vertexes().size(), betweenness_error, BETWEENNESS_FAILURE);
+    ScopedTimer t(betweenness_samples > 0 ? "Betweenness (sampled)"
+                                          : "Betweenness (exact)");
+    const int kTop = 10;
+    graph->PrintBetweenness(betweenness_samples, kTop);
+    return 0;
+  }
+
   // 457783: Google
   // 17821: ディズニーランド
-  {
-    Timer t("Google -> Disney");
-    graph->PrintShortestPath(457783, 17821);
-  }
-  {
-    Timer t("Disney -> Google");
-    graph->PrintShortestPath(17821, 457783);
+  const int kGoogleId = 457783;
+  const int kDisneyId = 17821;
+  if (static_cast<int>(graph->vertexes().size()) > kGoogleId) {
+    {
+      ScopedTimer t("Google -> Disney");
+      graph->PrintShortestPath(graph->internal_id(kGoogleId),
+                               graph->internal_id(kDisneyId));
+    }
+    {
+      ScopedTimer t("Disney -> Google");
+      graph->PrintShortestPath(graph->internal_id(kDisneyId),
+                               graph->internal_id(kGoogleId));
+    }
   }
 
-  for (int i = 0; i < 20; i++) {
-    Timer t("Update page rank");
-    graph->UpdatePageRank();
+  const int kIterations = 20;
+  if (processes > 0) {
+    ScopedTimer t("Update page rank (processes)");
+    if (!graph->UpdatePageRankSharded(kIterations, processes))
+      return -1;
+  } else if (partitions >= 0) {
+    ScopedTimer t("Update page rank (partitioned)");
+    graph->UpdatePageRankPartitioned(kIterations, partitions);
+  } else {
+    for (int i = 0; i < kIterations; i++) {
+      ScopedTimer t("Update page rank");
+      graph->UpdatePageRank();
+    }
+  }
+  if (rank_signal != RankSignal::kPageRank) {
+    const int kMaxHitsIterations = 100;
+    const double kHitsTolerance = 1E-8;
+    ScopedTimer t("Update HITS");
+    graph->UpdateHits(rank_signal, kMaxHitsIterations, kHitsTolerance);
+  }
+  if (fuzzy_distance > 0) {
+    ScopedTimer t("Build fuzzy index");
+    graph->BuildFuzzyIndex(fuzzy_distance);
   }
 
+  using SearchCache =
+      QueryCache<std::string, std::vector<std::pair<double, std::string>>>;
+  std::unique_ptr<SearchCache> cache;
+  if (cache_mb > 0)
+    cache = std::make_unique<SearchCache>(static_cast<size_t>(cache_mb) << 20);
+
   while (true) {
     std::cout << "Input query (Press Ctrl+D to quit): ";
     std::string query;
@@ -259,14 +587,37 @@ int main() {
       continue;
 
     std::cout << "searching..." << std::endl;
+    // The fuzzy answers are cached under the query too, as they only
+    // replace an empty exact answer.
     std::vector<std::pair<double, std::string>> answers;
+    bool fuzzy = false;
     {
-      Timer t("query");
-      answers = graph->Search(query);
+      ScopedTimer t("query");
+      if (!cache || !cache->Get(query, graph->version(), &answers)) {
+        answers = graph->Search(query);
+        if (answers.empty() && fuzzy_distance > 0)
+          answers = graph->FuzzySearch(query);
+        if (cache) {
+          size_t bytes = answers.size() * sizeof(answers[0]);
+          for (const auto& answer : answers)
+            bytes += answer.second.capacity();
+          cache->Put(query, graph->version(), answers, bytes);
+        }
+      }
+      fuzzy = fuzzy_distance > 0 && !answers.empty() &&
+              answers[0].second.find(query) == std::string::npos;
+      if (cache) {
+        SearchCache::Stats stats = cache->stats();
+        std::cout << "cache: " << stats.hits << " hits " << stats.misses
+                  << " misses " << stats.entries << " entries" << std::endl;
+      }
     }
-    std::cout << "We have " << answers.size() << " answers" << std::endl;
+    std::cout << "We have " << answers.size() << " answers";
+    if (fuzzy)
+      std::cout << " within " << fuzzy_distance << " edits";
+    std::cout << std::endl;
     {
-      Timer t("sort");
+      ScopedTimer t("sort");
       std::sort(answers.begin(), answers.end());
     }
 
@@ -0,0 +1,159 @@
+// PageRank with the vertex range split into one partition per NUMA node.
+//
+// Each partition owns a contiguous range of destination vertexes, balanced
+// by in-links, and its own slice of the in-link CSR, built by a thread of
+// that partition so the pages are first touched on its node. The
+// contributions rank / out-degree are double buffered: iteration i pulls
+// from buffer i % 2 and writes the next contributions of its own range into
+// the other buffer, whose slice for the partition is bound to the
+// partition's node. Iterations are separated by a single barrier.
+//
+// Computes the same recurrence as Graph::UpdatePageRank() in
+// pagerank_for_wikipedia.cc: rank'(v) = sum over in-links u -> v of
+// rank(u) / out-degree(u). Run with GRAPH_PIN_THREADS=1 so that threads
+// stay on the node of their partition.
+#ifndef HOMEWORK2_CPP_PARTITIONED_PAGERANK_H_
+#define HOMEWORK2_CPP_PARTITIONED_PAGERANK_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "../common/csr_graph.h"
+#include "../common/graph_memory.h"
+#include "../common/parallel.h"
+
+class PartitionedPageRank {
+ public:
+  // |num_partitions| <= 0 means one partition per NUMA node.
+  PartitionedPageRank(const CsrGraph& graph, int num_partitions)
+      : in_links_(graph.Reversed()), out_degree_(graph.num_vertexes()) {
+    int n = graph.num_vertexes();
+    for (int v = 0; v < n; v++)
+      out_degree_[v] = graph.degree(v);
+    GraphMemory& memory = GraphMemory::Get();
+    if (num_partitions <= 0)
+      num_partitions = memory.nodes().size();
+    num_partitions = std::max(1, std::min(num_partitions, std::max(n, 1)));
+    num_threads_ = std::max(NumThreads(), num_partitions);
+
+    // Boundaries where the running in-link (+1 per vertex) count crosses
+    // k / num_partitions of the total.
+    int64_t total = in_links_.num_edges() + n;
+    partitions_.resize(num_partitions);
+    int v = 0;
+    for (int p = 0; p < num_partitions; p++) {
+      Partition& part = partitions_[p];
+      part.begin = v;
+      int64_t limit = total * (p + 1) / num_partitions;
+      while (v < n && in_links_.offsets()[v + 1] + v + 1 <= limit)
+        v++;
+      if (p == num_partitions - 1)
+        v = n;
+      part.end = v;
+      part.node = p % memory.nodes().size();
+      part.first_thread = static_cast<int>(
+          static_cast<int64_t>(num_threads_) * p / num_partitions);
+      part.num_threads = static_cast<int>(
+          static_cast<int64_t>(num_threads_) * (p + 1) / num_partitions) -
+          part.first_thread;
+    }
+
+    for (auto& buffer : contribution_) {
+      buffer.resize(n);
+      for (const Partition& part : partitions_) {
+        memory.MoveToNode(buffer.data() + part.begin,
+                          (part.end - part.begin) * sizeof(double),
+                          part.node);
+      }
+    }
+    RunOnThreads(num_threads_, [&](int tid) {
+      Partition& part = partitions_[PartitionOfThread(tid)];
+      if (tid == part.first_thread)
+        part.in_links = in_links_.Slice(part.begin, part.end);
+    });
+    // Only the partition slices are used from here on.
+    in_links_ = CsrGraph();
+  }
+
+  int num_partitions() const { return partitions_.size(); }
+  int num_threads() const { return num_threads_; }
+
+  // Runs |iterations| steps starting from |rank|, which must hold one value
+  // per vertex, and leaves the result in |rank|.
+  void Run(int iterations, std::vector<double>* rank) {
+    SpinBarrier barrier(num_threads_);
+    RunOnThreads(num_threads_, [&](int tid) {
+      const Partition& part = partitions_[PartitionOfThread(tid)];
+      // Split the partition among its threads by in-links as well.
+      int k = tid - part.first_thread;
+      int begin = ThreadBoundary(part, k);
+      int end = ThreadBoundary(part, k + 1);
+      for (int v = begin; v < end; v++) {
+        contribution_[0][v] =
+            out_degree_[v] ? (*rank)[v] / out_degree_[v] : 0;
+      }
+      barrier.Wait();
+      for (int i = 0; i < iterations; i++) {
+        const double* current = contribution_[i % 2].data();
+        double* next = contribution_[(i + 1) % 2].data();
+        for (int v = begin; v < end; v++) {
+          int local = v - part.begin;
+          double sum = 0;
+          for (const int* it = part.in_links.begin(local);
+               it != part.in_links.end(local); ++it)
+            sum += current[*it];
+          (*rank)[v] = sum;
+          next[v] = out_degree_[v] ? sum / out_degree_[v] : 0;
+        }
+        barrier.Wait();
+      }
+    });
+  }
+
+ private:
+  struct Partition {
+    int begin;
+    int end;
+    int node;
+    int first_thread;
+    int num_threads;
+    CsrGraph in_links;  // vertex i is vertex begin + i
+  };
+
+  int PartitionOfThread(int tid) const {
+    int p = 0;
+    while (p + 1 < static_cast<int>(partitions_.size()) &&
+           partitions_[p + 1].first_thread <= tid)
+      p++;
+    return p;
+  }
+
+  // First vertex of the |k|-th thread of |part|.
+  static int ThreadBoundary(const Partition& part, int k) {
+    if (k >= part.num_threads)
+      return part.end;
+    int n = part.end - part.begin;
+    int64_t total = part.in_links.num_edges() + n;
+    int64_t limit = total * k / part.num_threads;
+    const auto& offsets = part.in_links.offsets();
+    // First local vertex whose prefix (in-links + vertexes) reaches |limit|.
+    int lo = 0, hi = n;
+    while (lo < hi) {
+      int mid = (lo + hi) / 2;
+      if (offsets[mid] + mid < limit)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+    return part.begin + lo;
+  }
+
+  CsrGraph in_links_;
+  GraphVector<int> out_degree_;
+  GraphVector<double> contribution_[2];
+  std::vector<Partition> partitions_;
+  int num_threads_;
+};
+
+#endif  // HOMEWORK2_CPP_PARTITIONED_PAGERANK_H_
@@ -0,0 +1,576 @@
+// Pruned landmark labeling (Akiba et al., SIGMOD'13) for exact hop distances
+// on a directed graph.
+//
+// Every vertex v gets an out-label L_out(v) = {(h, d(v, h))} and an in-label
+// L_in(v) = {(h, d(h, v))} such that
+//
+//   d(s, t) = min { d(s, h) + d(h, t) : h in L_out(s) and h in L_in(t) }
+//
+// Labels are built by one pruned BFS per vertex (forward for L_in, backward
+// for L_out) in decreasing degree order. Both BFSs of a root only depend on
+// labels of earlier roots, so they run on two threads in lock step.
+//
+// The first roots are handled by bit-parallel BFSs instead: a root r and up
+// to 64 neighbours that are linked with r in both directions share one BFS.
+// The reciprocal links keep |d(s, v) - d(r, v)| <= 1 for every neighbour s,
+// which is what the bit-parallel labels need on a directed graph.
+//
+// Label distances are 8 bits wide, so Build() fails on a graph with a
+// shortest path of more than 254 hops rather than answer it wrongly.
+#ifndef HOMEWORK2_CPP_PRUNED_LANDMARK_LABELING_H_
+#define HOMEWORK2_CPP_PRUNED_LANDMARK_LABELING_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../common/csr_graph.h"
+#include "../common/parallel.h"
+
+class PrunedLandmarkLabeling {
+ public:
+  static constexpr int kInfinity = std::numeric_limits<int>::max();
+
+  // What an index file was built from. Load() only accepts a file whose
+  // header equals the expected one.
+  struct Header {
+    int32_t magic;
+    int32_t num_vertexes;
+    int32_t num_bit_parallel_roots;
+    int32_t reserved;
+    int64_t num_edges;
+    FileStamp links;  // of links.txt
+  };
+
+  static Header MakeHeader(const CsrGraph& graph, int num_bit_parallel_roots,
+                           const char* links_path) {
+    return Header{kMagic, graph.num_vertexes(), num_bit_parallel_roots, 0,
+                  graph.num_edges(), StampOf(links_path)};
+  }
+
+  // Builds the index. |num_bit_parallel_roots| roots are labelled with
+  // bit-parallel BFS before the pruned BFS phase. Returns nullptr if a
+  // distance does not fit in a label.
+  static std::unique_ptr<PrunedLandmarkLabeling> Build(
+      const CsrGraph& graph, int num_bit_parallel_roots) {
+    std::unique_ptr<PrunedLandmarkLabeling> index(new PrunedLandmarkLabeling());
+    index->BuildIndex(graph, num_bit_parallel_roots);
+    if (index->overflow_) {
+      std::cerr << "a shortest path is longer than "
+                << static_cast<int>(kUnreachable) - 1
+                << " hops, which the labels can not hold" << std::endl;
+      return nullptr;
+    }
+    return index;
+  }
+
+  int num_vertexes() const { return num_vertexes_; }
+
+  // Exact hop distance from |from| to |to|, or kInfinity if unreachable.
+  int Query(int from, int to) const {
+    if (from == to)
+      return 0;
+    int s = rank_[from], t = rank_[to];
+    int best = kInfinity;
+
+    size_t bs = static_cast<size_t>(s) * num_bp_;
+    size_t bt = static_cast<size_t>(t) * num_bp_;
+    for (int i = 0; i < num_bp_; i++) {
+      BitParallelLabel ls = bp_out_.Get(bs + i), lt = bp_in_.Get(bt + i);
+      if (ls.dist == kUnreachable || lt.dist == kUnreachable)
+        continue;
+      int d = ls.dist + lt.dist;
+      if (d - 2 < best) {
+        if (ls.minus_one & lt.minus_one)
+          d -= 2;
+        else if ((ls.minus_one & lt.zero) | (ls.zero & lt.minus_one))
+          d -= 1;
+        best = std::min(best, d);
+      }
+    }
+
+    // Merge-join the sorted hub lists. Both end with a kSentinel hub.
+    const uint32_t* hs = &out_hubs_[out_offsets_[s]];
+    const uint8_t* ds = &out_dists_[out_offsets_[s]];
+    const uint32_t* ht = &in_hubs_[in_offsets_[t]];
+    const uint8_t* dt = &in_dists_[in_offsets_[t]];
+    while (true) {
+      if (*hs == *ht) {
+        if (*hs == kSentinel)
+          break;
+        best = std::min(best, *ds + *dt);
+        hs++, ds++, ht++, dt++;
+      } else if (*hs < *ht) {
+        hs++, ds++;
+      } else {
+        ht++, dt++;
+      }
+    }
+    return best;
+  }
+
+  // Average number of normal (non bit-parallel) entries per label.
+  double AverageLabelSize() const {
+    if (num_vertexes_ == 0)
+      return 0;
+    return (in_hubs_.size() + out_hubs_.size() - 2.0 * num_vertexes_) /
+           (2.0 * num_vertexes_);
+  }
+
+  size_t memory_bytes() const {
+    return (in_hubs_.size() + out_hubs_.size()) *
+               (sizeof(uint32_t) + sizeof(uint8_t)) +
+           (in_offsets_.size() + out_offsets_.size()) * sizeof(int64_t) +
+           (bp_in_.dist.size() + bp_out_.dist.size()) *
+               (sizeof(uint8_t) + 2 * sizeof(uint64_t)) +
+           rank_.size() * sizeof(int);
+  }
+
+  bool Save(const std::string& path, const Header& header) const {
+    std::ofstream out(path, std::ios::binary);
+    if (out.fail()) {
+      std::cerr << "cannot open: " << path << std::endl;
+      return false;
+    }
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    WriteVector(&out, rank_);
+    WriteVector(&out, bp_in_.dist);
+    WriteVector(&out, bp_in_.sets);
+    WriteVector(&out, bp_out_.dist);
+    WriteVector(&out, bp_out_.sets);
+    WriteVector(&out, in_offsets_);
+    WriteVector(&out, in_hubs_);
+    WriteVector(&out, in_dists_);
+    WriteVector(&out, out_offsets_);
+    WriteVector(&out, out_hubs_);
+    WriteVector(&out, out_dists_);
+    out.close();
+    if (out.fail()) {
+      std::cerr << "cannot write: " << path << std::endl;
+      std::remove(path.c_str());
+      return false;
+    }
+    return true;
+  }
+
+  // Returns nullptr if the file is missing or its header differs from
+  // |expected|, i.e. it was built from other links or with other options.
+  static std::unique_ptr<PrunedLandmarkLabeling> Load(const std::string& path,
+                                                      const Header& expected) {
+    std::ifstream in(path, std::ios::binary);
+    if (in.fail())
+      return nullptr;
+    Header header;
+    in.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (in.fail() || header.magic != expected.magic ||
+        header.num_vertexes != expected.num_vertexes ||
+        header.num_bit_parallel_roots != expected.num_bit_parallel_roots ||
+        header.num_edges != expected.num_edges ||
+        header.links != expected.links) {
+      std::cerr << "stale " << path << ", rebuilding" << std::endl;
+      return nullptr;
+    }
+    std::unique_ptr<PrunedLandmarkLabeling> index(new PrunedLandmarkLabeling());
+    index->num_vertexes_ = header.num_vertexes;
+    index->num_bp_ = header.num_bit_parallel_roots;
+    if (!ReadVector(&in, &index->rank_) ||
+        !ReadVector(&in, &index->bp_in_.dist) ||
+        !ReadVector(&in, &index->bp_in_.sets) ||
+        !ReadVector(&in, &index->bp_out_.dist) ||
+        !ReadVector(&in, &index->bp_out_.sets) ||
+        !ReadVector(&in, &index->in_offsets_) ||
+        !ReadVector(&in, &index->in_hubs_) ||
+        !ReadVector(&in, &index->in_dists_) ||
+        !ReadVector(&in, &index->out_offsets_) ||
+        !ReadVector(&in, &index->out_hubs_) ||
+        !ReadVector(&in, &index->out_dists_)) {
+      return nullptr;
+    }
+    return index;
+  }
+
+ private:
+  static constexpr int32_t kMagic = 0x324c4c50;  // "PLL2"
+  static constexpr uint8_t kUnreachable = std::numeric_limits<uint8_t>::max();
+  static constexpr uint32_t kSentinel = std::numeric_limits<uint32_t>::max();
+
+  struct BitParallelLabel {
+    uint8_t dist;        // d(r, v) for in-labels, d(v, r) for out-labels
+    uint64_t minus_one;  // neighbours s with distance dist - 1
+    uint64_t zero;       // neighbours s with distance dist
+  };
+
+  // Bit-parallel labels of all vertexes, vertex-major ([rank * num_bp_ + i]).
+  // Distances and sets are kept apart so that an entry takes 17 bytes
+  // instead of a padded 24.
+  struct BitParallelLabels {
+    struct Sets {
+      uint64_t minus_one;
+      uint64_t zero;
+    };
+
+    void Reset(size_t size) {
+      dist.assign(size, kUnreachable);
+      sets.assign(size, Sets{0, 0});
+    }
+    BitParallelLabel Get(size_t i) const {
+      return BitParallelLabel{dist[i], sets[i].minus_one, sets[i].zero};
+    }
+
+    std::vector<uint8_t> dist;
+    std::vector<Sets> sets;
+  };
+
+  struct LabelEntry {
+    uint32_t hub;  // rank of the root
+    uint8_t dist;
+  };
+
+  PrunedLandmarkLabeling() {}
+
+  void BuildIndex(const CsrGraph& input, int num_bp) {
+    int n = input.num_vertexes();
+    num_vertexes_ = n;
+
+    // Rank vertexes by total degree and relabel the graph so that rank i is
+    // vertex i. Hubs are stored as ranks, so labels come out sorted.
+    CsrGraph input_reversed = input.Reversed();
+    std::vector<int> order(n);
+    for (int v = 0; v < n; v++)
+      order[v] = v;
+    std::sort(order.begin(), order.end(), [&](int a, int b) {
+      int da = input.degree(a) + input_reversed.degree(a);
+      int db = input.degree(b) + input_reversed.degree(b);
+      return da > db || (da == db && a < b);
+    });
+    rank_.resize(n);
+    for (int r = 0; r < n; r++)
+      rank_[order[r]] = r;
+    std::vector<std::pair<int, int>> edges;
+    edges.reserve(input.num_edges());
+    for (int v = 0; v < n; v++) {
+      for (const int* it = input.begin(v); it != input.end(v); ++it) {
+        if (v != *it)
+          edges.emplace_back(rank_[v], rank_[*it]);
+      }
+    }
+    CsrGraph graph = CsrGraph::FromEdges(n, edges);
+    graph.SortNeighbors();
+    CsrGraph reversed = graph.Reversed();
+
+    std::vector<bool> used(n, false);
+    BuildBitParallelLabels(graph, reversed, num_bp, &used);
+
+    std::vector<std::vector<LabelEntry>> in_labels(n), out_labels(n);
+    BuildPrunedLabels(graph, reversed, used, &in_labels, &out_labels);
+    Flatten(in_labels, &in_offsets_, &in_hubs_, &in_dists_);
+    Flatten(out_labels, &out_offsets_, &out_hubs_, &out_dists_);
+  }
+
+  void BuildBitParallelLabels(const CsrGraph& graph, const CsrGraph& reversed,
+                              int num_bp, std::vector<bool>* used) {
+    int n = graph.num_vertexes();
+    num_bp_ = num_bp;
+    bp_in_.Reset(static_cast<size_t>(n) * num_bp_);
+    bp_out_.Reset(static_cast<size_t>(n) * num_bp_);
+
+    // Pick the roots and their reciprocal neighbours sequentially...
+    std::vector<int> roots;
+    std::vector<std::vector<int>> neighbours;
+    int next_root = 0;
+    for (int i = 0; i < num_bp_; i++) {
+      while (next_root < n && (*used)[next_root])
+        next_root++;
+      if (next_root == n) {
+        roots.push_back(-1);
+        neighbours.emplace_back();
+        continue;
+      }
+      int r = next_root;
+      (*used)[r] = true;
+      std::vector<int> selected;
+      for (const int* it = graph.begin(r);
+           it != graph.end(r) && selected.size() < 64; ++it) {
+        int s = *it;
+        if (!(*used)[s] &&
+            std::binary_search(reversed.begin(r), reversed.end(r), s)) {
+          (*used)[s] = true;
+          selected.push_back(s);
+        }
+      }
+      roots.push_back(r);
+      neighbours.push_back(std::move(selected));
+    }
+
+    // ...then run the forward and backward BFSs of every root in parallel.
+    ParallelFor(0, 2 * num_bp_, 1, [&](int64_t task) {
+      int i = static_cast<int>(task / 2);
+      if (roots[i] < 0)
+        return;
+      bool forward = task % 2 == 0;
+      BitParallelBfs(forward ? graph : reversed, roots[i], neighbours[i], i,
+                     forward ? &bp_in_ : &bp_out_);
+    });
+  }
+
+  // BFS from |root| that also tracks, for every reached vertex v, which of
+  // the |neighbours| are one hop closer to v than |root| (minus_one) or at
+  // the same distance (zero).
+  void BitParallelBfs(const CsrGraph& graph, int root,
+                      const std::vector<int>& neighbours, int i,
+                      BitParallelLabels* labels) {
+    int n = graph.num_vertexes();
+    std::vector<uint8_t> dist(n, kUnreachable);
+    std::vector<uint64_t> minus_one(n, 0), zero(n, 0);
+    std::vector<int> frontier = {root}, next;
+    dist[root] = 0;
+    for (size_t j = 0; j < neighbours.size(); j++) {
+      int s = neighbours[j];
+      dist[s] = 1;
+      minus_one[s] |= uint64_t(1) << j;
+      next.push_back(s);
+    }
+
+    for (int d = 0; !frontier.empty(); d++) {
+      // Vertexes at distance d + 1 found from |frontier|. |next| may already
+      // hold the neighbours at d == 0.
+      for (int v : frontier) {
+        for (const int* it = graph.begin(v); it != graph.end(v); ++it) {
+          if (dist[*it] == kUnreachable) {
+            if (d + 1 >= kUnreachable) {
+              overflow_ = true;
+              return;
+            }
+            dist[*it] = d + 1;
+            next.push_back(*it);
+          }
+        }
+      }
+      // Edges inside the level: s is one hop closer to v than to w.
+      for (int v : frontier) {
+        for (const int* it = graph.begin(v); it != graph.end(v); ++it) {
+          if (dist[*it] == d)
+            zero[*it] |= minus_one[v];
+        }
+      }
+      // Edges to the next level keep both sets.
+      for (int v : frontier) {
+        for (const int* it = graph.begin(v); it != graph.end(v); ++it) {
+          if (dist[*it] == d + 1) {
+            minus_one[*it] |= minus_one[v];
+            zero[*it] |= zero[v];
+          }
+        }
+      }
+      frontier.swap(next);
+      next.clear();
+    }
+
+    for (int v = 0; v < n; v++) {
+      size_t cell = static_cast<size_t>(v) * num_bp_ + i;
+      labels->dist[cell] = dist[v];
+      labels->sets[cell].minus_one = minus_one[v];
+      labels->sets[cell].zero = zero[v] & ~minus_one[v];
+    }
+  }
+
+  // Runs the pruned BFSs. The forward BFS of root r writes in-labels and
+  // reads the out-label of r; the backward one is symmetric. Once both
+  // threads copied the label of r they never touch each other's labels.
+  void BuildPrunedLabels(const CsrGraph& graph, const CsrGraph& reversed,
+                         const std::vector<bool>& used,
+                         std::vector<std::vector<LabelEntry>>* in_labels,
+                         std::vector<std::vector<LabelEntry>>* out_labels) {
+    int n = graph.num_vertexes();
+    int num_threads = NumThreads() >= 2 ? 2 : 1;
+    SpinBarrier barrier(num_threads);
+
+    auto run = [&](bool forward, int r, std::vector<uint8_t>* root_label,
+                   PrunedBfsScratch* scratch) {
+      if (forward) {
+        PrunedBfs(graph, r, *root_label, true, in_labels, scratch);
+      } else {
+        PrunedBfs(reversed, r, *root_label, false, out_labels, scratch);
+      }
+    };
+    auto load_root_label = [&](bool forward, int r,
+                               std::vector<uint8_t>* root_label) {
+      // Forward pruning needs d(r, h) from L_out(r), backward d(h, r).
+      const auto& label = forward ? (*out_labels)[r] : (*in_labels)[r];
+      for (const auto& e : label)
+        (*root_label)[e.hub] = e.dist;
+    };
+    auto clear_root_label = [&](bool forward, int r,
+                                std::vector<uint8_t>* root_label) {
+      const auto& label = forward ? (*out_labels)[r] : (*in_labels)[r];
+      for (const auto& e : label)
+        (*root_label)[e.hub] = kUnreachable;
+    };
+
+    if (num_threads == 1) {
+      std::vector<uint8_t> root_label(n, kUnreachable);
+      PrunedBfsScratch scratch(n);
+      for (int r = 0; r < n; r++) {
+        if (used[r])
+          continue;
+        for (bool forward : {true, false}) {
+          load_root_label(forward, r, &root_label);
+          run(forward, r, &root_label, &scratch);
+          clear_root_label(forward, r, &root_label);
+        }
+      }
+      return;
+    }
+
+    RunOnThreads(2, [&](int tid) {
+      bool forward = tid == 0;
+      std::vector<uint8_t> root_label(n, kUnreachable);
+      PrunedBfsScratch scratch(n);
+      for (int r = 0; r < n; r++) {
+        if (used[r])
+          continue;
+        load_root_label(forward, r, &root_label);
+        barrier.Wait();
+        run(forward, r, &root_label, &scratch);
+        barrier.Wait();
+        // The other thread has finished writing; L_{in,out}(r) now also
+        // contains (r, 0), which is harmless to clear.
+        clear_root_label(forward, r, &root_label);
+      }
+    });
+  }
+
+  struct PrunedBfsScratch {
+    explicit PrunedBfsScratch(int n) : dist(n, kUnreachable) {}
+    std::vector<uint8_t> dist;
+    std::vector<int> queue;
+  };
+
+  // |root_label[h]| is d(r, h) (forward) or d(h, r) (backward) for the hubs
+  // already in r's label. Adds (r, d) to |labels| of every vertex that is
+  // not already covered with a distance <= d.
+  void PrunedBfs(const CsrGraph& graph, int r,
+                 const std::vector<uint8_t>& root_label, bool forward,
+                 std::vector<std::vector<LabelEntry>>* labels,
+                 PrunedBfsScratch* scratch) {
+    std::vector<uint8_t>& dist = scratch->dist;
+    std::vector<int>& queue = scratch->queue;
+    queue.clear();
+    queue.push_back(r);
+    dist[r] = 0;
+    for (size_t head = 0; head < queue.size(); head++) {
+      int v = queue[head];
+      int d = dist[v];
+      if (Covered(r, v, d, root_label, forward, (*labels)[v]))
+        continue;
+      (*labels)[v].push_back(LabelEntry{static_cast<uint32_t>(r),
+                                        static_cast<uint8_t>(d)});
+      for (const int* it = graph.begin(v); it != graph.end(v); ++it) {
+        // Vertexes ranked before r are already fully labelled by themselves.
+        if (*it > r && dist[*it] == kUnreachable) {
+          if (d + 1 >= kUnreachable) {
+            overflow_ = true;
+            break;
+          }
+          dist[*it] = d + 1;
+          queue.push_back(*it);
+        }
+      }
+    }
+    for (int v : queue)
+      dist[v] = kUnreachable;
+  }
+
+  // Whether the current index already answers d(r, v) (or d(v, r)) <= |d|.
+  bool Covered(int r, int v, int d, const std::vector<uint8_t>& root_label,
+               bool forward, const std::vector<LabelEntry>& v_label) const {
+    const BitParallelLabels& r_labels = forward ? bp_out_ : bp_in_;
+    const BitParallelLabels& v_labels = forward ? bp_in_ : bp_out_;
+    size_t br = static_cast<size_t>(r) * num_bp_;
+    size_t bv = static_cast<size_t>(v) * num_bp_;
+    for (int i = 0; i < num_bp_; i++) {
+      BitParallelLabel lr = r_labels.Get(br + i), lv = v_labels.Get(bv + i);
+      if (lr.dist == kUnreachable || lv.dist == kUnreachable)
+        continue;
+      int td = lr.dist + lv.dist;
+      if (td - 2 <= d) {
+        if (lr.minus_one & lv.minus_one)
+          td -= 2;
+        else if ((lr.minus_one & lv.zero) | (lr.zero & lv.minus_one))
+          td -= 1;
+        if (td <= d)
+          return true;
+      }
+    }
+    for (const auto& e : v_label) {
+      if (root_label[e.hub] != kUnreachable &&
+          root_label[e.hub] + e.dist <= d)
+        return true;
+    }
+    return false;
+  }
+
+  static void Flatten(const std::vector<std::vector<LabelEntry>>& labels,
+                      std::vector<int64_t>* offsets,
+                      std::vector<uint32_t>* hubs,
+                      std::vector<uint8_t>* dists) {
+    offsets->assign(1, 0);
+    hubs->clear();
+    dists->clear();
+    for (const auto& label : labels) {
+      for (const auto& e : label) {
+        hubs->push_back(e.hub);
+        dists->push_back(e.dist);
+      }
+      hubs->push_back(kSentinel);
+      dists->push_back(0);
+      offsets->push_back(hubs->size());
+    }
+  }
+
+  template <typename T>
+  static void WriteVector(std::ofstream* out, const std::vector<T>& v) {
+    uint64_t size = v.size();
+    out->write(reinterpret_cast<const char*>(&size), sizeof(size));
+    out->write(reinterpret_cast<const char*>(v.data()), size * sizeof(T));
+  }
+
+  template <typename T>
+  static bool ReadVector(std::ifstream* in, std::vector<T>* v) {
+    uint64_t size = 0;
+    in->read(reinterpret_cast<char*>(&size), sizeof(size));
+    if (in->fail())
+      return false;
+    v->resize(size);
+    in->read(reinterpret_cast<char*>(v->data()), size * sizeof(T));
+    return !in->fail();
+  }
+
+  int num_vertexes_ = 0;
+  int num_bp_ = 0;
+  std::vector<int> rank_;  // vertex id -> rank
+  BitParallelLabels bp_in_;
+  BitParallelLabels bp_out_;
+  // Normal labels in CSR form, each terminated with kSentinel.
+  std::vector<int64_t> in_offsets_;
+  std::vector<uint32_t> in_hubs_;
+  std::vector<uint8_t> in_dists_;
+  std::vector<int64_t> out_offsets_;
+  std::vector<uint32_t> out_hubs_;
+  std::vector<uint8_t> out_dists_;
+  std::atomic<bool> overflow_{false};  // set by Build() when a path is too long
+};
+
+constexpr int PrunedLandmarkLabeling::kInfinity;
+constexpr int32_t PrunedLandmarkLabeling::kMagic;
+constexpr uint8_t PrunedLandmarkLabeling::kUnreachable;
+constexpr uint32_t PrunedLandmarkLabeling::kSentinel;
+
+#endif  // HOMEWORK2_CPP_PRUNED_LANDMARK_LABELING_H_
@@ -0,0 +1,203 @@
+//! clang++ -std=c++14 -O3 -Wall -Wextra reorder_bench.cc
+//
+// Measures how vertex reordering changes the locality of BFS and PageRank.
+//
+// For every ordering the graph is relabeled, then BFS (from fixed random
+// pages) and pull-style PageRank of common/graph_kernels.h are timed. The
+// random accesses of each kernel (offsets[] and dist[] for BFS,
+// contribution[] for PageRank) are also replayed through a set-associative
+// LRU cache model to estimate cache misses per edge, since hardware
+// counters are often unavailable.
+//
+// Usage: ./a.out [--cache-kb=1024] [--sources=8] [--iterations=10]
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../common/csr_graph.h"
+#include "../common/graph_kernels.h"
+#include "../common/instrumentation.h"
+#include "../common/vertex_order.h"
+
+const char* LINKS_TXT_PATH = "links.txt";
+
+// Set-associative LRU cache with 64 byte lines, usable as the trace of the
+// kernels.
+class CacheSimulator {
+ public:
+  CacheSimulator(size_t size_bytes, int ways)
+      : ways_(ways), num_sets_(std::max<size_t>(1, size_bytes / 64 / ways)),
+        tags_(num_sets_ * ways, kEmpty) {}
+
+  void Access(const void* address) {
+    uint64_t line = reinterpret_cast<uintptr_t>(address) / 64;
+    uint64_t* set = &tags_[(line % num_sets_) * ways_];
+    accesses_++;
+    for (int i = 0; i < ways_; i++) {
+      if (set[i] == line) {
+        // Move to front (most recently used).
+        for (; i > 0; i--)
+          set[i] = set[i - 1];
+        set[0] = line;
+        return;
+      }
+    }
+    misses_++;
+    for (int i = ways_ - 1; i > 0; i--)
+      set[i] = set[i - 1];
+    set[0] = line;
+  }
+
+  uint64_t misses() const { return misses_; }
+  uint64_t accesses() const { return accesses_; }
+
+ private:
+  static constexpr uint64_t kEmpty = ~uint64_t(0);
+
+  const int ways_;
+  const size_t num_sets_;
+  std::vector<uint64_t> tags_;
+  uint64_t misses_ = 0;
+  uint64_t accesses_ = 0;
+};
+
+constexpr uint64_t CacheSimulator::kEmpty;
+
+// CsrGraph that also replays the offsets[] read of every list into |cache|,
+// so that the simulated BFS sees the vertex accesses as well.
+class TracedCsr {
+ public:
+  TracedCsr(const CsrGraph& graph, CacheSimulator* cache)
+      : graph_(graph), cache_(cache) {}
+
+  int num_vertexes() const { return graph_.num_vertexes(); }
+  int degree(int v) const { return graph_.degree(v); }
+
+  template <typename Fn>
+  void ForEachNeighbor(int v, Fn fn) const {
+    cache_->Access(&graph_.offsets()[v]);
+    graph_.ForEachNeighbor(v, fn);
+  }
+
+ private:
+  const CsrGraph& graph_;
+  CacheSimulator* cache_;
+};
+
+struct Result {
+  double order_sec;
+  double bfs_sec;
+  double bfs_miss_per_edge;
+  double pagerank_sec;
+  double pagerank_miss_per_edge;
+  double log_gap;
+};
+
+int main(int argc, char** argv) {
+  size_t cache_kb = 1024;
+  int num_sources = 8;
+  int iterations = 10;
+  for (int i = 1; i < argc; i++) {
+    if (std::strncmp(argv[i], "--cache-kb=", 11) == 0) {
+      cache_kb = std::max(1, std::atoi(argv[i] + 11));
+    } else if (std::strncmp(argv[i], "--sources=", 10) == 0) {
+      num_sources = std::max(1, std::atoi(argv[i] + 10));
+    } else if (std::strncmp(argv[i], "--iterations=", 13) == 0) {
+      iterations = std::max(1, std::atoi(argv[i] + 13));
+    } else {
+      std::cerr << "unknown option: " << argv[i] << std::endl;
+      return -1;
+    }
+  }
+
+  std::unique_ptr<CsrGraph> original;
+  {
+    ScopedTimer t("Create graph");
+    original = LoadLinks(LINKS_TXT_PATH);
+    if (!original || original->num_vertexes() == 0)
+      return -1;
+    std::cout << "num vertexes: " << original->num_vertexes() << " "
+              << "num edges: " << original->num_edges() << std::endl;
+  }
+  CsrGraph original_reversed = original->Reversed();
+
+  // Same pages (in pages.txt ids) for every ordering.
+  std::mt19937 rng(12345);
+  std::uniform_int_distribution<int> pick(0, original->num_vertexes() - 1);
+  std::vector<int> sources;
+  for (int i = 0; i < num_sources; i++)
+    sources.push_back(pick(rng));
+
+  const VertexOrder kOrders[] = {VertexOrder::kOriginal, VertexOrder::kDegree,
+                                 VertexOrder::kRcm, VertexOrder::kGorder};
+  std::vector<Result> results;
+  for (VertexOrder order : kOrders) {
+    Result result;
+    std::vector<int> new_id;
+    {
+      ScopedTimer t(std::string("Order: ") + VertexOrderName(order));
+      new_id = ComputeVertexOrder(order, *original, original_reversed);
+      result.order_sec = t.elapsed();
+    }
+    CsrGraph graph = Relabel(*original, new_id);
+    CsrGraph reversed = graph.Reversed();
+    result.log_gap = AverageLogGap(graph);
+
+    std::vector<int> dist(graph.num_vertexes()), queue;
+    CacheSimulator bfs_cache(cache_kb * 1024, 8);
+    int64_t bfs_edges = 0;
+    {
+      ScopedTimer t(std::string("BFS: ") + VertexOrderName(order));
+      for (int s : sources)
+        bfs_edges += Bfs(graph, new_id[s], &dist, &queue);
+      result.bfs_sec = t.elapsed();
+    }
+    TracedCsr traced(graph, &bfs_cache);
+    for (int s : sources)
+      Bfs(traced, new_id[s], &dist, &queue, &bfs_cache);
+    result.bfs_miss_per_edge =
+        bfs_edges ? static_cast<double>(bfs_cache.misses()) / bfs_edges : 0;
+
+    std::vector<double> rank;
+    CacheSimulator pagerank_cache(cache_kb * 1024, 8);
+    {
+      ScopedTimer t(std::string("PageRank: ") + VertexOrderName(order));
+      PullPageRank(graph, reversed, iterations, &rank);
+      result.pagerank_sec = t.elapsed();
+    }
+    PullPageRank(graph, reversed, 1, &rank, &pagerank_cache);
+    result.pagerank_miss_per_edge =
+        reversed.num_edges()
+            ? static_cast<double>(pagerank_cache.misses()) /
+                  reversed.num_edges()
+            : 0;
+    results.push_back(result);
+  }
+
+  const Result& base = results[0];
+  std::cout << "cache model: " << cache_kb << " KB, 8-way, 64 B lines"
+            << std::endl;
+  std::cout << std::left << std::setw(8) << "order" << std::right
+            << std::setw(10) << "order(s)" << std::setw(10) << "log gap"
+            << std::setw(12) << "bfs miss/e" << std::setw(10) << "bfs x"
+            << std::setw(12) << "pr miss/e" << std::setw(10) << "pr x"
+            << std::endl;
+  std::cout << std::fixed << std::setprecision(3);
+  for (size_t i = 0; i < results.size(); i++) {
+    const Result& r = results[i];
+    std::cout << std::left << std::setw(8) << VertexOrderName(kOrders[i])
+              << std::right << std::setw(10) << r.order_sec << std::setw(10)
+              << r.log_gap << std::setw(12) << r.bfs_miss_per_edge
+              << std::setw(10) << (r.bfs_sec > 0 ? base.bfs_sec / r.bfs_sec : 0)
+              << std::setw(12) << r.pagerank_miss_per_edge << std::setw(10)
+              << (r.pagerank_sec > 0 ? base.pagerank_sec / r.pagerank_sec : 0)
+              << std::endl;
+  }
+  return 0;
+}
@@ -0,0 +1,376 @@
+// PageRank sharded over worker processes that only talk through
+// shared-memory ring buffers, a one-host model of a distributed PageRank.
+//
+// Every worker owns a contiguous vertex range, balanced by in-links, and
+// the in-links into it. A link u -> v with u and v in different ranges
+// makes u a boundary vertex of the pair (owner of u, owner of v); each
+// iteration the owner of u sends rank(u) / out-degree(u) once per pair, in
+// the fixed order of the pair's boundary list, so messages carry no ids.
+// The receiver keeps them in ghost slots after its own contributions, and
+// its in-links index that array directly.
+//
+// A pair of workers shares a single-producer single-consumer ring of
+// doubles with the read and write positions on their own cache lines. A
+// worker interleaves writing its outgoing rings and draining its incoming
+// ones until the iteration's messages are all through, so a full ring
+// never deadlocks, and then pulls the new ranks of its range. No barrier is
+// needed: a worker cannot get ahead by more than one iteration, because it
+// waits for its neighbours' messages of the same iteration.
+//
+// Computes the same recurrence as Graph::UpdatePageRank() in
+// pagerank_for_wikipedia.cc: rank'(v) = sum over in-links u -> v of
+// rank(u) / out-degree(u).
+#ifndef HOMEWORK2_CPP_SHARDED_PAGERANK_H_
+#define HOMEWORK2_CPP_SHARDED_PAGERANK_H_
+
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <thread>
+#include <vector>
+
+#include "../common/csr_graph.h"
+#include "../common/instrumentation.h"
+
+// std::atomic<uint64_t>::is_always_lock_free is C++17; the builtin asks the
+// compiler the same question for the ring counters.
+static_assert(__atomic_always_lock_free(sizeof(std::atomic<uint64_t>), 0),
+              "rings need lock-free 64-bit atomics across processes");
+
+class ShardedPageRank {
+ public:
+  struct WorkerStats {
+    int begin = 0;  // vertex range
+    int end = 0;
+    int64_t in_links = 0;
+    int64_t sent_values = 0;      // per iteration
+    int64_t received_values = 0;  // per iteration
+    double compute_sec = 0;       // all iterations
+    double wait_sec = 0;          // spinning on empty or full rings
+  };
+
+  // |num_processes| workers (at least 1), |ring_values| doubles per ring.
+  ShardedPageRank(const CsrGraph& graph, int num_processes,
+                  size_t ring_values = 1 << 16)
+      : out_degree_(graph.num_vertexes()),
+        ring_values_(std::max<size_t>(ring_values, 64)) {
+    INSTRUMENT_SCOPE("ShardedPageRank::Build");
+    int n = graph.num_vertexes();
+    int p = std::max(1, std::min(num_processes, std::max(n, 1)));
+    for (int v = 0; v < n; v++)
+      out_degree_[v] = graph.degree(v);
+    CsrGraph in_links = graph.Reversed();
+
+    // Boundaries where the running in-link (+1 per vertex) count crosses
+    // k / p of the total, as in PartitionedPageRank.
+    workers_.resize(p);
+    int64_t total = in_links.num_edges() + n;
+    int v = 0;
+    for (int w = 0; w < p; w++) {
+      workers_[w].begin = v;
+      int64_t limit = total * (w + 1) / p;
+      while (v < n && in_links.offsets()[v + 1] + v + 1 <= limit)
+        v++;
+      if (w == p - 1)
+        v = n;
+      workers_[w].end = v;
+      workers_[w].boundary.resize(p);
+      workers_[w].ghost_offset.resize(p + 1);
+    }
+    owner_.resize(n);
+    for (int w = 0; w < p; w++) {
+      for (int u = workers_[w].begin; u < workers_[w].end; u++)
+        owner_[u] = w;
+    }
+
+    // boundary[j] of worker i: its vertexes with a link into worker j, in
+    // increasing order.
+    for (int u = 0; u < n; u++) {
+      Worker& from = workers_[owner_[u]];
+      for (const int* it = graph.begin(u); it != graph.end(u); ++it) {
+        std::vector<int>& list = from.boundary[owner_[*it]];
+        if (owner_[*it] != owner_[u] && (list.empty() || list.back() != u))
+          list.push_back(u);
+      }
+    }
+    for (int w = 0; w < p; w++) {
+      Worker& worker = workers_[w];
+      int size = worker.end - worker.begin;
+      worker.ghost_offset[0] = size;
+      for (int q = 0; q < p; q++) {
+        worker.ghost_offset[q + 1] =
+            worker.ghost_offset[q] + workers_[q].boundary[w].size();
+      }
+      // In-links renumbered into the contribution array.
+      std::vector<std::pair<int, int>> edges;
+      for (int x = worker.begin; x < worker.end; x++) {
+        for (const int* it = in_links.begin(x); it != in_links.end(x);
+             ++it) {
+          int u = *it;
+          int q = owner_[u];
+          int index;
+          if (q == w) {
+            index = u - worker.begin;
+          } else {
+            const std::vector<int>& list = workers_[q].boundary[w];
+            index = worker.ghost_offset[q] +
+                    (std::lower_bound(list.begin(), list.end(), u) -
+                     list.begin());
+          }
+          edges.emplace_back(x - worker.begin, index);
+        }
+      }
+      worker.in_links = CsrGraph::FromEdges(size, edges);
+    }
+  }
+
+  int num_processes() const { return workers_.size(); }
+
+  // Doubles sent between workers in one iteration.
+  int64_t exchanged_values() const {
+    int64_t sum = 0;
+    for (const Worker& worker : workers_) {
+      for (const std::vector<int>& list : worker.boundary)
+        sum += list.size();
+    }
+    return sum;
+  }
+
+  // Runs |iterations| steps from |rank| (one value per vertex) in forked
+  // workers and leaves the result in |rank|. Returns false if a worker
+  // could not be started or failed.
+  bool Run(int iterations, std::vector<double>* rank,
+           std::vector<WorkerStats>* stats) {
+    int p = workers_.size();
+    int n = rank->size();
+    size_t ring_bytes = RingBytes();
+    size_t stats_bytes = p * sizeof(WorkerStats);
+    size_t bytes = n * sizeof(double) + stats_bytes + 64 +
+                   static_cast<size_t>(p) * p * ring_bytes;
+    void* shared = mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (shared == MAP_FAILED) {
+      std::cerr << "mmap failed: " << std::strerror(errno) << std::endl;
+      return false;
+    }
+    char* base = static_cast<char*>(shared);
+    double* result = reinterpret_cast<double*>(base);
+    WorkerStats* worker_stats =
+        reinterpret_cast<WorkerStats*>(base + n * sizeof(double));
+    for (int w = 0; w < p; w++)
+      new (&worker_stats[w]) WorkerStats();
+    // Rings are aligned to cache lines.
+    rings_ = base + ((n * sizeof(double) + stats_bytes + 63) / 64) * 64;
+    for (int i = 0; i < p * p; i++)
+      new (rings_ + i * ring_bytes) RingHeader();
+    std::copy(rank->begin(), rank->end(), result);
+
+    std::cout << std::flush;
+    std::vector<pid_t> children;
+    bool ok = true;
+    for (int w = 0; w < p && ok; w++) {
+      pid_t pid = fork();
+      if (pid < 0) {
+        std::cerr << "fork failed: " << std::strerror(errno) << std::endl;
+        ok = false;
+      } else if (pid == 0) {
+        RunWorker(w, iterations, result, &worker_stats[w]);
+        _exit(0);
+      } else {
+        children.push_back(pid);
+      }
+    }
+    // Workers are reaped as they exit. The peers of a worker that did not
+    // start or died would spin on its rings forever, so they are killed.
+    std::vector<bool> reaped(children.size(), false);
+    auto kill_running = [&] {
+      for (size_t c = 0; c < children.size(); c++) {
+        if (!reaped[c])
+          kill(children[c], SIGKILL);
+      }
+    };
+    if (!ok)
+      kill_running();
+    size_t running = children.size();
+    while (running > 0) {
+      int status = 0;
+      pid_t pid = waitpid(-1, &status, 0);
+      if (pid < 0) {
+        if (errno == EINTR)
+          continue;
+        std::cerr << "waitpid failed: " << std::strerror(errno) << std::endl;
+        ok = false;
+        break;
+      }
+      size_t c = std::find(children.begin(), children.end(), pid) -
+                 children.begin();
+      if (c == children.size())
+        continue;  // not a worker
+      reaped[c] = true;
+      running--;
+      if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        if (ok) {
+          std::cerr << "worker " << c << " (pid " << pid << ") failed"
+                    << std::endl;
+          kill_running();
+        }
+        ok = false;
+      }
+    }
+    if (ok) {
+      std::copy(result, result + n, rank->begin());
+      stats->assign(worker_stats, worker_stats + p);
+    }
+    munmap(shared, bytes);
+    return ok;
+  }
+
+ private:
+  struct Worker {
+    int begin;
+    int end;
+    std::vector<std::vector<int>> boundary;  // per destination worker
+    // Ghost slots of the values from worker q start at ghost_offset[q].
+    std::vector<int64_t> ghost_offset;
+    CsrGraph in_links;  // local vertex -> contribution index
+  };
+
+  struct RingHeader {
+    alignas(64) std::atomic<uint64_t> head{0};  // values read
+    alignas(64) std::atomic<uint64_t> tail{0};  // values written
+  };
+
+  size_t RingBytes() const {
+    return sizeof(RingHeader) +
+           ((ring_values_ * sizeof(double) + 63) / 64) * 64;
+  }
+
+  // The ring from worker |from| to worker |to|.
+  RingHeader* Ring(int from, int to) const {
+    return reinterpret_cast<RingHeader*>(
+        rings_ + (static_cast<size_t>(from) * workers_.size() + to) *
+                     RingBytes());
+  }
+  double* RingData(RingHeader* ring) const {
+    return reinterpret_cast<double*>(reinterpret_cast<char*>(ring) +
+                                     sizeof(RingHeader));
+  }
+
+  void RunWorker(int w, int iterations, double* rank, WorkerStats* stats) {
+    const Worker& worker = workers_[w];
+    int p = workers_.size();
+    int size = worker.end - worker.begin;
+    std::vector<double> contribution(worker.ghost_offset[p]);
+    std::vector<size_t> sent(p), received(p);
+    stats->begin = worker.begin;
+    stats->end = worker.end;
+    stats->in_links = worker.in_links.num_edges();
+    for (int q = 0; q < p; q++) {
+      stats->sent_values += worker.boundary[q].size();
+      stats->received_values += workers_[q].boundary[w].size();
+    }
+
+    for (int u = worker.begin; u < worker.end; u++) {
+      contribution[u - worker.begin] =
+          out_degree_[u] ? rank[u] / out_degree_[u] : 0;
+    }
+    for (int i = 0; i < iterations; i++) {
+      int64_t wait_begin = MonotonicMicros();
+      std::fill(sent.begin(), sent.end(), 0);
+      std::fill(received.begin(), received.end(), 0);
+      bool done = false;
+      while (!done) {
+        done = true;
+        bool progress = false;
+        for (int q = 0; q < p; q++) {
+          if (q == w)
+            continue;
+          progress |= Send(w, q, contribution, &sent[q]);
+          progress |= Receive(q, w, &contribution, &received[q]);
+          done &= sent[q] == worker.boundary[q].size() &&
+                  received[q] == workers_[q].boundary[w].size();
+        }
+        if (!done && !progress)
+          std::this_thread::yield();
+      }
+      int64_t compute_begin = MonotonicMicros();
+      stats->wait_sec += (compute_begin - wait_begin) / 1E6;
+
+      // The new contributions go to a scratch range, as the old ones are
+      // still read.
+      std::vector<double> next(size);
+      for (int x = 0; x < size; x++) {
+        double sum = 0;
+        for (const int* it = worker.in_links.begin(x);
+             it != worker.in_links.end(x); ++it)
+          sum += contribution[*it];
+        rank[worker.begin + x] = sum;
+        int degree = out_degree_[worker.begin + x];
+        next[x] = degree ? sum / degree : 0;
+      }
+      std::copy(next.begin(), next.end(), contribution.begin());
+      stats->compute_sec += (MonotonicMicros() - compute_begin) / 1E6;
+    }
+  }
+
+  // Writes as many of the boundary values for |to| as fit. Returns whether
+  // any was written.
+  bool Send(int from, int to, const std::vector<double>& contribution,
+            size_t* sent) const {
+    const std::vector<int>& list = workers_[from].boundary[to];
+    if (*sent == list.size())
+      return false;
+    RingHeader* ring = Ring(from, to);
+    double* data = RingData(ring);
+    uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+    uint64_t head = ring->head.load(std::memory_order_acquire);
+    size_t count = std::min<size_t>(ring_values_ - (tail - head),
+                                    list.size() - *sent);
+    if (count == 0)
+      return false;
+    int begin = workers_[from].begin;
+    for (size_t k = 0; k < count; k++)
+      data[(tail + k) % ring_values_] = contribution[list[*sent + k] - begin];
+    ring->tail.store(tail + count, std::memory_order_release);
+    *sent += count;
+    return true;
+  }
+
+  // Reads the available values from |from| into their ghost slots.
+  bool Receive(int from, int to, std::vector<double>* contribution,
+               size_t* received) const {
+    size_t expected = workers_[from].boundary[to].size();
+    if (*received == expected)
+      return false;
+    RingHeader* ring = Ring(from, to);
+    const double* data = RingData(ring);
+    uint64_t head = ring->head.load(std::memory_order_relaxed);
+    uint64_t tail = ring->tail.load(std::memory_order_acquire);
+    size_t count = std::min<size_t>(tail - head, expected - *received);
+    if (count == 0)
+      return false;
+    double* ghost = contribution->data() + workers_[to].ghost_offset[from];
+    for (size_t k = 0; k < count; k++)
+      ghost[*received + k] = data[(head + k) % ring_values_];
+    ring->head.store(head + count, std::memory_order_release);
+    *received += count;
+    return true;
+  }
+
+  std::vector<Worker> workers_;
+  std::vector<int> owner_;
+  std::vector<int> out_degree_;
+  size_t ring_values_;
+  char* rings_ = nullptr;
+};
+
+#endif  // HOMEWORK2_CPP_SHARDED_PAGERANK_H_
@@ -1,16 +1,68 @@
-//! clang++ -std=c++14 -Wall -Wextra shortest.cc
-#include <sys/time.h>
-
+//! clang++ -std=c++14 -Wall -Wextra -pthread shortest.cc
+//
+// Usage: ./a.out [--mode=bfs|pll|both] [--bp-roots=N] [--rebuild-index]
+//                [--order=none|degree|rcm|gorder] [--compressed=varint|group]
+//                [--batch=FILE [--batch-width=64|128|256|512]]
+//                [--diameter [--hll-bits=6]] [--cache-mb=64]
+//                [--reach[=N]] [--weights=indegree|pagerank|file [--delta=N]]
+//   --mode: answer queries with BFS (default), with the pruned landmark
+//           labeling index, or with both for A/B timing.
+//   --order: relabel vertexes after loading for cache locality. Ids typed
+//            into the prompt are still the ids in pages.txt.
+//   --compressed: keep the links delta encoded in memory instead of as
+//                 std::vector<int>.
+//   --batch: answer the "<from> <to>" lines of FILE with multi-source BFS,
+//            --batch-width sources per traversal (default 256), print
+//            "<from>\t<to>\t<steps>" (-1 if unreachable) and exit.
+//   --diameter: print the exact diameter of the largest strongly connected
+//               component, the hop-distance distribution estimated with
+//               2^hll-bits registers per vertex and the most central pages
+//               (see diameter.h), and exit.
+//   --reach: build the reachability index (see
+//            common/reachability_index.h), answer the --batch lines with
+//            "<from>\t<to>\t<1|0>" or N random queries (default 100000),
+//            print the latency percentiles and exit.
+//   --weights: also find the cheapest path when links cost more the less
+//              linked (indegree) or ranked (pagerank) their target is, or
+//              cost the third column of links.txt (file, --order=none
+//              only); see weighted_shortest_paths.h. With --batch, answer
+//              every line with BFS, Dijkstra and delta-stepping (bucket
+//              width --delta, default picked from the costs), print
+//              "<from>\t<to>\t<cost>\t<steps>\t<bfs steps>" (-1 if
+//              unreachable) and the timings, and exit.
+//   --cache-mb: memory for the BFS paths of repeated queries (0: off); see
+//               common/query_cache.h.
+#include <algorithm>
+#include <chrono>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
 #include <memory>
 #include <queue>
+#include <random>
+#include <string>
 #include <vector>
 
+#include "../common/compressed_graph.h"
+#include "../common/csr_graph.h"
+#include "../common/graph_memory.h"
+#include "../common/instrumentation.h"
+#include "../common/perf_counters.h"
+#include "../common/query_cache.h"
+#include "../common/reachability_index.h"
+#include "../common/vertex_order.h"
+#include "diameter.h"
+#include "multi_source_bfs.h"
+#include "partitioned_pagerank.h"
+#include "pruned_landmark_labeling.h"
+#include "weighted_shortest_paths.h"
+
 const char* LINKS_TXT_PATH = "links.txt";
 const char* PAGES_TXT_PATH = "pages.txt";
+const char* INDEX_SUFFIX = ".pll";
 
 
 class Vertex {
@@ -33,25 +85,37 @@ class Vertex {
 
   const std::vector<int>& edges() const { return edges_; }
 
+  // Frees the adjacency vector once the graph keeps a compressed copy.
+  void ReleaseEdges() { std::vector<int>().swap(edges_); }
+
  private:
   std::vector<int> edges_;
 };
 
 class Graph {
  public:
-  Graph() {}
+  using PathCache =
+      QueryCache<std::pair<int, int>, std::vector<int>, PairHash>;
+
+  Graph() : version_(NextGraphVersion()) {}
   void AddVertex(Vertex vertex) {
     vertexes_.emplace_back(std::move(vertex));
   }
 
-  const std::vector<Vertex>& vertexes() const {
+  const GraphVector<Vertex>& vertexes() const {
     return vertexes_;
   }
 
   void PrintShortestPath(int from, int to) {
     std::cout << "From: " << names_[from]
               << ", To: " << names_[to] << std::endl;
-    auto path = bfs(from, to);
+    std::vector<int> path;
+    if (!path_cache_ || !path_cache_->Get({from, to}, version_, &path)) {
+      path = bfs(from, to);
+      if (path_cache_)
+        path_cache_->Put({from, to}, version_, path,
+                         path.size() * sizeof(int));
+    }
     if (path.size() == 0) {
       std::cout << "Path was not found" << std::endl;
       return;
@@ -66,125 +130,624 @@ class Graph {
     std::cout << "}" << std::endl;
   }
 
-  static std::unique_ptr<Graph> Create(const char* pages_path,
-                                       const char* links_path) {
-    std::unique_ptr<Graph> graph(new Graph());
-
-    std::fstream links_stream(links_path);
-    if (links_stream.fail()) {
-      std::cerr << "file not found: " << links_path << std::endl;
-      return nullptr;
-    }
+  std::unique_ptr<ReachabilityIndex> BuildReachabilityIndex(
+      int num_intervals) const {
+    return std::make_unique<ReachabilityIndex>(ToCsrGraph(), num_intervals);
+  }
 
-    std::vector<int> edges;
-    while (true) {
-      static int vertex_index = 0;
-      int in = -1, out = -1;
-      links_stream >> in >> out;
-      if (links_stream.eof())
-        break;
-      if (in == -1 || out == -1) {
-        std::cerr << "unexpected error: " << vertex_index << std::endl;
+  // The links and, aligned with them, their costs in |*weights|, or nullptr
+  // on error. The third column of |links_path| only fits the ids of
+  // pages.txt, so kFile fails after Reorder().
+  std::unique_ptr<CsrGraph> BuildWeightedGraph(
+      LinkWeights kind, const char* links_path,
+      std::vector<uint32_t>* weights) const {
+    if (kind == LinkWeights::kFile) {
+      if (!new_id_.empty()) {
+        std::cerr << "link weights from a file need --order=none"
+                  << std::endl;
         return nullptr;
       }
-      // Add the previous vertex and prepare for the next one.
-      if (in != vertex_index) {
-        vertex_index++;
-        graph->AddVertex(std::move(edges));
-        if (edges.size() != 0)
-          break;
-      }
-      edges.push_back(out);
+      std::unique_ptr<CsrGraph> links =
+          LoadWeightedTextLinks(links_path, weights);
+      if (links)
+        links->EnsureVertexes(std::max(vertexes_.size(), names_.size()));
+      return links;
+    }
+    auto links = std::make_unique<CsrGraph>(ToCsrGraph());
+    if (kind == LinkWeights::kInDegree) {
+      *weights = InDegreeWeights(*links);
+    } else {
+      // The costs only keep log2 of the rank, which a few iterations fix.
+      const int kIterations = 10;
+      std::vector<double> rank(links->num_vertexes(),
+                               1.0 / std::max(1, links->num_vertexes()));
+      PartitionedPageRank(*links, 1).Run(kIterations, &rank);
+      *weights = RankWeights(*links, rank);
     }
-    // Add the last vertex
-    if (edges.size() != 0)
-      graph->AddVertex(std::move(edges));
+    return links;
+  }
 
-    // Read names
-    std::vector<std::string> names;
-    std::fstream pages_stream(pages_path);
-    if (pages_stream.fail()) {
-      std::cerr << "file not found: " << pages_path <<  std::endl;
-      return nullptr;
+  // Same output as PrintShortestPath() for the cheapest path by |search|.
+  void PrintCheapestPath(DijkstraSearch* search, int from, int to) const {
+    std::cout << "From: " << names_[from] << ", To: " << names_[to]
+              << std::endl;
+    WeightedPath path = search->Run(from, to);
+    if (path.vertexes.empty()) {
+      std::cout << "Path was not found" << std::endl;
+      return;
     }
+    std::cout << "cost " << path.cost << ", " << path.vertexes.size() - 1
+              << " steps" << std::endl;
+    std::cout << "Path: {";
+    bool is_first = true;
+    for (int v : path.vertexes) {
+      std::cout << (is_first ? "" : ", ") << Name(v);
+      is_first = false;
+    }
+    std::cout << "}" << std::endl;
+  }
+
+  // Keeps the paths of PrintShortestPath() in |budget_bytes| of memory.
+  void EnableCache(size_t budget_bytes) {
+    path_cache_ = std::make_unique<PathCache>(budget_bytes);
+  }
+
+  const PathCache* path_cache() const { return path_cache_.get(); }
 
-    while (true) {
-      size_t id;
-      std::string name;
-      pages_stream >> id >> name;
-      if (pages_stream.eof())
+  // Changes whenever the links or the vertex ids change.
+  uint64_t version() const { return version_; }
+
+  // Same as PrintShortestPath() but answered by the label index: the path is
+  // recovered by stepping to any neighbour that is one hop closer to |to|.
+  void PrintShortestPathWithIndex(int from, int to) {
+    std::cout << "From: " << names_[from]
+              << ", To: " << names_[to] << std::endl;
+    int dist = index_->Query(from, to);
+    if (dist == PrunedLandmarkLabeling::kInfinity) {
+      std::cout << "Path was not found" << std::endl;
+      return;
+    }
+    std::cout << dist << " steps" << std::endl;
+    std::cout << "Path: {" << names_[from];
+    for (int v = from; v != to && dist > 0; dist--) {
+      int next = -1;
+      ForEachEdge(v, [&](int w) {
+        if (next < 0 && index_->Query(w, to) == dist - 1)
+          next = w;
+      });
+      if (next < 0)
         break;
-      if (names.size() != id) {
-        std::cerr << "unmatch id" << std::endl;
-        return nullptr;
-      }
-      names.push_back(name);
+      v = next;
+      std::cout << ", " << names_[v];
+    }
+    std::cout << "}" << std::endl;
+  }
+
+  // Hop counts for every (from, to) pair of |queries| (-1 if unreachable),
+  // |width| sources per traversal; see multi_source_bfs.h.
+  std::vector<int> BatchDistances(
+      const std::vector<std::pair<int, int>>& queries, int width,
+      MultiSourceBfsStats* stats) const {
+    CsrGraph graph = ToCsrGraph();
+    PerfScope perf("MultiSourceBfs");
+    std::vector<int> distances =
+        MultiSourceDistances(graph, queries, width, stats);
+    perf.AddItems(stats->edge_scans);
+    return distances;
+  }
+
+  // Prints the results of DiameterEngine: the exact diameter with a pair
+  // that far apart, the distance distribution and the pages with the
+  // smallest eccentricity.
+  void PrintDiameter(int hll_bits) const {
+    CsrGraph graph = ToCsrGraph();
+    DiameterEngine engine(graph);
+    {
+      ScopedTimer t("Exact diameter (DiFUB)");
+      DiameterEngine::ExactResult exact = engine.ExactDiameter();
+      std::cout << "component of " << Name(exact.center) << ": "
+                << exact.component_size << " pages" << std::endl;
+      std::cout << "diameter: " << exact.diameter << " steps, from "
+                << Name(exact.from) << " to " << Name(exact.to) << " ("
+                << exact.num_bfs << " BFSs)" << std::endl;
+    }
+    ScopedTimer t("Neighbourhood function (HyperANF)");
+    const int kMaxSteps = 1000;
+    DiameterEngine::Neighbourhood hood =
+        engine.EstimateNeighbourhood(hll_bits, 0.9, kMaxSteps);
+    std::cout << std::setw(6) << "steps" << std::setw(16) << "pairs"
+              << std::setw(16) << "pairs <= steps" << std::endl;
+    for (size_t i = 1; i < hood.pairs.size(); i++) {
+      std::cout << std::setw(6) << i << std::setw(16) << std::fixed
+                << std::setprecision(0) << hood.pairs[i] - hood.pairs[i - 1]
+                << std::setw(16) << hood.pairs[i] - hood.pairs[0]
+                << std::endl;
+    }
+    std::cout << std::setprecision(2) << "average distance: "
+              << hood.average_distance
+              << " effective diameter (90%): " << hood.effective_diameter
+              << std::endl;
+    std::cout.unsetf(std::ios::fixed);
+
+    // Most central pages of the component: the candidates with the
+    // smallest estimates get an exact eccentricity, ties are broken by the
+    // estimated distance sum.
+    std::vector<int> central;
+    for (int v = 0; v < graph.num_vertexes(); v++) {
+      if (engine.component()[v])
+        central.push_back(v);
+    }
+    auto estimated_less = [&](int a, int b) {
+      if (hood.eccentricity[a] != hood.eccentricity[b])
+        return hood.eccentricity[a] < hood.eccentricity[b];
+      return hood.distance_sum[a] < hood.distance_sum[b];
+    };
+    const size_t kCandidates = 100;
+    const size_t kTop = 10;
+    if (central.size() > kCandidates) {
+      std::partial_sort(central.begin(), central.begin() + kCandidates,
+                        central.end(), estimated_less);
+      central.resize(kCandidates);
+    }
+    std::vector<int> eccentricity = engine.Eccentricities(central);
+    std::vector<int> order(central.size());
+    for (size_t i = 0; i < order.size(); i++)
+      order[i] = i;
+    std::sort(order.begin(), order.end(), [&](int a, int b) {
+      if (eccentricity[a] != eccentricity[b])
+        return eccentricity[a] < eccentricity[b];
+      return hood.distance_sum[central[a]] < hood.distance_sum[central[b]];
+    });
+    for (size_t i = 0; i < order.size() && i < kTop; i++) {
+      int v = central[order[i]];
+      std::cout << Name(v) << " eccentricity: " << eccentricity[order[i]]
+                << " average distance: " << std::setprecision(3)
+                << hood.distance_sum[v] / std::max(1.0f, hood.reached[v] - 1)
+                << std::endl;
     }
-    graph->names_ = std::move(names);
+  }
+
+  // Loads the label index from |path|, or builds and saves it there when
+  // the file is missing or was built from another |links_path|. Returns
+  // false if the index can not be built.
+  bool LoadOrBuildIndex(const std::string& path, const char* links_path,
+                        int bp_roots, bool rebuild) {
+    CsrGraph graph = ToCsrGraph();
+    PrunedLandmarkLabeling::Header header =
+        PrunedLandmarkLabeling::MakeHeader(graph, bp_roots, links_path);
+    if (!rebuild)
+      index_ = PrunedLandmarkLabeling::Load(path, header);
+    if (index_) {
+      std::cout << "loaded " << path << std::endl;
+    } else {
+      index_ = PrunedLandmarkLabeling::Build(graph, bp_roots);
+      if (!index_)
+        return false;
+      // The index in memory still answers queries; only the next run has
+      // to build it again.
+      if (!index_->Save(path, header))
+        std::cerr << "index not saved, it will be rebuilt" << std::endl;
+    }
+    std::cout << "average label size: " << index_->AverageLabelSize() << " "
+              << "index size: " << index_->memory_bytes() / 1024.0 / 1024.0
+              << " MB" << std::endl;
+    return true;
+  }
+
+  // Renames every vertex with |order| so that linked pages sit close in
+  // memory. Use internal_id() to translate the ids of pages.txt afterwards.
+  void Reorder(VertexOrder order) {
+    version_ = NextGraphVersion();
+    CsrGraph graph = ToCsrGraph();
+    new_id_ = ComputeVertexOrder(order, graph, graph.Reversed());
+    CsrGraph relabeled = Relabel(graph, new_id_);
+
+    GraphVector<Vertex> vertexes;
+    vertexes.reserve(relabeled.num_vertexes());
+    for (int v = 0; v < relabeled.num_vertexes(); v++)
+      vertexes.emplace_back(
+          std::vector<int>(relabeled.begin(v), relabeled.end(v)));
+    vertexes_ = std::move(vertexes);
+
+    std::vector<std::string> names(relabeled.num_vertexes());
+    for (size_t v = 0; v < names_.size() && v < new_id_.size(); v++)
+      names[new_id_[v]] = std::move(names_[v]);
+    names_ = std::move(names);
+  }
+
+  int internal_id(int id) const {
+    return new_id_.empty() ? id : new_id_[id];
+  }
+
+  // Replaces every adjacency vector with one delta-encoded stream. Vertex
+  // edges() are empty afterwards; use degree() and ForEachEdge() instead.
+  void Compress(CompressedGraph::Encoding encoding) {
+    compressed_ = std::make_unique<CompressedGraph>(ToCsrGraph(), encoding);
+    while (static_cast<int>(vertexes_.size()) < compressed_->num_vertexes())
+      AddVertex(Vertex(std::vector<int>()));
+    for (auto& v : vertexes_)
+      v.ReleaseEdges();
+  }
+
+  const CompressedGraph* compressed() const { return compressed_.get(); }
+
+  int degree(int v) const {
+    return compressed_ ? compressed_->degree(v)
+                       : static_cast<int>(vertexes_[v].edges().size());
+  }
+
+  template <typename Fn>
+  void ForEachEdge(int v, Fn fn) const {
+    if (compressed_) {
+      compressed_->ForEachNeighbor(v, fn);
+      return;
+    }
+    for (int e : vertexes_[v].edges())
+      fn(e);
+  }
+
+  static std::unique_ptr<Graph> Create(const char* pages_path,
+                                       const char* links_path) {
+    INSTRUMENT_SCOPE("Graph::Create");
+    PerfScope perf("Graph::Create");
+    std::unique_ptr<Graph> graph(new Graph());
+
+    std::unique_ptr<CsrGraph> links = LoadLinks(links_path);
+    if (!links)
+      return nullptr;
+    perf.AddItems(links->num_edges());
+    if (!LoadNames(pages_path, &graph->names_))
+      return nullptr;
+
+    // Pages without links are isolated vertexes.
+    links->EnsureVertexes(graph->names_.size());
+    graph->vertexes_.reserve(links->num_vertexes());
+    for (int v = 0; v < links->num_vertexes(); v++)
+      graph->AddVertex(
+          Vertex(std::vector<int>(links->begin(v), links->end(v))));
 
     return graph;
   }
 
  private:
+  std::string Name(int v) const {
+    return v >= 0 && v < static_cast<int>(names_.size()) ? names_[v]
+                                                          : std::to_string(v);
+  }
+
+  CsrGraph ToCsrGraph() const {
+    return CsrGraph::FromAdjacency(
+        vertexes_.size(), [this](int v) { return degree(v); },
+        [this](int v, auto fn) { ForEachEdge(v, fn); });
+  }
+
   std::vector<int> bfs(int from, int to) {
+    INSTRUMENT_SCOPE("bfs");
+    PerfScope perf("bfs");
     std::vector<bool> visited(vertexes().size());
     std::queue<std::vector<int>> queue;
     queue.emplace(std::vector<int>({from}));
     visited[from] = true;
+    // Vertexes popped at |level|; routes in |queue| have non-decreasing
+    // length, so a longer route starts the next level.
+    size_t level = 0;
+    int64_t frontier = 0;
 
     while (!queue.empty()) {
       const auto& route = queue.front();
       int index = route.back();
+      if (route.size() - 1 != level) {
+        INSTRUMENT_HISTOGRAM("bfs.frontier", frontier);
+        level = route.size() - 1;
+        frontier = 0;
+      }
+      frontier++;
       if (index == to)
         return std::move(route);
+      INSTRUMENT_COUNT("bfs.edges", degree(index));
+      perf.AddItems(degree(index));
       // Push the outgoing nodes into the |queue|
-      const Vertex& v = vertexes_[index];
-      for (const auto& i : v.edges()) {
+      ForEachEdge(index, [&](int i) {
         if (!visited[i]) {
           visited[i] = true;
           auto new_route = route;
           new_route.push_back(i);
           queue.emplace(std::move(new_route));
         }
-      }
+      });
       queue.pop();
     }
     return std::vector<int>();
   }
 
-  std::vector<Vertex> vertexes_;
+  GraphVector<Vertex> vertexes_;
   std::vector<std::string> names_;
+  std::unique_ptr<PrunedLandmarkLabeling> index_;
+  std::vector<int> new_id_;  // id in pages.txt -> vertex index
+  std::unique_ptr<CompressedGraph> compressed_;
+  uint64_t version_;
+  std::unique_ptr<PathCache> path_cache_;
 };
 
 
-class Timer {
- public:
-  Timer(const std::string& tag) : tag_(tag) {
-    timeval tv;
-    gettimeofday(&tv, nullptr);
-    begin_ = tv.tv_sec + tv.tv_usec / 1E6;
-    std::cout << "==== Begin: " << tag_ << " ====" << std::endl;
+enum class QueryMode { kBfs, kIndex, kBoth };
+
+// Reads the "<from> <to>" lines of |path| into |ids| and, translated with
+// internal_id(), into |queries|. Returns false on error.
+bool ReadQueries(const Graph& graph, const char* path,
+                 std::vector<std::pair<int, int>>* ids,
+                 std::vector<std::pair<int, int>>* queries) {
+  std::ifstream in(path);
+  if (in.fail()) {
+    std::cerr << "file not found: " << path << std::endl;
+    return false;
+  }
+  int n = graph.vertexes().size();
+  int from, to;
+  while (in >> from >> to) {
+    if (from < 0 || from >= n || to < 0 || to >= n) {
+      std::cerr << "out of range: line " << ids->size() + 1 << std::endl;
+      return false;
+    }
+    ids->emplace_back(from, to);
+    queries->emplace_back(graph.internal_id(from), graph.internal_id(to));
   }
+  if (!in.eof()) {
+    std::cerr << "unexpected error: line " << ids->size() + 1 << std::endl;
+    return false;
+  }
+  return true;
+}
 
-  ~Timer() {
-    timeval tv;
-    gettimeofday(&tv, nullptr);
-    double end = tv.tv_sec + tv.tv_usec / 1E6;
+// Answers the "<from> <to>" lines of |path| with Graph::BatchDistances().
+int AnswerBatch(const Graph& graph, const char* path, int width) {
+  std::vector<std::pair<int, int>> ids;
+  std::vector<std::pair<int, int>> queries;
+  if (!ReadQueries(graph, path, &ids, &queries))
+    return -1;
 
-    std::cout << "Elapsed: " << std::setprecision(3)
-              << end - begin_ << " sec" << std::endl;
-    std::cout << "==== End: " << tag_ << " ====" << std::endl;
+  MultiSourceBfsStats stats;
+  std::vector<int> distances;
+  double sec = 0;
+  {
+    ScopedTimer t("Batch queries (multi-source BFS)");
+    distances = graph.BatchDistances(queries, width, &stats);
+    sec = t.elapsed();
   }
+  for (size_t i = 0; i < ids.size(); i++) {
+    std::cout << ids[i].first << "\t" << ids[i].second << "\t" << distances[i]
+              << "\n";
+  }
+  sec = std::max(sec, 1E-9);
+  std::cerr << "queries: " << queries.size() << " batches: " << stats.batches
+            << " width: " << width << " queries/sec: " << queries.size() / sec
+            << "\nedge scans: " << stats.edge_scans << " ("
+            << stats.edge_scans / sec / 1E6 << " M/sec) traversed edges: "
+            << stats.traversed_edges << " ("
+            << stats.traversed_edges / sec / 1E6 << " MTEPS)" << std::endl;
+  return 0;
+}
 
- private:
-  double begin_;
-  std::string tag_;
-};
+// Builds the reachability index and answers the "<from> <to>" lines of
+// |path| with 1 (reachable) or 0, or |num_random| random queries if |path|
+// is null, and prints the latency percentiles.
+int AnswerReachability(const Graph& graph, const char* path, int num_random) {
+  std::vector<std::pair<int, int>> ids;
+  std::vector<std::pair<int, int>> queries;
+  if (path) {
+    if (!ReadQueries(graph, path, &ids, &queries))
+      return -1;
+  } else {
+    std::mt19937 rng(1);
+    std::uniform_int_distribution<int> pick(0, graph.vertexes().size() - 1);
+    for (int i = 0; i < num_random; i++)
+      queries.emplace_back(pick(rng), pick(rng));
+  }
+
+  const int kIntervals = 3;
+  std::unique_ptr<ReachabilityIndex> index;
+  {
+    ScopedTimer t("Build reachability index");
+    index = graph.BuildReachabilityIndex(kIntervals);
+    std::cerr << "components: " << index->num_components()
+              << " dag links: " << index->dag().num_edges()
+              << " bytes: " << index->memory_bytes() << std::endl;
+  }
+
+  std::vector<char> reachable(queries.size());
+  std::vector<int64_t> latency_ns(queries.size());
+  for (size_t i = 0; i < queries.size(); i++) {
+    auto begin = std::chrono::steady_clock::now();
+    reachable[i] = index->Reaches(queries[i].first, queries[i].second);
+    latency_ns[i] = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now() - begin)
+                        .count();
+  }
+  for (size_t i = 0; i < ids.size(); i++) {
+    std::cout << ids[i].first << "\t" << ids[i].second << "\t"
+              << static_cast<int>(reachable[i]) << "\n";
+  }
+
+  const ReachabilityIndex::Stats& stats = index->stats();
+  std::cerr << "queries: " << queries.size()
+            << " reachable: " << std::count(reachable.begin(),
+                                            reachable.end(), 1)
+            << "\nsame component: " << stats.same_component
+            << " order filter: " << stats.order_filter
+            << " interval filter: " << stats.interval_filter
+            << " searched: " << stats.searched << " ("
+            << stats.searched_reachable << " reachable, "
+            << stats.searched_vertexes << " components visited)" << std::endl;
+  if (latency_ns.empty())
+    return 0;
+  std::sort(latency_ns.begin(), latency_ns.end());
+  auto percentile = [&](double p) {
+    return latency_ns[std::min(latency_ns.size() - 1,
+                               static_cast<size_t>(p * latency_ns.size()))];
+  };
+  std::cerr << "latency ns p50: " << percentile(0.5)
+            << " p90: " << percentile(0.9) << " p99: " << percentile(0.99)
+            << " p99.9: " << percentile(0.999)
+            << " max: " << latency_ns.back() << std::endl;
+  return 0;
+}
+
+// Answers the "<from> <to>" lines of |path| with BFS, Dijkstra and
+// delta-stepping on the costs |kind| and prints the time of each.
+int AnswerWeighted(const Graph& graph, LinkWeights kind, const char* path,
+                   uint32_t delta) {
+  std::vector<std::pair<int, int>> ids;
+  std::vector<std::pair<int, int>> queries;
+  if (!ReadQueries(graph, path, &ids, &queries))
+    return -1;
+
+  std::vector<uint32_t> weights;
+  std::unique_ptr<CsrGraph> links;
+  {
+    ScopedTimer t(std::string("Link weights: ") + LinkWeightsName(kind));
+    links = graph.BuildWeightedGraph(kind, LINKS_TXT_PATH, &weights);
+    if (!links)
+      return -1;
+  }
+  BfsSearch bfs(*links);
+  DijkstraSearch dijkstra(*links, weights);
+  DeltaSteppingSearch delta_stepping(*links, weights, delta);
+
+  size_t n = queries.size();
+  auto report = [&](const char* name, double sec, int64_t scanned_links) {
+    sec = std::max(sec, 1E-9);
+    std::cerr << name << ": queries/sec: " << n / sec
+              << " links scanned: " << scanned_links << " ("
+              << scanned_links / sec / 1E6 << " M/sec)" << std::endl;
+  };
+  std::vector<WeightedPath> hops(n), cheapest(n);
+  {
+    ScopedTimer t("Weighted queries (BFS)");
+    for (size_t i = 0; i < n; i++)
+      hops[i] = bfs.Run(queries[i].first, queries[i].second);
+    report("bfs", t.elapsed(), bfs.scanned_links());
+  }
+  double dijkstra_sec = 0;
+  {
+    ScopedTimer t("Weighted queries (Dijkstra)");
+    for (size_t i = 0; i < n; i++)
+      cheapest[i] = dijkstra.Run(queries[i].first, queries[i].second);
+    dijkstra_sec = t.elapsed();
+    report("dijkstra", dijkstra_sec, dijkstra.scanned_links());
+  }
+  int mismatches = 0;
+  {
+    ScopedTimer t("Weighted queries (delta-stepping)");
+    for (size_t i = 0; i < n; i++) {
+      WeightedPath result =
+          delta_stepping.Run(queries[i].first, queries[i].second);
+      mismatches += result.cost != cheapest[i].cost;
+    }
+    double sec = t.elapsed();
+    report("delta-stepping", sec, delta_stepping.scanned_links());
+    std::cerr << "delta: " << delta_stepping.delta()
+              << " buckets: " << delta_stepping.buckets() << " threads: "
+              << NumThreads() << std::endl;
+    if (sec > dijkstra_sec) {
+      std::cerr << "delta-stepping is " << sec / std::max(dijkstra_sec, 1E-9)
+                << "x slower than serial Dijkstra on these queries"
+                << std::endl;
+    }
+  }
+  if (mismatches) {
+    std::cerr << "delta-stepping disagrees with Dijkstra on " << mismatches
+              << " queries" << std::endl;
+    return -1;
+  }
+
+  auto steps = [](const WeightedPath& p) {
+    return static_cast<int64_t>(p.vertexes.size()) - 1;
+  };
+  for (size_t i = 0; i < n; i++) {
+    std::cout << ids[i].first << "\t" << ids[i].second << "\t"
+              << (cheapest[i].vertexes.empty()
+                      ? -1
+                      : static_cast<int64_t>(cheapest[i].cost))
+              << "\t" << steps(cheapest[i]) << "\t" << steps(hops[i])
+              << "\n";
+  }
+  return 0;
+}
+
+int main(int argc, char** argv) {
+  QueryMode mode = QueryMode::kBfs;
+  int bp_roots = 8;
+  bool rebuild_index = false;
+  VertexOrder order = VertexOrder::kOriginal;
+  bool compress = false;
+  CompressedGraph::Encoding encoding = CompressedGraph::Encoding::kVarint;
+  const char* batch_path = nullptr;
+  int reach_queries = 0;  // > 0: AnswerReachability()
+  int batch_width = 256;
+  bool diameter = false;
+  int hll_bits = 6;
+  int cache_mb = 64;
+  bool weighted = false;
+  LinkWeights link_weights = LinkWeights::kInDegree;
+  uint32_t delta = 0;
+  for (int i = 1; i < argc; i++) {
+    if (std::strcmp(argv[i], "--mode=bfs") == 0) {
+      mode = QueryMode::kBfs;
+    } else if (std::strcmp(argv[i], "--mode=pll") == 0) {
+      mode = QueryMode::kIndex;
+    } else if (std::strcmp(argv[i], "--mode=both") == 0) {
+      mode = QueryMode::kBoth;
+    } else if (std::strncmp(argv[i], "--bp-roots=", 11) == 0) {
+      bp_roots = std::max(0, std::atoi(argv[i] + 11));
+    } else if (std::strcmp(argv[i], "--rebuild-index") == 0) {
+      rebuild_index = true;
+    } else if (std::strcmp(argv[i], "--compressed=varint") == 0) {
+      compress = true;
+      encoding = CompressedGraph::Encoding::kVarint;
+    } else if (std::strcmp(argv[i], "--compressed=group") == 0) {
+      compress = true;
+      encoding = CompressedGraph::Encoding::kGroupVarint;
+    } else if (std::strncmp(argv[i], "--order=", 8) == 0) {
+      if (!ParseVertexOrder(argv[i] + 8, &order)) {
+        std::cerr << "unknown order: " << argv[i] + 8 << std::endl;
+        return -1;
+      }
+    } else if (std::strcmp(argv[i], "--diameter") == 0) {
+      diameter = true;
+    } else if (std::strncmp(argv[i], "--cache-mb=", 11) == 0) {
+      cache_mb = std::max(0, std::atoi(argv[i] + 11));
+    } else if (std::strncmp(argv[i], "--hll-bits=", 11) == 0) {
+      hll_bits = std::atoi(argv[i] + 11);
+    } else if (std::strcmp(argv[i], "--reach") == 0) {
+      reach_queries = 100000;
+    } else if (std::strncmp(argv[i], "--reach=", 8) == 0) {
+      reach_queries = std::max(1, std::atoi(argv[i] + 8));
+    } else if (std::strncmp(argv[i], "--weights=", 10) == 0) {
+      if (!ParseLinkWeights(argv[i] + 10, &link_weights)) {
+        std::cerr << "unknown weights: " << argv[i] + 10 << std::endl;
+        return -1;
+      }
+      weighted = true;
+    } else if (std::strncmp(argv[i], "--delta=", 8) == 0) {
+      delta = std::max(0, std::atoi(argv[i] + 8));
+    } else if (std::strncmp(argv[i], "--batch=", 8) == 0) {
+      batch_path = argv[i] + 8;
+    } else if (std::strncmp(argv[i], "--batch-width=", 14) == 0) {
+      batch_width = std::atoi(argv[i] + 14);
+      if (batch_width != 64 && batch_width != 128 && batch_width != 256 &&
+          batch_width != 512) {
+        std::cerr << "batch width must be 64, 128, 256 or 512" << std::endl;
+        return -1;
+      }
+    } else {
+      std::cerr << "unknown option: " << argv[i] << std::endl;
+      return -1;
+    }
+  }
 
-int main() {
   std::unique_ptr<Graph> graph;
   {
-    Timer t("Create graph");
+    ScopedTimer t("Create graph");
     graph = Graph::Create(PAGES_TXT_PATH, LINKS_TXT_PATH);
     if (!graph)
       return -1;
@@ -196,17 +759,86 @@ int main() {
               << "num edges: " << n_edges << std::endl;
   }
 
+  if (order != VertexOrder::kOriginal) {
+    ScopedTimer t(std::string("Reorder vertexes: ") + VertexOrderName(order));
+    graph->Reorder(order);
+  }
+
+  if (compress) {
+    ScopedTimer t("Compress links");
+    graph->Compress(encoding);
+    std::cout << "bytes per edge: "
+              << static_cast<double>(graph->compressed()->memory_bytes()) /
+                     graph->compressed()->num_edges()
+              << std::endl;
+  }
+
+  if (reach_queries > 0)
+    return AnswerReachability(*graph, batch_path, reach_queries);
+  if (weighted && batch_path)
+    return AnswerWeighted(*graph, link_weights, batch_path, delta);
+  if (batch_path)
+    return AnswerBatch(*graph, batch_path, batch_width);
+  if (diameter) {
+    graph->PrintDiameter(hll_bits);
+    return 0;
+  }
+
+  if (mode != QueryMode::kBfs) {
+    // The index is built over the relabeled graph, so it is per ordering.
+    std::string index_path = std::string(LINKS_TXT_PATH) + INDEX_SUFFIX;
+    if (order != VertexOrder::kOriginal)
+      index_path = std::string(LINKS_TXT_PATH) + "." + VertexOrderName(order) +
+                   INDEX_SUFFIX;
+    ScopedTimer t("Create index");
+    if (!graph->LoadOrBuildIndex(index_path, LINKS_TXT_PATH, bp_roots,
+                                 rebuild_index))
+      return -1;
+  }
+  if (cache_mb > 0)
+    graph->EnableCache(static_cast<size_t>(cache_mb) << 20);
+  std::vector<uint32_t> weights;
+  std::unique_ptr<CsrGraph> weighted_links;
+  std::unique_ptr<DijkstraSearch> dijkstra;
+  if (weighted) {
+    ScopedTimer t(std::string("Link weights: ") +
+                  LinkWeightsName(link_weights));
+    weighted_links =
+        graph->BuildWeightedGraph(link_weights, LINKS_TXT_PATH, &weights);
+    if (!weighted_links)
+      return -1;
+    dijkstra = std::make_unique<DijkstraSearch>(*weighted_links, weights);
+  }
+
+  auto print_shortest_path = [&](const std::string& tag, int from, int to) {
+    from = graph->internal_id(from);
+    to = graph->internal_id(to);
+    if (mode != QueryMode::kIndex) {
+      ScopedTimer t(tag + " (BFS)");
+      graph->PrintShortestPath(from, to);
+      if (const Graph::PathCache* cache = graph->path_cache()) {
+        Graph::PathCache::Stats stats = cache->stats();
+        std::cout << "cache: " << stats.hits << " hits " << stats.misses
+                  << " misses " << stats.entries << " entries" << std::endl;
+      }
+    }
+    if (mode != QueryMode::kBfs) {
+      ScopedTimer t(tag + " (index)");
+      graph->PrintShortestPathWithIndex(from, to);
+    }
+    if (dijkstra) {
+      ScopedTimer t(tag + " (weighted)");
+      graph->PrintCheapestPath(dijkstra.get(), from, to);
+    }
+  };
+
   // 457783: Google
   // 22557: 渋谷
   const int kGoogleId = 457783;
   const int kShibuyaId = 22557;
-  {
-    Timer t("Google -> 渋谷");
-    graph->PrintShortestPath(kGoogleId, kShibuyaId);
-  }
-  {
-    Timer t("渋谷 -> Google");
-    graph->PrintShortestPath(kShibuyaId, kGoogleId);
+  if (static_cast<int>(graph->vertexes().size()) > kGoogleId) {
+    print_shortest_path("Google -> 渋谷", kGoogleId, kShibuyaId);
+    print_shortest_path("渋谷 -> Google", kShibuyaId, kGoogleId);
   }
 
   while (true) {
@@ -215,6 +847,8 @@ int main() {
     std::cin >> from;
     std::cout << "Type the destination's id: ";
     std::cin >> to;
+    if (std::cin.eof())
+      break;
     if (from < 0 || static_cast<int>(graph->vertexes().size()) <= from) {
       std::cout << "out of range (source)" << std::endl;
       continue;
@@ -224,8 +858,7 @@ int main() {
       continue;
     }
 
-    Timer t("BFS");
-    graph->PrintShortestPath(from, to);
+    print_shortest_path("Query", from, to);
   }
 
   return 0;
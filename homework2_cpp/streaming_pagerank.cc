@@ -0,0 +1,547 @@
+//! clang++ -std=c++14 -O3 -Wall -Wextra -pthread streaming_pagerank.cc
+//
+// Out-of-core PageRank for link graphs that do not fit in memory.
+//
+// links.txt is first converted to links.txt.grid: the vertexes are split
+// into P ranges and every link is stored in the block (source range,
+// destination range) of a P x P grid, blocks ordered column by column
+// (GridGraph / X-Stream style). The conversion streams links.txt three
+// times (vertex count, block sizes, links) and keeps one small write buffer
+// per block in memory, then drops repeated links block by block, so memory
+// also bounds the largest block. The file records the size and mtime of
+// links.txt and is rebuilt when they change.
+//
+// Each iteration then reads the edge section of the grid file sequentially
+// while only the rank vectors live in memory: the contribution
+// rank / out-degree of every vertex and the next ranks. Column order keeps
+// the next ranks of one destination range hot while all its blocks stream
+// by, and within a block the contributions of one source range. A reader
+// thread fills one buffer while the other is being processed, and every
+// iteration reports the bytes read, the disk bandwidth (over the reader's
+// time in read calls) and the time spent waiting for I/O.
+//
+// Computes the same recurrence as UpdatePageRank() in
+// pagerank_for_wikipedia.cc: rank'(v) = sum over u -> v of
+// rank(u) / out-degree(u), starting from 100 everywhere.
+//
+// Usage: ./a.out [--grid=P] [--rebuild] [--iterations=20] [--chunk-mb=16]
+//                [--drop-cache]
+//   --grid: number of vertex ranges per side (default: 2^20 vertexes each);
+//           rebuilds the grid file.
+//   --drop-cache: evict the file from the page cache as it is read, so that
+//                 every iteration really goes to the disk.
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "../common/csr_graph.h"
+#include "../common/instrumentation.h"
+
+const char* LINKS_TXT_PATH = "links.txt";
+const char* PAGES_TXT_PATH = "pages.txt";
+const char* GRID_SUFFIX = ".grid";
+const double DEFAULT_PAGE_RANK = 100;
+
+struct Edge {
+  uint32_t src;
+  uint32_t dst;
+};
+
+// links.txt.grid:
+//   GridHeader
+//   uint64_t block_begin[P * P + 1]  first edge of block (column-major)
+//   uint32_t out_degree[num_vertexes]
+//   Edge edges[num_edges]
+struct GridHeader {
+  uint32_t magic;
+  uint32_t num_vertexes;
+  uint32_t grid;
+  uint32_t range;  // vertexes per range
+  uint64_t num_edges;
+  FileStamp source;  // of links.txt
+};
+
+constexpr uint32_t kGridMagic = 0x32445247;  // "GRD2"
+
+bool WriteFully(int fd, const void* data, size_t size, off_t offset) {
+  const char* p = static_cast<const char*>(data);
+  while (size > 0) {
+    ssize_t written = pwrite(fd, p, size, offset);
+    if (written <= 0)
+      return false;
+    p += written;
+    size -= written;
+    offset += written;
+  }
+  return true;
+}
+
+bool ReadFully(int fd, void* data, size_t size, off_t offset) {
+  char* p = static_cast<char*>(data);
+  while (size > 0) {
+    ssize_t read_bytes = pread(fd, p, size, offset);
+    if (read_bytes <= 0)
+      return false;
+    p += read_bytes;
+    size -= read_bytes;
+    offset += read_bytes;
+  }
+  return true;
+}
+
+// Calls |fn(src, dst)| for every link of |links_path|, parsed with
+// ParseLinks() in chunks so that the file never has to fit in memory.
+// Returns false on a malformed line.
+template <typename Fn>
+bool ForEachLink(const char* links_path, Fn fn) {
+  std::ifstream links(links_path, std::ios::binary);
+  if (links.fail()) {
+    std::cerr << "file not found: " << links_path << std::endl;
+    return false;
+  }
+  const size_t kChunkBytes = 16 << 20;
+  std::vector<char> buffer;
+  std::vector<std::pair<int, int>> edges;
+  size_t kept = 0;  // start of a line continued in the next chunk
+  int64_t line = 1;
+  while (true) {
+    buffer.resize(kept + kChunkBytes);
+    links.read(buffer.data() + kept, kChunkBytes);
+    size_t size = kept + links.gcount();
+    bool last = !links;
+    size_t end = size;
+    if (!last) {
+      while (end > 0 && buffer[end - 1] != '\n')
+        end--;
+      if (end == 0) {  // a line longer than a chunk
+        kept = size;
+        continue;
+      }
+    }
+    edges.clear();
+    int max_id = -1;
+    const char* begin = buffer.data();
+    if (const char* error = ParseLinks(begin, begin + end, &edges, &max_id)) {
+      std::cerr << "unexpected error: line "
+                << line + std::count(begin, error, '\n') << std::endl;
+      return false;
+    }
+    for (const auto& edge : edges)
+      fn(edge.first, edge.second);
+    if (last)
+      return !links.bad();
+    line += std::count(begin, begin + end, '\n');
+    kept = size - end;
+    std::memmove(buffer.data(), begin + end, kept);
+  }
+}
+
+class GridFile {
+ public:
+  // Converts |links_path| into a |grid| x |grid| grid file (|grid| <= 0:
+  // ranges of 2^20 vertexes).
+  static bool Build(const char* links_path, const std::string& grid_path,
+                    int grid) {
+    FileStamp source = StampOf(links_path);
+    // Pass 1: number of vertexes and links.
+    uint64_t num_edges = 0;
+    uint32_t n = 0;
+    if (!ForEachLink(links_path, [&](int src, int dst) {
+          n = std::max<uint32_t>(n, std::max(src, dst) + 1);
+          num_edges++;
+        }))
+      return false;
+
+    GridHeader header = {kGridMagic, n, 0, 0, num_edges, source};
+    const uint32_t kDefaultRange = 1 << 20;
+    header.grid = grid > 0 ? grid : std::max<uint32_t>(
+                                        1, (n + kDefaultRange - 1) /
+                                               kDefaultRange);
+    header.range = std::max<uint32_t>(1, (n + header.grid - 1) / header.grid);
+    uint32_t p = header.grid;
+
+    // Pass 2: count the links of every block, then scatter them.
+    std::vector<uint64_t> block_begin(p * p + 1, 0);
+    uint64_t counted = 0;
+    if (!ForEachLink(links_path, [&](int src, int dst) {
+          if (static_cast<uint32_t>(std::max(src, dst)) < n) {
+            block_begin[Block(header, src, dst) + 1]++;
+            counted++;
+          }
+        }))
+      return false;
+    if (counted != num_edges) {
+      std::cerr << links_path << " changed while converting" << std::endl;
+      return false;
+    }
+    for (size_t b = 0; b < p * p; b++)
+      block_begin[b + 1] += block_begin[b];
+
+    int fd = open(grid_path.c_str(), O_CREAT | O_TRUNC | O_RDWR, 0644);
+    if (fd < 0) {
+      std::cerr << "cannot open: " << grid_path << std::endl;
+      return false;
+    }
+    off_t edges_offset = EdgesOffset(header);
+    const size_t kBufferEdges = 4096;
+    std::vector<std::vector<Edge>> buffers(p * p);
+    std::vector<uint64_t> cursor(block_begin.begin(), block_begin.end() - 1);
+    bool ok = true;
+    auto flush = [&](size_t b) {
+      ok = ok && WriteFully(fd, buffers[b].data(),
+                            buffers[b].size() * sizeof(Edge),
+                            edges_offset + cursor[b] * sizeof(Edge));
+      cursor[b] += buffers[b].size();
+      buffers[b].clear();
+    };
+    bool parsed = ForEachLink(links_path, [&](int src, int dst) {
+      if (static_cast<uint32_t>(std::max(src, dst)) >= n)
+        return;
+      size_t b = Block(header, src, dst);
+      if (cursor[b] + buffers[b].size() >= block_begin[b + 1])
+        return;  // links.txt has grown; caught by the check below
+      buffers[b].push_back({static_cast<uint32_t>(src),
+                            static_cast<uint32_t>(dst)});
+      if (buffers[b].size() == kBufferEdges)
+        flush(b);
+    });
+    for (size_t b = 0; b < p * p; b++)
+      flush(b);
+    for (size_t b = 0; b < p * p; b++)
+      ok = ok && cursor[b] == block_begin[b + 1];
+    if (!parsed || !ok) {
+      std::cerr << "cannot convert " << links_path << " into " << grid_path
+                << std::endl;
+      close(fd);
+      return false;
+    }
+
+    // Pass 3: drop repeated links, as LoadLinks() does, one block at a
+    // time. Blocks only move towards the start of the file. Out-degrees
+    // count the remaining links.
+    std::vector<uint32_t> out_degree(n, 0);
+    std::vector<Edge> block;
+    uint64_t kept = 0;
+    for (size_t b = 0; ok && b < p * p; b++) {
+      block.resize(block_begin[b + 1] - block_begin[b]);
+      ok = ReadFully(fd, block.data(), block.size() * sizeof(Edge),
+                     edges_offset + block_begin[b] * sizeof(Edge));
+      std::sort(block.begin(), block.end(), [](const Edge& x, const Edge& y) {
+        return x.src != y.src ? x.src < y.src : x.dst < y.dst;
+      });
+      block.erase(std::unique(block.begin(), block.end(),
+                              [](const Edge& x, const Edge& y) {
+                                return x.src == y.src && x.dst == y.dst;
+                              }),
+                  block.end());
+      for (const Edge& edge : block)
+        out_degree[edge.src]++;
+      block_begin[b] = kept;
+      ok = ok && WriteFully(fd, block.data(), block.size() * sizeof(Edge),
+                            edges_offset + kept * sizeof(Edge));
+      kept += block.size();
+    }
+    block_begin[p * p] = kept;
+    header.num_edges = kept;
+    ok = ok && ftruncate(fd, edges_offset + kept * sizeof(Edge)) == 0 &&
+         WriteFully(fd, &header, sizeof(header), 0) &&
+         WriteFully(fd, block_begin.data(),
+                    block_begin.size() * sizeof(uint64_t), sizeof(header)) &&
+         WriteFully(fd, out_degree.data(), n * sizeof(uint32_t),
+                    sizeof(header) + block_begin.size() * sizeof(uint64_t));
+    close(fd);
+    if (!ok) {
+      std::cerr << "cannot write: " << grid_path << std::endl;
+      return false;
+    }
+    return true;
+  }
+
+  // Reads the header, block table and out-degrees; the edges stay on disk.
+  // Fails if the file was built from a links.txt other than |source|.
+  bool Open(const std::string& path, const FileStamp& source) {
+    if (fd_ >= 0)
+      close(fd_);
+    fd_ = open(path.c_str(), O_RDONLY);
+    if (fd_ < 0)
+      return false;
+    if (!ReadFully(fd_, &header_, sizeof(header_), 0) ||
+        header_.magic != kGridMagic || header_.grid == 0) {
+      std::cerr << "broken grid file: " << path << std::endl;
+      return false;
+    }
+    if (header_.source != source) {
+      std::cerr << "stale " << path << ", rebuilding" << std::endl;
+      return false;
+    }
+    block_begin_.resize(header_.grid * header_.grid + 1);
+    out_degree_.resize(header_.num_vertexes);
+    return ReadFully(fd_, block_begin_.data(),
+                     block_begin_.size() * sizeof(uint64_t),
+                     sizeof(header_)) &&
+           ReadFully(fd_, out_degree_.data(),
+                     out_degree_.size() * sizeof(uint32_t),
+                     sizeof(header_) +
+                         block_begin_.size() * sizeof(uint64_t));
+  }
+
+  ~GridFile() {
+    if (fd_ >= 0)
+      close(fd_);
+  }
+
+  int fd() const { return fd_; }
+  const GridHeader& header() const { return header_; }
+  const std::vector<uint32_t>& out_degree() const { return out_degree_; }
+  off_t edges_offset() const { return EdgesOffset(header_); }
+  uint64_t edges_bytes() const { return header_.num_edges * sizeof(Edge); }
+
+ private:
+  // Column-major: all blocks of destination range 0 first.
+  static size_t Block(const GridHeader& header, uint32_t src, uint32_t dst) {
+    return static_cast<size_t>(dst / header.range) * header.grid +
+           src / header.range;
+  }
+
+  static off_t EdgesOffset(const GridHeader& header) {
+    return sizeof(GridHeader) +
+           (static_cast<off_t>(header.grid) * header.grid + 1) *
+               sizeof(uint64_t) +
+           static_cast<off_t>(header.num_vertexes) * sizeof(uint32_t);
+  }
+
+  int fd_ = -1;
+  GridHeader header_;
+  std::vector<uint64_t> block_begin_;
+  std::vector<uint32_t> out_degree_;
+};
+
+// Streams [begin, begin + size) of a file in chunks, reading the next chunk
+// on a background thread while the caller processes the current one.
+class ChunkReader {
+ public:
+  ChunkReader(int fd, off_t begin, uint64_t size, size_t chunk_bytes,
+              bool drop_cache)
+      : fd_(fd), begin_(begin), size_(size),
+        chunk_bytes_(chunk_bytes / sizeof(Edge) * sizeof(Edge)),
+        drop_cache_(drop_cache) {
+    for (auto& buffer : buffers_)
+      buffer.data.resize(chunk_bytes_);
+    thread_ = std::thread([this] { ReadLoop(); });
+  }
+
+  ~ChunkReader() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    changed_.notify_all();
+    thread_.join();
+  }
+
+  // Returns the next chunk, or false at the end. The chunk stays valid
+  // until the next call.
+  bool Next(const char** data, size_t* size) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (consuming_ >= 0) {
+      buffers_[consuming_].full = false;
+      consuming_ = -1;
+      changed_.notify_all();
+    }
+    int64_t wait_begin = MonotonicMicros();
+    Buffer& buffer = buffers_[next_ % 2];
+    changed_.wait(lock, [&] { return buffer.full || failed_; });
+    wait_us_ += MonotonicMicros() - wait_begin;
+    if (failed_ || buffer.size == 0)
+      return false;
+    consuming_ = next_ % 2;
+    next_++;
+    *data = buffer.data.data();
+    *size = buffer.size;
+    return true;
+  }
+
+  bool failed() const { return failed_; }
+  double wait_sec() const { return wait_us_ / 1E6; }
+  // Time the reader thread spent in read calls. Call after the last Next().
+  double read_sec() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return read_us_ / 1E6;
+  }
+
+ private:
+  struct Buffer {
+    std::vector<char> data;
+    size_t size = 0;
+    bool full = false;
+  };
+
+  void ReadLoop() {
+    uint64_t offset = 0;
+    for (int64_t chunk = 0;; chunk++) {
+      Buffer& buffer = buffers_[chunk % 2];
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        changed_.wait(lock, [&] { return !buffer.full || stop_; });
+        if (stop_)
+          return;
+      }
+      // The buffer is owned by this thread until it is marked full.
+      size_t size = std::min<uint64_t>(chunk_bytes_, size_ - offset);
+      int64_t read_begin = MonotonicMicros();
+      bool ok = ReadFully(fd_, buffer.data.data(), size, begin_ + offset);
+      int64_t read_us = MonotonicMicros() - read_begin;
+      if (ok && drop_cache_)
+        posix_fadvise(fd_, begin_ + offset, size, POSIX_FADV_DONTNEED);
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        read_us_ += read_us;
+        buffer.size = size;
+        buffer.full = true;
+        failed_ = !ok;
+      }
+      changed_.notify_all();
+      offset += size;
+      // An empty chunk marks the end.
+      if (size == 0 || !ok)
+        return;
+    }
+  }
+
+  const int fd_;
+  const off_t begin_;
+  const uint64_t size_;
+  const size_t chunk_bytes_;
+  const bool drop_cache_;
+  Buffer buffers_[2];
+  int consuming_ = -1;
+  int64_t next_ = 0;
+  bool stop_ = false;
+  bool failed_ = false;
+  int64_t wait_us_ = 0;
+  int64_t read_us_ = 0;
+  mutable std::mutex mutex_;
+  std::condition_variable changed_;
+  std::thread thread_;
+};
+
+// Prints the |count| highest ranks with their names, read from pages.txt
+// without keeping it in memory.
+void PrintTopPages(const std::vector<double>& rank, size_t count) {
+  std::vector<std::pair<double, uint32_t>> top;
+  for (uint32_t v = 0; v < rank.size(); v++) {
+    top.emplace_back(rank[v], v);
+    if (top.size() > 4 * count) {
+      std::nth_element(top.begin(), top.begin() + count, top.end(),
+                       std::greater<std::pair<double, uint32_t>>());
+      top.resize(count);
+    }
+  }
+  std::sort(top.begin(), top.end(),
+            std::greater<std::pair<double, uint32_t>>());
+  top.resize(std::min(top.size(), count));
+
+  std::vector<std::string> names(top.size());
+  std::ifstream pages(PAGES_TXT_PATH);
+  size_t id;
+  std::string name;
+  while (pages >> id >> name) {
+    for (size_t i = 0; i < top.size(); i++)
+      if (top[i].second == id)
+        names[i] = name;
+  }
+  for (size_t i = 0; i < top.size(); i++) {
+    std::cout << (names[i].empty() ? std::to_string(top[i].second) : names[i])
+              << " score: " << top[i].first << std::endl;
+  }
+}
+
+int main(int argc, char** argv) {
+  int grid = 0;
+  bool rebuild = false;
+  int iterations = 20;
+  size_t chunk_mb = 16;
+  bool drop_cache = false;
+  for (int i = 1; i < argc; i++) {
+    if (std::strncmp(argv[i], "--grid=", 7) == 0) {
+      grid = std::max(1, std::atoi(argv[i] + 7));
+    } else if (std::strcmp(argv[i], "--rebuild") == 0) {
+      rebuild = true;
+    } else if (std::strncmp(argv[i], "--iterations=", 13) == 0) {
+      iterations = std::max(1, std::atoi(argv[i] + 13));
+    } else if (std::strncmp(argv[i], "--chunk-mb=", 11) == 0) {
+      chunk_mb = std::max(1, std::atoi(argv[i] + 11));
+    } else if (std::strcmp(argv[i], "--drop-cache") == 0) {
+      drop_cache = true;
+    } else {
+      std::cerr << "unknown option: " << argv[i] << std::endl;
+      return -1;
+    }
+  }
+
+  const std::string grid_path = std::string(LINKS_TXT_PATH) + GRID_SUFFIX;
+  GridFile file;
+  FileStamp source = StampOf(LINKS_TXT_PATH);
+  if (rebuild || grid > 0 || !file.Open(grid_path, source)) {
+    {
+      ScopedTimer t("Build grid file");
+      if (!GridFile::Build(LINKS_TXT_PATH, grid_path, grid))
+        return -1;
+    }
+    if (!file.Open(grid_path, source))
+      return -1;
+  }
+  const GridHeader& header = file.header();
+  std::cout << "num vertexes: " << header.num_vertexes << " "
+            << "num edges: " << header.num_edges << " "
+            << "grid: " << header.grid << "x" << header.grid << std::endl;
+
+  uint32_t n = header.num_vertexes;
+  const std::vector<uint32_t>& out_degree = file.out_degree();
+  std::vector<double> contribution(n), rank(n, DEFAULT_PAGE_RANK);
+  for (int i = 0; i < iterations; i++) {
+    ScopedTimer t("Streaming page rank");
+    for (uint32_t v = 0; v < n; v++)
+      contribution[v] = out_degree[v] ? rank[v] / out_degree[v] : 0;
+    std::fill(rank.begin(), rank.end(), 0);
+
+    ChunkReader reader(file.fd(), file.edges_offset(), file.edges_bytes(),
+                       chunk_mb << 20, drop_cache);
+    const char* data;
+    size_t size;
+    while (reader.Next(&data, &size)) {
+      const Edge* edges = reinterpret_cast<const Edge*>(data);
+      for (size_t e = 0; e < size / sizeof(Edge); e++)
+        rank[edges[e].dst] += contribution[edges[e].src];
+    }
+    if (reader.failed()) {
+      std::cerr << "read error: " << grid_path << std::endl;
+      return -1;
+    }
+    double read_sec = reader.read_sec();
+    std::cout << "read " << file.edges_bytes() / (1 << 20) << " MB, "
+              << std::setprecision(4)
+              << (read_sec > 0 ? file.edges_bytes() / read_sec / (1 << 20)
+                               : 0)
+              << " MB/s, I/O wait " << reader.wait_sec() << " sec"
+              << std::endl;
+  }
+
+  PrintTopPages(rank, 10);
+  return 0;
+}
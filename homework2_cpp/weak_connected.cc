@@ -1,6 +1,17 @@
-#include <sys/time.h>
-
+//! clang++ -std=c++14 -O3 -Wall -Wextra -pthread weak_connected.cc
+//
+// Writes the pages weakly reachable from page 0, or with --khop the pages
+// within --hops hops of a page, to out_pages.txt / out_links.txt.
+//
+// Usage: ./a.out [--khop=ID [--hops=2] [--direction=out|in|both]
+//                [--max=N] [--binary]]
+//   --direction: follow out-links, in-links or both (default).
+//   --max: stop after N pages.
+//   --binary: write out_links.svb (see LoadBinaryLinks()) and number the
+//             pages 0, 1, 2, ... in out_pages.txt.
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
@@ -9,34 +20,14 @@
 #include <set>
 #include <vector>
 
+#include "../common/csr_graph.h"
+#include "../common/ego_network.h"
+#include "../common/instrumentation.h"
+
 const char* LINKS_TXT_PATH = "links.txt";
 const char* PAGES_TXT_PATH = "pages.txt";
 
 
-class Timer {
- public:
-  Timer(const std::string& tag) : tag_(tag) {
-    timeval tv;
-    gettimeofday(&tv, nullptr);
-    begin_ = tv.tv_sec + tv.tv_usec / 1E6;
-    std::cout << "==== Begin: " << tag_ << " ====" << std::endl;
-  }
-
-  ~Timer() {
-    timeval tv;
-    gettimeofday(&tv, nullptr);
-    double end = tv.tv_sec + tv.tv_usec / 1E6;
-
-    std::cout << "Elapsed: " << std::setprecision(3)
-              << end - begin_ << " sec" << std::endl;
-    std::cout << "==== End: " << tag_ << " ====" << std::endl;
-  }
-
- private:
-  double begin_;
-  std::string tag_;
-};
-
 class Vertex {
  public:
   Vertex() {}
@@ -77,45 +68,32 @@ class Graph {
     return vertexes_;
   }
 
+  const std::vector<std::string>& names() const { return names_; }
+
+  // Pages within |options.hops| hops of |source|; see ego_network.h. May be
+  // called from several threads at once.
+  EgoNetwork KHop(int source, const EgoNetworkOptions& options) const {
+    return EgoNetworkExtractor(links_, reversed_links_)
+        .Extract(source, options);
+  }
+
   static std::unique_ptr<Graph> Create(const char* pages_path,
                                        const char* links_path) {
     std::unique_ptr<Graph> graph(new Graph());
 
-    std::fstream links_stream(links_path);
-    if (links_stream.fail()) {
-      std::cerr << "file not found: " << links_path << std::endl;
-      return nullptr;
-    }
-
+    std::unique_ptr<CsrGraph> links;
     {
-      Timer t("Read links.txt");
-      std::set<int> edges;
-      while (true) {
-        static int vertex_index = 0;
-        int in = -1, out = -1;
-        links_stream >> in >> out;
-        if (links_stream.eof())
-          break;
-        if (in == -1 || out == -1) {
-          std::cerr << "unexpected error: " << vertex_index << std::endl;
-          return nullptr;
-        }
-        // Add the previous vertex and prepare for the next one.
-        if (in != vertex_index) {
-          vertex_index++;
-          graph->AddVertex(std::move(edges));
-          if (edges.size() != 0)
-            break;
-        }
-        edges.insert(out);
-      }
-      // Add the last vertex
-      if (edges.size() != 0)
-        graph->AddVertex(std::move(edges));
+      ScopedTimer t("Read links.txt");
+      links = LoadLinks(links_path);
+      if (!links)
+        return nullptr;
+      for (int v = 0; v < links->num_vertexes(); v++)
+        graph->AddVertex(std::set<int>(links->begin(v), links->end(v)));
     }
 
     {
-      Timer t("Create reversed edges");
+      ScopedTimer t("Create reversed edges");
+      graph->reversed_links_ = links->Reversed();
       // Add reversed direction
       for (size_t i = 0; i < graph->vertexes().size(); i++) {
         const auto& v = graph->vertexes()[i];
@@ -125,29 +103,16 @@ class Graph {
     }
 
     {
-      Timer t("Read pages.txt");
-      // Read names
-      std::vector<std::string> names;
-      std::fstream pages_stream(pages_path);
-      if (pages_stream.fail()) {
-        std::cerr << "file not found: " << pages_path <<  std::endl;
+      ScopedTimer t("Read pages.txt");
+      if (!LoadNames(pages_path, &graph->names_))
         return nullptr;
-      }
-
-      while (true) {
-        size_t id;
-        std::string name;
-        pages_stream >> id >> name;
-        if (pages_stream.eof())
-          break;
-        if (names.size() != id) {
-          std::cerr << "unmatch id" << std::endl;
-          return nullptr;
-        }
-        names.push_back(name);
-      }
-      graph->names_ = std::move(names);
+      // Pages without links are isolated vertexes.
+      while (graph->vertexes().size() < graph->names_.size())
+        graph->AddVertex(Vertex());
     }
+    links->EnsureVertexes(graph->vertexes().size());
+    graph->reversed_links_.EnsureVertexes(graph->vertexes().size());
+    graph->links_ = std::move(*links);
     return graph;
   }
 
@@ -183,12 +148,35 @@ class Graph {
 
   std::vector<Vertex> vertexes_;
   std::vector<std::string> names_;
+  CsrGraph links_;
+  CsrGraph reversed_links_;
 };
 
-int main() {
+int main(int argc, char** argv) {
+  int khop_source = -1;
+  bool binary = false;
+  EgoNetworkOptions options{2, Direction::kBoth, 0};
+  for (int i = 1; i < argc; i++) {
+    if (std::strncmp(argv[i], "--khop=", 7) == 0) {
+      khop_source = std::atoi(argv[i] + 7);
+    } else if (std::strncmp(argv[i], "--hops=", 7) == 0) {
+      options.hops = std::max(0, std::atoi(argv[i] + 7));
+    } else if (std::strncmp(argv[i], "--direction=", 12) == 0 &&
+               ParseDirection(argv[i] + 12, &options.direction)) {
+      continue;
+    } else if (std::strncmp(argv[i], "--max=", 6) == 0) {
+      options.max_vertexes = std::atoi(argv[i] + 6);
+    } else if (std::strcmp(argv[i], "--binary") == 0) {
+      binary = true;
+    } else {
+      std::cerr << "unknown option: " << argv[i] << std::endl;
+      return -1;
+    }
+  }
+
   std::unique_ptr<Graph> graph;
   {
-    Timer t("Create graph");
+    ScopedTimer t("Create graph");
     graph = Graph::Create(PAGES_TXT_PATH, LINKS_TXT_PATH);
     if (!graph)
       return -1;
@@ -200,8 +188,29 @@ int main() {
               << "num edges: " << n_edges << std::endl;
   }
 
+  if (khop_source >= 0) {
+    if (khop_source >= static_cast<int>(graph->vertexes().size())) {
+      std::cerr << "no such page: " << khop_source << std::endl;
+      return -1;
+    }
+    EgoNetwork ego;
+    {
+      ScopedTimer t("Extract k-hop neighbourhood");
+      ego = graph->KHop(khop_source, options);
+    }
+    std::cout << "pages: " << ego.vertexes.size()
+              << " links: " << ego.links.num_edges()
+              << (ego.truncated ? " (truncated)" : "") << std::endl;
+    ScopedTimer t("Write graph");
+    bool ok = binary ? ego.WriteBinary(graph->names(), "out_pages.txt",
+                                       "out_links.svb")
+                     : ego.WriteText(graph->names(), "out_pages.txt",
+                                     "out_links.txt");
+    return ok ? 0 : -1;
+  }
+
   {
-    Timer t("Write graph");
+    ScopedTimer t("Write graph");
     graph->WriteReachable(0);
   }
 
@@ -0,0 +1,565 @@
+// Shortest paths over links with non-negative integer costs.
+//
+//   std::vector<uint32_t> weights = InDegreeWeights(graph);
+//   DijkstraSearch dijkstra(graph, weights);
+//   WeightedPath path = dijkstra.Run(from, to);
+//
+// |weights| holds one cost per link, aligned with graph.targets(); path
+// costs must stay below kUnreachable. Three engines answer point-to-point
+// queries with the same interface, so they can be timed on the same
+// queries:
+//   - BfsSearch ignores the weights and counts hops (the baseline);
+//   - DijkstraSearch is serial Dijkstra on a radix heap, which suits the
+//     monotone integer keys of Dijkstra: a key is moved to a lower bucket
+//     at most 32 times, instead of the log n sift of a binary heap;
+//   - DeltaSteppingSearch (Meyer and Sanders, 2003) settles the vertexes
+//     bucket by bucket, where bucket b holds the tentative distances in
+//     [b * delta, (b + 1) * delta), and relaxes the links of a bucket in
+//     parallel, the heavy ones (cost > delta) only once the bucket is
+//     settled. Distance and parent share one 64-bit word updated with a
+//     compare-and-swap, so a path is consistent with its cost.
+// All of them stop once |to| is settled and keep their scratch arrays
+// between queries, resetting only the vertexes the last query touched.
+// Run() is not thread-safe; DeltaSteppingSearch runs on a pool of
+// NumThreads() threads of its own.
+//
+// On point-to-point queries delta-stepping scans about as many links as
+// Dijkstra but pays for the compare-and-swaps, the bins and two barriers per
+// pass. On one core it answers queries about 1.5x slower than Dijkstra (131K
+// vertexes, 2M links, in-degree costs), so it only pays off with enough
+// cores to share each bucket out; shortest.cc --batch prints the ratio.
+#ifndef HOMEWORK2_CPP_WEIGHTED_SHORTEST_PATHS_H_
+#define HOMEWORK2_CPP_WEIGHTED_SHORTEST_PATHS_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "../common/csr_graph.h"
+#include "../common/instrumentation.h"
+#include "../common/parallel.h"
+
+const uint32_t kUnreachable = UINT32_MAX;
+
+struct WeightedPath {
+  uint32_t cost = kUnreachable;
+  std::vector<int> vertexes;  // from ... to, empty if unreachable
+};
+
+// Where the link costs come from.
+enum class LinkWeights { kInDegree, kPageRank, kFile };
+
+inline bool ParseLinkWeights(const std::string& name, LinkWeights* weights) {
+  if (name == "indegree")
+    *weights = LinkWeights::kInDegree;
+  else if (name == "pagerank")
+    *weights = LinkWeights::kPageRank;
+  else if (name == "file")
+    *weights = LinkWeights::kFile;
+  else
+    return false;
+  return true;
+}
+
+inline const char* LinkWeightsName(LinkWeights weights) {
+  switch (weights) {
+    case LinkWeights::kInDegree: return "indegree";
+    case LinkWeights::kPageRank: return "pagerank";
+    case LinkWeights::kFile: return "file";
+  }
+  return "?";
+}
+
+// Costs 1 + log2(max in-degree + 1) - log2(in-degree + 1) of the target,
+// rounded down: links to well-linked pages are cheaper.
+inline std::vector<uint32_t> InDegreeWeights(const CsrGraph& graph) {
+  std::vector<int> in_degree(graph.num_vertexes(), 0);
+  for (int v : graph.targets())
+    in_degree[v]++;
+  auto log2 = [](int x) { return 31 - __builtin_clz(x + 1); };
+  int top = 0;
+  for (int d : in_degree)
+    top = std::max(top, log2(d));
+  std::vector<uint32_t> weights(graph.num_edges());
+  for (int64_t i = 0; i < graph.num_edges(); i++)
+    weights[i] = 1 + top - log2(in_degree[graph.targets()[i]]);
+  return weights;
+}
+
+// Same with the rank of the target: 1 + log2(max rank / rank), at most 32.
+inline std::vector<uint32_t> RankWeights(const CsrGraph& graph,
+                                         const std::vector<double>& rank) {
+  double top = 0;
+  for (double r : rank)
+    top = std::max(top, r);
+  std::vector<uint32_t> weights(graph.num_edges());
+  for (int64_t i = 0; i < graph.num_edges(); i++) {
+    double r = rank[graph.targets()[i]];
+    weights[i] = 32;
+    if (r > 0 && top / r < 4294967296.0)
+      weights[i] = 1 + 31 - __builtin_clz(static_cast<uint32_t>(top / r));
+  }
+  return weights;
+}
+
+// Loads a text links.txt with its third column (1 where missing) into
+// |weights|. Duplicate links keep their lowest weight. Returns nullptr on
+// error.
+inline std::unique_ptr<CsrGraph> LoadWeightedTextLinks(
+    const char* links_path, std::vector<uint32_t>* weights) {
+  INSTRUMENT_SCOPE("LoadWeightedTextLinks");
+  std::ifstream links_stream(links_path, std::ios::binary);
+  if (links_stream.fail()) {
+    std::cerr << "file not found: " << links_path << std::endl;
+    return nullptr;
+  }
+  std::vector<char> data((std::istreambuf_iterator<char>(links_stream)),
+                         std::istreambuf_iterator<char>());
+  std::vector<std::pair<int, int>> edges;
+  std::vector<uint32_t> parsed;
+  int max_id = -1;
+  const char* begin = data.data();
+  if (const char* error = ParseLinks(begin, begin + data.size(), &edges,
+                                     &max_id, &parsed)) {
+    std::cerr << "unexpected error: line " << std::count(begin, error, '\n') + 1
+              << std::endl;
+    return nullptr;
+  }
+
+  std::vector<int64_t> order(edges.size());
+  for (size_t i = 0; i < order.size(); i++)
+    order[i] = i;
+  std::sort(order.begin(), order.end(), [&](int64_t a, int64_t b) {
+    return edges[a] != edges[b] ? edges[a] < edges[b] : parsed[a] < parsed[b];
+  });
+  std::vector<std::pair<int, int>> unique;
+  weights->clear();
+  for (int64_t i : order) {
+    if (!unique.empty() && unique.back() == edges[i])
+      continue;
+    unique.push_back(edges[i]);
+    weights->push_back(parsed[i]);
+  }
+  INSTRUMENT_COUNT("load.duplicates", edges.size() - unique.size());
+  return std::make_unique<CsrGraph>(CsrGraph::FromEdges(max_id + 1, unique));
+}
+
+// Follows |parent| from |to| back to |from|.
+template <typename ParentFn>
+WeightedPath TracePath(int from, int to, uint32_t cost, ParentFn parent) {
+  WeightedPath path;
+  if (cost == kUnreachable)
+    return path;
+  path.cost = cost;
+  for (int v = to; v != from; v = parent(v))
+    path.vertexes.push_back(v);
+  path.vertexes.push_back(from);
+  std::reverse(path.vertexes.begin(), path.vertexes.end());
+  return path;
+}
+
+class BfsSearch {
+ public:
+  explicit BfsSearch(const CsrGraph& graph)
+      : graph_(graph), parent_(graph.num_vertexes(), -1) {}
+
+  int64_t scanned_links() const { return scanned_links_; }
+
+  // The cost is the number of hops.
+  WeightedPath Run(int from, int to) {
+    for (int v : queue_)
+      parent_[v] = -1;
+    queue_.assign(1, from);
+    parent_[from] = from;
+    uint32_t hops = kUnreachable;
+    size_t level_end = 1;
+    uint32_t level = 0;
+    for (size_t head = 0; head < queue_.size(); head++) {
+      if (head == level_end) {
+        level++;
+        level_end = queue_.size();
+      }
+      int v = queue_[head];
+      if (v == to) {
+        hops = level;
+        break;
+      }
+      scanned_links_ += graph_.degree(v);
+      for (const int* it = graph_.begin(v); it != graph_.end(v); ++it) {
+        if (parent_[*it] < 0) {
+          parent_[*it] = v;
+          queue_.push_back(*it);
+        }
+      }
+    }
+    return TracePath(from, to, hops, [&](int v) { return parent_[v]; });
+  }
+
+ private:
+  const CsrGraph& graph_;
+  std::vector<int> parent_;
+  std::vector<int> queue_;  // also the vertexes to reset
+  int64_t scanned_links_ = 0;
+};
+
+// Min-heap of monotone keys: a pushed key must not be smaller than the last
+// popped one. Bucket i > 0 holds the keys whose highest bit differing from
+// the last popped key is bit i - 1, bucket 0 the keys equal to it.
+class RadixHeap {
+ public:
+  bool empty() const { return size_ == 0; }
+
+  void Clear() {
+    for (auto& bucket : buckets_)
+      bucket.clear();
+    last_ = 0;
+    size_ = 0;
+  }
+
+  void Push(uint32_t key, int value) {
+    buckets_[BucketOf(key)].emplace_back(key, value);
+    size_++;
+  }
+
+  std::pair<uint32_t, int> Pop() {
+    if (buckets_[0].empty()) {
+      int i = 1;
+      while (buckets_[i].empty())
+        i++;
+      last_ = kUnreachable;
+      for (const auto& entry : buckets_[i])
+        last_ = std::min(last_, entry.first);
+      // Each entry lands in a lower bucket.
+      for (const auto& entry : buckets_[i])
+        buckets_[BucketOf(entry.first)].push_back(entry);
+      buckets_[i].clear();
+    }
+    std::pair<uint32_t, int> top = buckets_[0].back();
+    buckets_[0].pop_back();
+    size_--;
+    return top;
+  }
+
+ private:
+  int BucketOf(uint32_t key) const {
+    return key == last_ ? 0 : 32 - __builtin_clz(key ^ last_);
+  }
+
+  std::vector<std::pair<uint32_t, int>> buckets_[33];
+  uint32_t last_ = 0;
+  int64_t size_ = 0;
+};
+
+class DijkstraSearch {
+ public:
+  DijkstraSearch(const CsrGraph& graph, const std::vector<uint32_t>& weights)
+      : graph_(graph),
+        weights_(weights),
+        distance_(graph.num_vertexes(), kUnreachable),
+        parent_(graph.num_vertexes(), -1) {}
+
+  int64_t scanned_links() const { return scanned_links_; }
+
+  WeightedPath Run(int from, int to) {
+    for (int v : touched_)
+      distance_[v] = kUnreachable;
+    touched_.assign(1, from);
+    heap_.Clear();
+    distance_[from] = 0;
+    parent_[from] = from;
+    heap_.Push(0, from);
+    while (!heap_.empty()) {
+      std::pair<uint32_t, int> top = heap_.Pop();
+      int v = top.second;
+      if (top.first != distance_[v])
+        continue;  // superseded by a shorter path
+      if (v == to)
+        break;
+      scanned_links_ += graph_.degree(v);
+      for (int64_t i = graph_.offsets()[v]; i < graph_.offsets()[v + 1];
+           i++) {
+        int w = graph_.targets()[i];
+        uint64_t cost = static_cast<uint64_t>(top.first) + weights_[i];
+        if (cost >= distance_[w])
+          continue;
+        if (distance_[w] == kUnreachable)
+          touched_.push_back(w);
+        distance_[w] = cost;
+        parent_[w] = v;
+        heap_.Push(cost, w);
+      }
+    }
+    return TracePath(from, to, distance_[to],
+                     [&](int v) { return parent_[v]; });
+  }
+
+ private:
+  const CsrGraph& graph_;
+  const std::vector<uint32_t>& weights_;
+  std::vector<uint32_t> distance_;
+  std::vector<int> parent_;
+  std::vector<int> touched_;  // vertexes to reset
+  RadixHeap heap_;
+  int64_t scanned_links_ = 0;
+};
+
+class DeltaSteppingSearch {
+ public:
+  // |delta| == 0 picks it from the link costs, see PickDelta().
+  DeltaSteppingSearch(const CsrGraph& graph,
+                      const std::vector<uint32_t>& weights, uint32_t delta)
+      : graph_(graph),
+        delta_(delta ? delta : PickDelta(graph, weights)),
+        pool_(NumThreads()),
+        barrier_(pool_.num_threads()),
+        targets_(graph.num_edges()),
+        costs_(graph.num_edges()),
+        light_end_(graph.num_vertexes()),
+        state_(new std::atomic<uint64_t>[graph.num_vertexes()]),
+        relaxed_(graph.num_vertexes(), kUnreachable),
+        bins_(pool_.num_threads()),
+        settled_(pool_.num_threads()),
+        touched_(pool_.num_threads()),
+        mark_(graph.num_vertexes(), 0) {
+    // Each list is copied with its light links first, so that each pass
+    // scans only the links it relaxes.
+    ParallelFor(0, graph.num_vertexes(), 4096, [&](int64_t v) {
+      state_[v].store(kEmpty, std::memory_order_relaxed);
+      int64_t light = graph.offsets()[v];
+      int64_t heavy = graph.offsets()[v + 1];
+      for (int64_t i = graph.offsets()[v]; i < graph.offsets()[v + 1]; i++) {
+        int64_t j = weights[i] <= delta_ ? light++ : --heavy;
+        targets_[j] = graph.targets()[i];
+        costs_[j] = weights[i];
+      }
+      light_end_[v] = light;
+    });
+  }
+
+  uint32_t delta() const { return delta_; }
+  int64_t scanned_links() const { return scanned_links_; }
+  int64_t buckets() const { return buckets_; }
+
+  WeightedPath Run(int from, int to) {
+    for (int t = 0; t < pool_.num_threads(); t++) {
+      for (int v : touched_[t]) {
+        state_[v].store(kEmpty, std::memory_order_relaxed);
+        relaxed_[v] = kUnreachable;
+      }
+      touched_[t].clear();
+      settled_[t].clear();
+      for (auto& bin : bins_[t])
+        bin.clear();
+    }
+    state_[from].store(Pack(0, from), std::memory_order_relaxed);
+    touched_[0].push_back(from);
+    frontier_.assign(1, from);
+    bucket_ = 0;
+    heavy_ = false;
+    buckets_++;
+
+    std::vector<int64_t> scanned(pool_.num_threads(), 0);
+    std::atomic<size_t> next(0);
+    bool done = false;
+    pool_.Run([&](int tid) {
+      const size_t kGrain = 64;
+      int64_t local_scanned = 0;
+      while (true) {
+        while (true) {
+          size_t begin = next.fetch_add(kGrain, std::memory_order_relaxed);
+          if (begin >= frontier_.size())
+            break;
+          size_t end = std::min(begin + kGrain, frontier_.size());
+          for (size_t i = begin; i < end; i++)
+            local_scanned += Relax(tid, frontier_[i]);
+        }
+        barrier_.Wait();
+        if (tid == 0) {
+          done = !Advance(to);
+          next.store(0, std::memory_order_relaxed);
+        }
+        barrier_.Wait();
+        if (done)
+          break;
+      }
+      scanned[tid] = local_scanned;
+    });
+    for (int64_t s : scanned)
+      scanned_links_ += s;
+    uint64_t last = state_[to].load(std::memory_order_relaxed);
+    return TracePath(from, to, Distance(last), [&](int v) {
+      return static_cast<int>(state_[v].load(std::memory_order_relaxed));
+    });
+  }
+
+ private:
+  // Distance in the high half, parent in the low half.
+  static const uint64_t kEmpty = ~uint64_t(0);
+  static uint64_t Pack(uint32_t distance, int parent) {
+    return static_cast<uint64_t>(distance) << 32 |
+           static_cast<uint32_t>(parent);
+  }
+  static uint32_t Distance(uint64_t state) {
+    return static_cast<uint32_t>(state >> 32);
+  }
+
+  static uint32_t PickDelta(const CsrGraph& graph,
+                            const std::vector<uint32_t>& weights);
+
+  // Light links (cost <= delta) may lead back into the current bucket, so a
+  // vertex is relaxed over them again whenever its distance improved since
+  // the last time, until the bucket stays empty. Heavy links can not, and
+  // are relaxed once per vertex afterwards, from its final distance. Every
+  // improved target goes to the bin of its new distance. Returns the number
+  // of links scanned.
+  int64_t Relax(int tid, int v) {
+    uint32_t distance = Distance(state_[v].load(std::memory_order_relaxed));
+    int64_t begin = light_end_[v];
+    int64_t end = graph_.offsets()[v + 1];
+    if (!heavy_) {
+      // Moved to an earlier bucket and relaxed there, or not improved since
+      // it was last relaxed (e.g. queued twice in one pass).
+      if (distance / delta_ != bucket_ || distance >= relaxed_[v])
+        return 0;
+      if (relaxed_[v] == kUnreachable)
+        settled_[tid].push_back(v);
+      relaxed_[v] = distance;
+      end = begin;
+      begin = graph_.offsets()[v];
+    }
+    std::vector<std::vector<int>>& bins = bins_[tid];
+    for (int64_t i = begin; i < end; i++) {
+      int w = targets_[i];
+      uint64_t cost = static_cast<uint64_t>(distance) + costs_[i];
+      if (cost >= kUnreachable)
+        continue;
+      uint64_t desired = Pack(cost, v);
+      uint64_t old = state_[w].load(std::memory_order_relaxed);
+      while (Distance(desired) < Distance(old)) {
+        if (state_[w].compare_exchange_weak(old, desired,
+                                            std::memory_order_relaxed)) {
+          if (old == kEmpty)
+            touched_[tid].push_back(w);
+          size_t b = cost / delta_;
+          if (b >= bins.size())
+            bins.resize(b + 1);
+          bins[b].push_back(w);
+          break;
+        }
+      }
+    }
+    return end - begin;
+  }
+
+  // Picks the next frontier_ after a pass over the current one: the refilled
+  // current bucket, else the heavy links of the vertexes it settled, else
+  // the lowest non-empty bucket. Returns false when there is none or |to|
+  // is settled.
+  bool Advance(int to) {
+    uint64_t reached = state_[to].load(std::memory_order_relaxed);
+    auto settled_before = [&](size_t b) {
+      return reached != kEmpty &&
+             Distance(reached) < static_cast<uint64_t>(b) * delta_;
+    };
+    if (!heavy_) {
+      if (Gather(bucket_))
+        return true;
+      if (settled_before(bucket_ + 1))
+        return false;
+      // Each vertex is settled by one thread only.
+      heavy_ = true;
+      frontier_.clear();
+      for (auto& settled : settled_) {
+        frontier_.insert(frontier_.end(), settled.begin(), settled.end());
+        settled.clear();
+      }
+      return true;
+    }
+    heavy_ = false;
+    size_t lowest = SIZE_MAX;
+    for (const auto& bins : bins_) {
+      for (size_t b = bucket_; b < std::min(bins.size(), lowest); b++) {
+        if (!bins[b].empty()) {
+          lowest = b;
+          break;
+        }
+      }
+    }
+    if (lowest == SIZE_MAX || settled_before(lowest))
+      return false;
+    bucket_ = lowest;
+    buckets_++;
+    return Gather(lowest);
+  }
+
+  // Moves bin |b| of every thread into frontier_, once per vertex. Returns
+  // false if they are all empty.
+  bool Gather(size_t b) {
+    Stamp();
+    frontier_.clear();
+    for (auto& bins : bins_) {
+      if (b >= bins.size())
+        continue;
+      for (int v : bins[b]) {
+        if (mark_[v] != stamp_) {
+          mark_[v] = stamp_;
+          frontier_.push_back(v);
+        }
+      }
+      bins[b].clear();
+    }
+    INSTRUMENT_HISTOGRAM("delta.frontier", frontier_.size());
+    return !frontier_.empty();
+  }
+
+  void Stamp() {
+    if (++stamp_ == 0) {
+      std::fill(mark_.begin(), mark_.end(), 0);
+      stamp_ = 1;
+    }
+  }
+
+  const CsrGraph& graph_;
+  uint32_t delta_;
+  WorkerPool pool_;
+  SpinBarrier barrier_;
+  std::vector<int> targets_;     // per list: light links, then heavy ones
+  std::vector<uint32_t> costs_;  // aligned with targets_
+  std::vector<int64_t> light_end_;
+  std::unique_ptr<std::atomic<uint64_t>[]> state_;
+  std::vector<uint32_t> relaxed_;  // distance the light links were relaxed at
+  std::vector<std::vector<std::vector<int>>> bins_;  // per thread, bucket
+  std::vector<std::vector<int>> settled_;  // per thread, current bucket
+  std::vector<std::vector<int>> touched_;  // per thread
+  std::vector<uint32_t> mark_;             // == stamp_: in frontier_
+  uint32_t stamp_ = 0;
+  std::vector<int> frontier_;
+  size_t bucket_ = 0;
+  bool heavy_ = false;  // frontier_ needs its heavy links relaxed
+  int64_t scanned_links_ = 0;
+  int64_t buckets_ = 0;
+};
+
+// A link cheaper than delta may lead into the bucket it starts from, and
+// the target then has its light links relaxed in the same bucket again.
+// With at most as many such links as vertexes, a vertex brings on average at
+// most one more into its bucket, so delta is the widest cost for which that
+// holds: the cost of the (n + 1)-th cheapest link.
+inline uint32_t DeltaSteppingSearch::PickDelta(
+    const CsrGraph& graph, const std::vector<uint32_t>& weights) {
+  if (weights.empty())
+    return 1;
+  std::vector<uint32_t> sorted(weights);
+  size_t n = std::min<size_t>(graph.num_vertexes(), sorted.size() - 1);
+  std::nth_element(sorted.begin(), sorted.begin() + n, sorted.end());
+  return std::max<uint32_t>(1, sorted[n]);
+}
+
+#endif  // HOMEWORK2_CPP_WEIGHTED_SHORTEST_PATHS_H_